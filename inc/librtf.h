@@ -4,6 +4,21 @@
 #include "librtferrors.h"
 #include "librtfdefines.h"
 #include "librtfstructures.h"
+#include "librtfsink.h"
+#include "librtfbuffer.h"
+#include "librtfescape.h"
+#include "librtfimage.h"
+#include "librtfhex.h"
+#include "librtfimagecache.h"
+#include "librtfparagraph.h"
+#include "librtfnumber.h"
+#include "librtftable.h"
+#include "librtfdocument.h"
+#include "librtfprologue.h"
+#include "librtfmerge.h"
+#include "librtfbatch.h"
+#include "librtfreader.h"
+#include "librtffragment.h"
 
 // =============================================================================
 // Original source at
@@ -22,14 +37,26 @@
 // Sources rewritten by Raphael Kim
 // =============================================================================
 
+// All functions below work on a default RTF document.
+// Use librtf::RtfDocument directly to build several documents at once.
+
 namespace librtf
 {
+    // Gets default RTF document
+    RtfDocument* get_defaultdocument();
+
     // Creates new RTF document
     RTF_ERROR_TYPE open( const char* filename = NULL,
                          const char* fonts = NULL,
                          const char* colors = NULL,
                          RTF_DOCUMENT_FORMAT* fmt = NULL );
 
+    // Creates new RTF document written to sink
+    RTF_ERROR_TYPE open( RtfSink* sink,
+                         const char* fonts = NULL,
+                         const char* colors = NULL,
+                         RTF_DOCUMENT_FORMAT* fmt = NULL );
+
     // Closes created RTF document
     RTF_ERROR_TYPE close();
 
@@ -111,10 +138,12 @@ namespace librtf
     // Sets RTF table cell formatting properties
     void  set_tablecellformat( RTF_TABLECELL_FORMAT* cf );
 
-    // Gets border name
+    // Gets border name, empty for unknown types. Name is a constant,
+    // safe to call from several threads.
     const char* get_bordername( int border_type );
 
-    // Gets shading name
+    // Gets shading name, empty for fill and unknown types. Name is a
+    // constant, safe to call from several threads.
     const char* get_shadingname( int shading_type, bool cell );
 };
 
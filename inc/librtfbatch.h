@@ -0,0 +1,76 @@
+#ifndef __LIBRTFBATCH_H__
+#define __LIBRTFBATCH_H__
+
+#include <cstddef>
+
+#include "librtferrors.h"
+#include "librtfdefines.h"
+#include "librtfsink.h"
+
+namespace librtf
+{
+    class RtfDocument;
+    class RtfPrologue;
+    struct RtfBatchPool;
+
+    // Builds document of given job index into opened document,
+    // returns false when job failed.
+    typedef bool (*RTF_BATCH_CALLBACK)( RtfDocument* doc, size_t index, void* param );
+
+    // Creates output sink of given job index, NULL fails job
+    typedef RtfSink* (*RTF_SINK_FACTORY)( size_t index, void* param );
+
+    // Releases sink of given job index after document is closed
+    typedef void (*RTF_SINK_RELEASE)( RtfSink* sink, size_t index, bool failed, void* param );
+
+    // Batch document renderer.
+    // Owns a pool of worker threads, each with its own document reused
+    // job after job, so output buffers and format state are allocated
+    // once per worker. Jobs are split in ranges, one per worker, and an
+    // idle worker steals half of the remaining jobs of another.
+    // Each job opens its document on a sink from the factory, with
+    // open() or from a prologue, then calls back to build it.
+    // Document options set by a callback, as text escaping, stay set for
+    // next job of same worker, so callbacks should set them every time.
+    class RtfBatchRenderer
+    {
+        public:
+            // Uses given number of worker threads, 0 for one per CPU
+            RtfBatchRenderer( int threads = 0 );
+            ~RtfBatchRenderer();
+
+        private:
+            RtfBatchRenderer( const RtfBatchRenderer& );
+            RtfBatchRenderer& operator=( const RtfBatchRenderer& );
+
+        public:
+            // Renders count documents, returns when all are done.
+            // Sinks are closed by documents, then given to release,
+            // or deleted when release is NULL. Returns RTF_ERROR if any
+            // job failed, others are still rendered.
+            RTF_ERROR_TYPE render_batch( size_t count, RTF_BATCH_CALLBACK cb,
+                                         RTF_SINK_FACTORY factory,
+                                         RTF_SINK_RELEASE release = NULL,
+                                         void* param = NULL );
+
+            // Sets prologue documents are opened from, NULL for open().
+            // Prologue must outlive renderer or next set_prologue().
+            void set_prologue( const RtfPrologue* prologue );
+
+            // Gets number of worker threads
+            int get_threads()                   { return threads; }
+
+            // Gets number of failed jobs of last batch
+            size_t get_failed();
+
+            // Gets number of jobs of last batch run by another worker
+            // than the one they were given to
+            size_t get_stolen();
+
+        private:
+            int             threads;
+            RtfBatchPool*   pool;
+    };
+};
+
+#endif /// of __LIBRTFBATCH_H__
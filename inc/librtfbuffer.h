@@ -0,0 +1,119 @@
+#ifndef __LIBRTFBUFFER_H__
+#define __LIBRTFBUFFER_H__
+
+#include <cstddef>
+#include <cstring>
+
+#include "librtfdefines.h"
+#include "librtfsink.h"
+
+namespace librtf
+{
+    // RTF append buffer.
+    // With a sink, buffered bytes are flushed to it in large blocks,
+    // without a sink the buffer grows to hold everything put in.
+    class RtfBuffer
+    {
+        public:
+            RtfBuffer( size_t size = RTF_DEFAULT_BUFFERSIZE );
+            ~RtfBuffer();
+
+        private:
+            RtfBuffer( const RtfBuffer& );
+            RtfBuffer& operator=( const RtfBuffer& );
+
+        public:
+            // Sets output sink, pending bytes are dropped
+            void set_sink( RtfSink* sink );
+            // Sets buffer size, 0 writes every put() straight to sink
+            bool set_size( size_t size );
+            // Flushes pending bytes to sink
+            bool flush();
+            // Drops pending bytes and clears error state
+            void clear();
+            // Returns false once a write or allocation has failed
+            bool good()             { return ( failed == false ); }
+            // Gets pending data
+            const char* data()      { return buffer; }
+            // Gets pending data size in bytes
+            size_t size()           { return length; }
+            // Gets buffer size
+            size_t get_size()       { return capacity; }
+            // Gets largest pending data size since a sink was set
+            size_t get_highwater()  { return ( length > highwater ) ? length : highwater; }
+
+            // Gets free space to write to directly, at least size bytes or
+            // whole buffer if smaller, flushing or growing as needed.
+            // Returns free space size, 0 on error. Bytes written there
+            // are added with commit().
+            size_t reserve( char** dst, size_t size );
+
+            // Adds bytes written to reserved space
+            inline void commit( size_t size )   { length += size; }
+
+        public:
+            // Appends data
+            inline void put( const char* src, size_t srcsize )
+            {
+                if ( srcsize > capacity - length )
+                {
+                    overflow( src, srcsize );
+                    return;
+                }
+
+                memcpy( buffer + length, src, srcsize );
+                length += srcsize;
+            }
+
+            // Appends NUL terminated string
+            inline void put( const char* str )
+            {
+                put( str, strlen( str ) );
+            }
+
+            // Appends one character
+            inline void put_char( char c )
+            {
+                if ( length == capacity )
+                {
+                    overflow( &c, 1 );
+                    return;
+                }
+
+                buffer[ length++ ] = c;
+            }
+
+            // Appends decimal integer
+            inline void put_int( int value )
+            {
+                char         tmp[12];
+                char*        p = tmp + sizeof(tmp);
+                unsigned int uv = ( value < 0 ) ? 0u - (unsigned int)value : (unsigned int)value;
+
+                do
+                {
+                    *--p = (char)( '0' + ( uv % 10 ) );
+                    uv /= 10;
+                }
+                while ( uv != 0 );
+
+                if ( value < 0 )
+                    *--p = '-';
+
+                put( p, tmp + sizeof(tmp) - p );
+            }
+
+        private:
+            void overflow( const char* src, size_t srcsize );
+
+        private:
+            char*       buffer;
+            size_t      length;
+            size_t      capacity;
+            size_t      highwater;
+            RtfSink*    sink;
+            bool        failed;
+    };
+};
+
+#endif /// of __LIBRTFBUFFER_H__
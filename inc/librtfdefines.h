@@ -117,4 +117,57 @@
 #define RTF_DOCUMENTVIEWKIND_MASTER			3
 #define RTF_DOCUMENTVIEWKIND_NORMAL			4
 
+// Output buffer defs
+#define RTF_DEFAULT_BUFFERSIZE				65536
+#define RTF_FRAGMENT_BUFFERSIZE				4096
+#define RTF_DEFAULT_SPOOLSIZE				1048576
+
+// Text escaping methods
+#define RTF_ESCAPE_AUTO					0
+#define RTF_ESCAPE_SCALAR				1
+#define RTF_ESCAPE_SSE2					2
+#define RTF_ESCAPE_AVX2					3
+
+// Image type defs
+#define RTF_IMAGETYPE_UNKNOWN			0
+#define RTF_IMAGETYPE_PNG				1
+#define RTF_IMAGETYPE_JPEG				2
+
+// Hex encoding methods
+#define RTF_HEX_AUTO					0
+#define RTF_HEX_SCALAR					1
+#define RTF_HEX_SSSE3					2
+#define RTF_HEX_AVX2					3
+
+// Hex line width of pictures
+#define RTF_HEX_LINEWIDTH				128
+
+// Image cache defs
+#define RTF_DEFAULT_IMAGECACHESIZE		(64*1024*1024)
+#define RTF_IMAGECACHE_MAXFILES			4096
+
+// Table cell data layout defs
+#define RTF_TABLELAYOUT_ROWS			0
+#define RTF_TABLELAYOUT_COLUMNS			1
+
+// Number text defs
+#define RTF_NUMBER_SHORTEST				(-1)
+#define RTF_NUMBER_MAXPRECISION			20
+#define RTF_NUMBER_BUFFERSIZE			512
+
+// Mail merge template defs
+#define RTF_MERGE_MAXNAMELENGTH			64
+
+// RTF token defs
+#define RTF_TOKEN_GROUPSTART			1
+#define RTF_TOKEN_GROUPEND				2
+#define RTF_TOKEN_CONTROLWORD			3
+#define RTF_TOKEN_CONTROLSYMBOL			4
+#define RTF_TOKEN_TEXT					5
+#define RTF_TOKEN_HEX					6
+#define RTF_TOKEN_BINARY				7
+#define RTF_TOKEN_ERROR					8
+#define RTF_TOKEN_MAXWORDLENGTH			32
+#define RTF_TOKEN_MAXPARAMDIGITS		10
+
 #endif /// of __LIBRTF_DEFILES_H__
\ No newline at end of file
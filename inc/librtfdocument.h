@@ -0,0 +1,402 @@
+#ifndef __LIBRTFDOCUMENT_H__
+#define __LIBRTFDOCUMENT_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "librtferrors.h"
+#include "librtfdefines.h"
+#include "librtfstructures.h"
+#include "librtfsink.h"
+#include "librtfbuffer.h"
+#include "librtfescape.h"
+#include "librtfimage.h"
+#include "librtfhex.h"
+#include "librtfimagecache.h"
+#include "librtfparagraph.h"
+#include "librtfnumber.h"
+#include "librtftable.h"
+
+namespace librtf
+{
+    class RtfPrologue;
+
+    // RTF document, owns all writer state of one RTF output.
+    // Each instance is independent, so different threads may build
+    // different documents at the same time.
+    class RtfDocument
+    {
+        public:
+            RtfDocument();
+            ~RtfDocument();
+
+        private:
+            RtfDocument( const RtfDocument& );
+            RtfDocument& operator=( const RtfDocument& );
+
+        public:
+            // Creates new RTF document
+            RTF_ERROR_TYPE open( const char* filename = NULL,
+                                 const char* fonts = NULL,
+                                 const char* colors = NULL,
+                                 RTF_DOCUMENT_FORMAT* fmt = NULL );
+
+            // Creates new RTF document written to sink, sink is only
+            // flushed at close(), it is not closed nor deleted by document.
+            RTF_ERROR_TYPE open( RtfSink* sink,
+                                 const char* fonts = NULL,
+                                 const char* colors = NULL,
+                                 RTF_DOCUMENT_FORMAT* fmt = NULL );
+
+            // Creates new RTF document from precompiled prologue,
+            // see librtfprologue.h. Prologue must outlive document.
+            RTF_ERROR_TYPE open( const char* filename, const RtfPrologue& prologue );
+
+            // Creates new RTF document from precompiled prologue written
+            // to sink, sink is only flushed at close() as above.
+            RTF_ERROR_TYPE open( RtfSink* sink, const RtfPrologue& prologue );
+
+            // Creates new RTF document written to sink, font and color
+            // tables hold default font f0 (Times New Roman) and color cf0
+            // (black), then only entries added by font() and color().
+            // Body is spooled until close() writes header and body to
+            // sink, sink is only flushed as above. Spool keeps up to
+            // RTF_DEFAULT_SPOOLSIZE bytes in memory, rest in a temporary
+            // file, and body is copied once more at close(), so deferred
+            // documents are slower to write than open() ones.
+            RTF_ERROR_TYPE open_deferred( RtfSink* sink, RTF_DOCUMENT_FORMAT* fmt = NULL );
+
+            // Opens document fragment written to sink, without header nor
+            // document end. Formats, styles and options are copied from
+            // parent, font and color numbers are those of parent tables.
+            // Parent is only read, several fragments may be opened from
+            // it at the same time.
+            RTF_ERROR_TYPE open_fragment( RtfSink* sink, const RtfDocument* parent );
+
+            // Appends rendered document fragment
+            RTF_ERROR_TYPE write_fragment( const char* data, size_t size );
+
+            // Closes created RTF document
+            RTF_ERROR_TYPE close();
+
+            // Sets output buffer size (default RTF_DEFAULT_BUFFERSIZE),
+            // 0 writes every paragraph, cell or row straight to sink
+            bool set_buffersize( size_t size );
+
+            // Flushes buffered output to sink
+            bool flush();
+
+            // Gets largest number of output bytes buffered at once
+            size_t get_highwater();
+
+            // Sets delta formatting. Paragraphs then write only control
+            // words changed since previous paragraph instead of a full
+            // \pard\plain reset, output stays semantically identical.
+            void set_deltaformat( bool enable );
+
+            // Gets delta formatting state
+            bool get_deltaformat();
+
+            // Sets text escaping. Paragraph text is then written with
+            // \ { } escaped, newline and tab as \line and \tab, other
+            // control and non-ASCII bytes as \'hh. Off by default, text
+            // is written as is.
+            void set_textescaping( bool enable );
+
+            // Gets text escaping state
+            bool get_textescaping();
+
+            // Sets UTF-8 paragraph text. Text is then escaped as above,
+            // except non-ASCII characters are written as \uN? escapes.
+            void set_utf8text( bool enable );
+
+            // Gets UTF-8 paragraph text state
+            bool get_utf8text();
+
+            // Sets binary picture data. Images are then embedded as raw
+            // bytes after \binN instead of hex, half the size and no
+            // encoding. Off by default. Pictures over INT_MAX bytes do
+            // not fit \binN and fail with RTF_IMAGE_ERROR.
+            void set_binaryimages( bool enable );
+
+            // Gets binary picture data state
+            bool get_binaryimages();
+
+            // Sets image cache used by load_image(), NULL for none.
+            // Cache is not deleted by document and may be shared.
+            void set_imagecache( RtfImageCache* cache );
+
+            // Gets image cache
+            RtfImageCache* get_imagecache();
+
+            // Adds paragraph style to stylesheet, returns style number
+            // or -1. Styles must be added before open().
+            int add_paragraphstyle( const char* name, RTF_PARAGRAPH_FORMAT* pf );
+
+            // Adds character style to stylesheet, returns style number
+            // or -1. Styles must be added before open().
+            int add_characterstyle( const char* name, RTF_CHARACTER_FORMAT* cf );
+
+            // Removes all styles
+            void clear_styles();
+
+            // Sets paragraph style of following paragraphs, -1 for none.
+            // Paragraphs then write \sN and properties differing from style.
+            bool set_paragraphstyle( int style );
+
+            // Sets character style of following paragraphs, -1 for none
+            bool set_characterstyle( int style );
+
+            // Writes RTF document header
+            bool write_header();
+
+            // Sets document params
+            void init();
+
+            // Sets new RTF document font table
+            void set_fonttable( const char* fonts );
+
+            // Sets new RTF document color table
+            void set_colortable( const char* colors );
+
+            // Gets font number of font name, adding font to font table
+            // if new. Fonts are added only while a document opened by
+            // open_deferred() is open, otherwise -1 is returned for a
+            // new font, as for an invalid name.
+            int font( const char* name );
+
+            // Gets color number of RGB color (0-255), adding color to
+            // color table if new as font() does.
+            int color( int red, int green, int blue );
+
+            // Gets RTF document formatting properties
+            RTF_DOCUMENT_FORMAT* get_documentformat();
+
+            // Sets RTF document formatting properties
+            void set_documentformat( RTF_DOCUMENT_FORMAT* df );
+
+            // Writes RTF document formatting properties
+            bool write_documentformat();
+
+            // Gets RTF section formatting properties
+            RTF_SECTION_FORMAT* get_sectionformat();
+
+            // Sets RTF section formatting properties
+            void set_sectionformat( RTF_SECTION_FORMAT* sf );
+
+            // Writes RTF section formatting properties
+            bool write_sectionformat();
+
+            // Starts new RTF section
+            RTF_ERROR_TYPE start_section();
+
+            // Gets RTF paragraph formatting properties
+            RTF_PARAGRAPH_FORMAT* get_paragraphformat();
+
+            // Sets RTF paragraph formatting properties
+            void set_paragraphformat( RTF_PARAGRAPH_FORMAT* pf );
+
+            // Writes RTF paragraph formatting properties
+            bool write_paragraphformat();
+
+            // Starts new RTF paragraph
+            RTF_ERROR_TYPE start_paragraph( const char* text, bool newPar );
+
+            // Writes RTF paragraph with precompiled format, current
+            // paragraph format is not used nor changed.
+            RTF_ERROR_TYPE write_paragraph( const RtfParagraphHandle& handle,
+                                            const char* text, bool newPar );
+
+            // Writes RTF paragraph of number text with precompiled format.
+            // Text follows a \tab when format has a decimal tab stop, so
+            // numbers of paragraphs line up at decimal point.
+            RTF_ERROR_TYPE write_number( const RtfParagraphHandle& handle,
+                                         const char* text, size_t length, bool newPar );
+
+            // Writes RTF paragraph of number as write_number(), converted
+            // without locale, see librtfnumber.h
+            RTF_ERROR_TYPE write_integer( const RtfParagraphHandle& handle, long long value,
+                                          const RTF_NUMBER_FORMAT* nf, bool newPar );
+            RTF_ERROR_TYPE write_fixed( const RtfParagraphHandle& handle, long long value,
+                                        int scale, const RTF_NUMBER_FORMAT* nf, bool newPar );
+            RTF_ERROR_TYPE write_double( const RtfParagraphHandle& handle, double value,
+                                         const RTF_NUMBER_FORMAT* nf, bool newPar );
+
+            // Loads image from file. PNG and JPEG are embedded as is with
+            // \pngblip or \jpegblip, other formats need OLE on Windows.
+            // width and height are scale in percent.
+            RTF_ERROR_TYPE load_image( const char* image, int width, int height );
+
+            // Loads image from a read-only memory mapping of file,
+            // bytes are encoded from mapping without reading file.
+            RTF_ERROR_TYPE load_mappedimage( const char* image, int width, int height );
+
+            // Loads image from memory, bytes are encoded in place
+            RTF_ERROR_TYPE load_image( const unsigned char* data, size_t size,
+                                       int width, int height );
+
+            // Loads image from memory span, containers are passed as
+            // RtfByteSpan( container )
+            RTF_ERROR_TYPE load_image( RtfByteSpan image, int width, int height );
+
+            // Sets default RTF document formatting
+            void set_defaultformat();
+
+            // Starts new RTF table row
+            RTF_ERROR_TYPE start_tablerow();
+
+            // Starts new RTF table row with all cells of frozen row
+            // definition, start_tablecell() is not called for them.
+            RTF_ERROR_TYPE start_tablerow( const RtfRowTemplate& row );
+
+            // Ends RTF table row
+            RTF_ERROR_TYPE end_tablerow();
+
+            // Starts new RTF table cell
+            RTF_ERROR_TYPE start_tablecell( int rightMargin );
+
+            // Ends RTF table cell
+            RTF_ERROR_TYPE end_tablecell();
+
+            // Freezes current row format and cells started with
+            // start_tablecell() since start_tablerow() into a row
+            // definition, for start_tablerow() of following rows. Row
+            // started from a template freezes to that template and
+            // cells started after it.
+            RtfRowTemplate freeze_tablerow() const;
+
+            // Writes whole RTF table of rows by schema columns. cells holds
+            // rows * columns text spans, row after row with
+            // RTF_TABLELAYOUT_ROWS or column after column with
+            // RTF_TABLELAYOUT_COLUMNS. Current row, cell and paragraph
+            // formats are not used nor changed.
+            RTF_ERROR_TYPE write_table( const RtfTableSchema& schema,
+                                        const RTF_TEXTSPAN* cells, size_t rows,
+                                        int layout = RTF_TABLELAYOUT_ROWS );
+
+            // Writes RTF table cell paragraph with precompiled format
+            // and ends cell. NULL text writes an empty cell.
+            RTF_ERROR_TYPE write_tablecell( const RtfParagraphHandle& handle,
+                                            const char* text, size_t length );
+
+            // Writes RTF table cell of number text with precompiled format
+            // and ends cell, text follows a \tab as in write_number()
+            RTF_ERROR_TYPE write_numbercell( const RtfParagraphHandle& handle,
+                                             const char* text, size_t length );
+
+            // Gets RTF table row formatting properties
+            RTF_TABLEROW_FORMAT* get_tablerowformat();
+
+            // Sets RTF table row formatting properties
+            void set_tablerowformat( RTF_TABLEROW_FORMAT* rf );
+
+            // Gets RTF table cell formatting properties
+            RTF_TABLECELL_FORMAT* get_tablecellformat();
+
+            // Sets RTF table cell formatting properties
+            void set_tablecellformat( RTF_TABLECELL_FORMAT* cf );
+
+        private:
+            RTF_ERROR_TYPE open_sink( RtfSink* sink, const char* filename,
+                                      const char* fonts, const char* colors,
+                                      RTF_DOCUMENT_FORMAT* fmt );
+            RTF_ERROR_TYPE open_prologue( RtfSink* sink, const char* filename,
+                                          const RtfPrologue& prologue );
+            bool attach_sink( RtfSink* sink, const char* filename );
+            bool release_sink();
+            bool write_deferred();
+            void clear_fonttable();
+            int  add_fontentry( const char* name, size_t length, const char* family );
+            void clear_colortable();
+            int  add_colorentry( int red, int green, int blue );
+            bool can_addentry();
+            bool write_out( const char* data, size_t size );
+            bool end_fragment();
+            void put_stylesheet();
+            void put_handleparagraph( const RtfParagraphHandle& handle, bool newPar );
+            void put_styledparagraph();
+            void put_text( const char* text );
+            void put_text( const char* text, size_t length );
+            void put_tablecell( const RtfParagraphHandle& handle,
+                                const char* text, size_t length );
+            bool begin_image();
+            void begin_picture();
+            RTF_ERROR_TYPE write_picture( const RtfImageBlob& blob );
+            RTF_ERROR_TYPE write_image( const unsigned char* data, size_t size,
+                                        int width, int height,
+                                        std::string& key, bool searched );
+            RTF_ERROR_TYPE load_imagefile( const char* image, int width, int height,
+                                           bool mapped );
+            RTF_ERROR_TYPE put_picture( RtfBuffer& out,
+                                        const unsigned char* data, size_t size,
+                                        int width, int height );
+            RTF_ERROR_TYPE put_oleimage( RtfBuffer& out,
+                                         const unsigned char* data, size_t size,
+                                         int width, int height );
+            std::string get_picturekey( const std::string& key, int width, int height );
+
+        private:
+            // Stylesheet entry
+            struct RtfStyle
+            {
+                int                     number;
+                bool                    character;
+                std::string             name;
+                RTF_PARAGRAPH_FORMAT    format;
+            };
+
+            // Cell started in current table row
+            struct RtfRowCell
+            {
+                int                     rightMargin;
+                RTF_TABLECELL_FORMAT    format;
+            };
+
+            // Font number by name, color number by 0xRRGGBB
+            typedef std::unordered_map<std::string, int>    RtfFontIndex;
+            typedef std::unordered_map<unsigned int, int>   RtfColorIndex;
+
+        private:
+            RTF_DOCUMENT_FORMAT     rtfDocFormat;
+            RTF_SECTION_FORMAT      rtfSecFormat;
+            RTF_PARAGRAPH_FORMAT    rtfParFormat;
+            RTF_TABLEROW_FORMAT     rtfRowFormat;
+            RTF_TABLECELL_FORMAT    rtfCellFormat;
+            std::vector<RtfRowCell> rtfRowCells;    /// cells of current row
+            RtfRowTemplate          rtfRowStart;    /// template current row started from
+            bool                    rtfRowTemplated;
+            RtfSink*                rtfSink;
+            bool                    rtfSinkOwned;
+            bool                    rtfFragment;
+            RtfBuffer               rtfOut;
+            bool                    rtfUnbuffered;
+            bool                    rtfDeltaFormat;
+            bool                    rtfEscapeText;
+            bool                    rtfUtf8Text;
+            bool                    rtfBinaryImages;
+            RtfImageCache*          rtfImageCache;
+            bool                    rtfLastValid;
+            RTF_PARAGRAPH_FORMAT    rtfLastParFormat;   /// last written formatting
+            std::vector<RtfStyle>   rtfStyles;
+            int                     rtfParStyle;
+            int                     rtfCharStyle;
+            int                     rtfLastParStyle;
+            int                     rtfLastCharStyle;
+            std::string             rtfFontTable;
+            std::string             rtfColorTable;
+            RtfFontIndex            rtfFontIndex;
+            RtfColorIndex           rtfColorIndex;
+            int                     rtfFontCount;
+            int                     rtfColorCount;
+            void*                   rtfPicture;     /// IPicture of last image
+            char*                   rtfTextBuffer;  /// paragraph text copy
+            size_t                  rtfTextSize;
+            RtfSpoolSink*           rtfSpool;       /// body of deferred document
+            RtfSink*                rtfDeferredSink;
+            const RtfDocument*      rtfTableSource; /// prologue tables, NULL for own
+    };
+};
+
+#endif /// of __LIBRTFDOCUMENT_H__
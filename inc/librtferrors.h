@@ -12,6 +12,7 @@
 #define RTF_PARAGRAPHFORMAT_ERROR	0x0006	/// Could not write paragraph formatting properties to RTF file
 #define RTF_IMAGE_ERROR				0x0007	/// Could not write image to RTF file
 #define RTF_TABLE_ERROR				0x0008	/// Could not write table to RTF file
+#define RTF_TEMPLATE_ERROR			0x0009	/// Could not load or merge RTF template
 #define RTF_SUCCESS					0x1000	/// No error
 
 #endif /// of __LIBRTF_ERRORS_H__
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef __LIBRTFESCAPE_H__
+#define __LIBRTFESCAPE_H__
+
+#include <cstddef>
+
+#include "librtfdefines.h"
+#include "librtfbuffer.h"
+
+namespace librtf
+{
+    // Appends text as RTF text: \ { } are escaped, newline and tab are
+    // written as \line and \tab, other control and non-ASCII bytes as \'hh.
+    // Runs of plain text are found 16 or 32 bytes at a time and copied
+    // in bulk, the fastest method supported by running CPU is used.
+    void put_escaped( RtfBuffer& out, const char* text, size_t size );
+
+    // Same as above with a given RTF_ESCAPE_* method
+    void put_escaped( RtfBuffer& out, const char* text, size_t size, int method );
+
+    // Appends UTF-8 text as RTF text, escaped as put_escaped() does except
+    // non-ASCII characters are written as \uN? Unicode escapes, with
+    // surrogate pairs above U+FFFF. Invalid UTF-8 is written as U+FFFD.
+    // ASCII runs are copied in bulk as by put_escaped(), blocks of 2 and 3
+    // byte sequences are validated and decoded 16 bytes at a time.
+    void put_escapedutf8( RtfBuffer& out, const char* text, size_t size );
+
+    // Same as above with a given RTF_ESCAPE_* method
+    void put_escapedutf8( RtfBuffer& out, const char* text, size_t size, int method );
+
+    // Gets fastest RTF_ESCAPE_* method supported by running CPU
+    int get_escapemethod();
+
+    // Gets RTF_ESCAPE_* method name
+    const char* get_escapemethodname( int method );
+};
+
+#endif /// of __LIBRTFESCAPE_H__
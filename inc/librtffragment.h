@@ -0,0 +1,43 @@
+#ifndef __LIBRTFFRAGMENT_H__
+#define __LIBRTFFRAGMENT_H__
+
+#include <cstddef>
+
+#include "librtferrors.h"
+#include "librtfdefines.h"
+
+namespace librtf
+{
+    class RtfDocument;
+
+    // Renders fragment of given index into fragment document,
+    // returns false to stop building.
+    typedef bool (*RTF_FRAGMENT_CALLBACK)( RtfDocument* fragment, size_t index, void* param );
+
+    // Parallel fragment builder.
+    // Worker threads render fragments, usually sections, each into its own
+    // detached buffer through a fragment document opened from target
+    // document. Buffers are appended to target document in index order,
+    // so output is the same as rendering them one after another.
+    // Font, color and style tables are the target ones and must not
+    // change while building.
+    class RtfFragmentBuilder
+    {
+        public:
+            // Uses given number of worker threads, 0 for one per CPU
+            RtfFragmentBuilder( int threads = 0 );
+
+        public:
+            // Renders count fragments and appends them to document
+            RTF_ERROR_TYPE build( RtfDocument* doc, size_t count,
+                                  RTF_FRAGMENT_CALLBACK cb, void* param = NULL );
+
+            // Gets number of worker threads
+            int get_threads()                   { return threads; }
+
+        private:
+            int     threads;
+    };
+};
+
+#endif /// of __LIBRTFFRAGMENT_H__
@@ -0,0 +1,35 @@
+#ifndef __LIBRTFHEX_H__
+#define __LIBRTFHEX_H__
+
+#include <cstddef>
+
+#include "librtfdefines.h"
+#include "librtfbuffer.h"
+
+namespace librtf
+{
+    // Converts binary data to lowercase hex, dst must hold 2*size chars.
+    // Not NUL terminated.
+    void hex_encode( char* dst, const unsigned char* src, size_t size );
+
+    // Same as above with a given RTF_HEX_* method
+    void hex_encode( char* dst, const unsigned char* src, size_t size, int method );
+
+    // Appends binary data as hex, encoded straight into buffer free space
+    // chunk by chunk. A newline is put after every lineWidth hex chars,
+    // 0 writes one line.
+    void put_hex( RtfBuffer& out, const unsigned char* data, size_t size,
+                  size_t lineWidth = 0 );
+
+    // Same as above with a given RTF_HEX_* method
+    void put_hex( RtfBuffer& out, const unsigned char* data, size_t size,
+                  size_t lineWidth, int method );
+
+    // Gets fastest RTF_HEX_* method supported by running CPU
+    int get_hexmethod();
+
+    // Gets RTF_HEX_* method name
+    const char* get_hexmethodname( int method );
+};
+
+#endif /// of __LIBRTFHEX_H__
@@ -0,0 +1,86 @@
+#ifndef __LIBRTFIMAGE_H__
+#define __LIBRTFIMAGE_H__
+
+#include <cstddef>
+
+#include "librtfdefines.h"
+
+namespace librtf
+{
+    // Image properties read from image header
+    struct RTF_IMAGE_INFO
+    {
+        int imageType;                      // RTF_IMAGETYPE_*
+        int width;                          // Width in pixels
+        int height;                         // Height in pixels
+        int dpiX;                           // Horizontal resolution, 96 if not stored
+        int dpiY;                           // Vertical resolution, 96 if not stored
+    };
+
+    // Read-only view of image bytes, built from pointer and size or from
+    // any container with data() and size(), bytes are not copied.
+    // Container constructor is explicit, so a std::string file name is
+    // never taken for image bytes.
+    class RtfByteSpan
+    {
+        public:
+            RtfByteSpan()
+             : ptr( NULL ),
+               len( 0 )
+            {
+            }
+
+            RtfByteSpan( const void* data, size_t size )
+             : ptr( (const unsigned char*)data ),
+               len( size )
+            {
+            }
+
+            template <class T>
+            explicit RtfByteSpan( const T& container )
+             : ptr( (const unsigned char*)container.data() ),
+               len( container.size() * sizeof( *container.data() ) )
+            {
+            }
+
+        public:
+            const unsigned char* data() const   { return ptr; }
+            size_t size() const                 { return len; }
+
+        private:
+            const unsigned char*    ptr;
+            size_t                  len;
+    };
+
+    // Read-only memory mapping of a whole file
+    class RtfMappedFile
+    {
+        public:
+            RtfMappedFile();
+            ~RtfMappedFile();
+
+        private:
+            RtfMappedFile( const RtfMappedFile& );
+            RtfMappedFile& operator=( const RtfMappedFile& );
+
+        public:
+            // Maps file, returns false on error or for empty files
+            bool open( const char* filename );
+            // Unmaps file
+            void close();
+
+            const unsigned char* data() const   { return ptr; }
+            size_t size() const                 { return len; }
+
+        private:
+            const unsigned char*    ptr;
+            size_t                  len;
+            void*                   mapping;    /// file mapping handle on Windows
+    };
+
+    // Reads PNG (IHDR, pHYs) or JPEG (SOFn, JFIF) header without decoding
+    // image, returns false for other formats or damaged headers
+    bool get_imageinfo( const unsigned char* data, size_t size, RTF_IMAGE_INFO* info );
+};
+
+#endif /// of __LIBRTFIMAGE_H__
@@ -0,0 +1,133 @@
+#ifndef __LIBRTFIMAGECACHE_H__
+#define __LIBRTFIMAGECACHE_H__
+
+#include <cstddef>
+#include <ctime>
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "librtfdefines.h"
+
+namespace librtf
+{
+    // Encoded picture group, shared between cache and writers
+    typedef std::shared_ptr<const std::string> RtfImageBlob;
+
+    // Image cache counters
+    struct RTF_IMAGECACHE_STATS
+    {
+        size_t hits;                        // Pictures found in cache
+        size_t misses;                      // Pictures encoded
+        size_t evictions;                   // Pictures dropped for budget
+        size_t entries;                     // Cached pictures
+        size_t bytes;                       // Cached picture bytes
+        size_t budget;                      // Memory budget in bytes
+    };
+
+    // Image file identity, from stat()
+    struct RTF_IMAGEFILE_ID
+    {
+        unsigned long long device;          // Device of file
+        unsigned long long inode;           // File serial number, 0 where unknown
+        time_t mtime;                       // Modification time in seconds
+        long mtimeNsec;                     // Nanoseconds of modification time, 0 where unknown
+        size_t size;                        // File size in bytes
+    };
+
+    // Cache of encoded {\pict ...} groups keyed by image content.
+    // Content key is a fast 128 bit hash, not collision-proof, so a hit
+    // is taken only when image bytes equal those of cached picture. This
+    // needs a copy of image bytes next to each picture, half again the
+    // memory of a hex picture and twice that of a \bin one. Cached bytes
+    // count both against budget.
+    // Image files are also indexed by path, device, inode, nanosecond
+    // modification time and size, so an unchanged file is neither read
+    // nor hashed again. Least recently used pictures are dropped when
+    // cached bytes exceed budget. All functions are thread-safe, one
+    // cache may serve many documents.
+    class RtfImageCache
+    {
+        public:
+            RtfImageCache( size_t budget = RTF_DEFAULT_IMAGECACHESIZE );
+            ~RtfImageCache();
+
+        private:
+            RtfImageCache( const RtfImageCache& );
+            RtfImageCache& operator=( const RtfImageCache& );
+
+        public:
+            // Gets content key of image data, equal for equal data
+            static std::string get_contentkey( const unsigned char* data, size_t size );
+
+            // Gets identity of a file, false if it can not be stat'ed
+            static bool get_fileid( const char* path, RTF_IMAGEFILE_ID* id );
+
+            // Finds content key of an unchanged file
+            bool find_file( const char* path, const RTF_IMAGEFILE_ID& id, std::string& key );
+
+            // Adds content key of a file
+            void insert_file( const char* path, const RTF_IMAGEFILE_ID& id, const std::string& key );
+
+            // Finds picture of image bytes, counts hit or miss. NULL image
+            // skips comparison, for keys of indexed files. collision is set
+            // when key holds a picture of other image bytes.
+            RtfImageBlob find( const std::string& key, const unsigned char* image = NULL,
+                               size_t imagesize = 0, bool* collision = NULL );
+
+            // Adds picture of image bytes, returns shared copy. Pictures
+            // larger than budget are returned but not cached, as are those
+            // whose key holds a picture of other image bytes, collision is
+            // set for them.
+            RtfImageBlob insert( const std::string& key, const char* data, size_t size,
+                                 const unsigned char* image, size_t imagesize,
+                                 bool* collision = NULL );
+
+            // Sets memory budget, evicting as needed
+            void set_budget( size_t budget );
+
+            // Drops all pictures, counters are kept
+            void clear();
+
+            // Gets counters
+            void get_stats( RTF_IMAGECACHE_STATS* stats );
+
+        private:
+            void evict( size_t budget );
+            static bool same_image( const std::string& cached, const unsigned char* image,
+                                    size_t imagesize );
+
+        private:
+            // Cached picture
+            struct RtfImageEntry
+            {
+                std::string     key;
+                RtfImageBlob    blob;
+                std::string     image;      /// image bytes, compared on hits
+            };
+
+            // Indexed image file
+            struct RtfImageFile
+            {
+                RTF_IMAGEFILE_ID    id;
+                std::string         key;
+            };
+
+            typedef std::list<RtfImageEntry> RtfImageList;
+
+        private:
+            std::mutex                                              cacheLock;
+            RtfImageList                                            cacheList;  /// most recent first
+            std::unordered_map<std::string, RtfImageList::iterator> cacheMap;
+            std::unordered_map<std::string, RtfImageFile>           cacheFiles;
+            size_t                                                  cacheBytes;
+            size_t                                                  cacheBudget;
+            size_t                                                  cacheHits;
+            size_t                                                  cacheMisses;
+            size_t                                                  cacheEvictions;
+    };
+};
+
+#endif /// of __LIBRTFIMAGECACHE_H__
@@ -0,0 +1,89 @@
+#ifndef __LIBRTFMERGE_H__
+#define __LIBRTFMERGE_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "librtferrors.h"
+#include "librtfdefines.h"
+#include "librtfsink.h"
+#include "librtfbuffer.h"
+#include "librtftable.h"
+
+namespace librtf
+{
+    // Mail merge template.
+    // RTF template holding {{name}} placeholders, as raw text or escaped
+    // as \{\{name\}\} by text escaping. Names are letters, digits, '_',
+    // '.' and '-', up to RTF_MERGE_MAXNAMELENGTH chars. Placeholder
+    // offsets are indexed once by load(), a merge then writes static
+    // slices as they are and values escaped as RTF text in between.
+    // Template is not changed by merge(), so many threads may merge
+    // from it, each into its own buffer.
+    class RtfMergeTemplate
+    {
+        public:
+            RtfMergeTemplate();
+
+        private:
+            RtfMergeTemplate( const RtfMergeTemplate& );
+            RtfMergeTemplate& operator=( const RtfMergeTemplate& );
+
+        public:
+            // Loads template from memory, data is copied
+            RTF_ERROR_TYPE load( const char* data, size_t size );
+
+            // Loads template from file
+            RTF_ERROR_TYPE load_file( const char* filename );
+
+            // Gets number of distinct placeholder names, values given to
+            // merge() are indexed by field number
+            size_t get_fields() const               { return names.size(); }
+
+            // Gets placeholder name of field number
+            const char* get_fieldname( size_t field ) const;
+
+            // Gets field number of placeholder name, -1 if not in template
+            int get_field( const char* name ) const;
+
+            // Gets number of placeholders, a name may be used many times
+            size_t get_placeholders() const         { return slices.size() - 1; }
+
+            // Gets template size in bytes
+            size_t size() const                     { return text.size(); }
+
+            // Appends template with field values, one per field number.
+            // NULL value text leaves placeholder empty. Values are escaped
+            // as put_escaped() does, or as put_escapedutf8() with utf8.
+            RTF_ERROR_TYPE merge( RtfBuffer& out, const RTF_TEXTSPAN* values,
+                                  bool utf8 = false ) const;
+
+            // Writes merged template to sink, sink is not closed.
+            // Merging into a reused buffer saves allocating one per call.
+            RTF_ERROR_TYPE merge( RtfSink* sink, const RTF_TEXTSPAN* values,
+                                  bool utf8 = false ) const;
+
+        private:
+            // Static template bytes followed by a placeholder
+            struct RtfMergeSlice
+            {
+                size_t  offset;
+                size_t  length;
+                int     field;      /// -1 for last slice
+            };
+
+            void clear();
+            int add_field( const char* name, size_t length );
+            size_t match_placeholder( size_t pos, const char** name, size_t* namelen ) const;
+
+        private:
+            std::string                             text;
+            std::vector<RtfMergeSlice>              slices;
+            std::vector<std::string>                names;
+            std::unordered_map<std::string, int>    fields;
+    };
+};
+
+#endif /// of __LIBRTFMERGE_H__
@@ -0,0 +1,38 @@
+#ifndef __LIBRTFNUMBER_H__
+#define __LIBRTFNUMBER_H__
+
+#include <cstddef>
+
+#include "librtfdefines.h"
+
+namespace librtf
+{
+    // Number text format
+    struct RTF_NUMBER_FORMAT
+    {
+        int precision;                      // Fraction digits, RTF_NUMBER_SHORTEST for as many as needed
+        char decimalPoint;                  // Decimal point character
+        char thousandsSeparator;            // Thousands separator character, 0 for none
+    };
+
+    // Number conversions below don't use locale, default format (NULL)
+    // is shortest precision, '.' decimal point and no separator.
+    // dst must hold RTF_NUMBER_BUFFERSIZE chars, text is NUL terminated.
+    // Return text length.
+
+    // Converts integer to text, precision adds zero fraction digits
+    size_t format_integer( char* dst, long long value,
+                           const RTF_NUMBER_FORMAT* nf = NULL );
+
+    // Converts fixed-point value / 10^scale to text. Precision below
+    // scale rounds half away from zero, shortest drops trailing zeros.
+    size_t format_fixed( char* dst, long long value, int scale,
+                         const RTF_NUMBER_FORMAT* nf = NULL );
+
+    // Converts double to text without exponent. Shortest precision gives
+    // the shortest text reading back as the same double.
+    size_t format_double( char* dst, double value,
+                          const RTF_NUMBER_FORMAT* nf = NULL );
+};
+
+#endif /// of __LIBRTFNUMBER_H__
@@ -0,0 +1,34 @@
+#ifndef __LIBRTFPARAGRAPH_H__
+#define __LIBRTFPARAGRAPH_H__
+
+#include <cstddef>
+#include <string>
+
+#include "librtfstructures.h"
+
+namespace librtf
+{
+    // Precompiled paragraph format.
+    // Holds the control words of a RTF_PARAGRAPH_FORMAT serialized once,
+    // so writing a paragraph with it is a copy of those bytes and text.
+    // Handle is immutable, it may be shared between threads and documents.
+    class RtfParagraphHandle
+    {
+        public:
+            RtfParagraphHandle( const RTF_PARAGRAPH_FORMAT* pf );
+
+        public:
+            // Gets paragraph format handle was compiled from
+            const RTF_PARAGRAPH_FORMAT* format() const  { return &fmt; }
+            // Gets control words, from \pard up to paragraph text
+            const char* data() const                    { return prefix.data(); }
+            // Gets control words size in bytes
+            size_t size() const                         { return prefix.size(); }
+
+        private:
+            RTF_PARAGRAPH_FORMAT    fmt;
+            std::string             prefix;
+    };
+};
+
+#endif /// of __LIBRTFPARAGRAPH_H__
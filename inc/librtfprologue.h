@@ -0,0 +1,50 @@
+#ifndef __LIBRTFPROLOGUE_H__
+#define __LIBRTFPROLOGUE_H__
+
+#include <cstddef>
+#include <string>
+
+#include "librtferrors.h"
+#include "librtfdefines.h"
+#include "librtfstructures.h"
+#include "librtfdocument.h"
+
+namespace librtf
+{
+    // Precompiled document prologue.
+    // Header, font and color tables, document format and first section
+    // are written once, as open() would write them, and kept with the
+    // formats they were written from. Documents opened with a prologue
+    // copy its bytes instead of rebuilding them. Prologue is not changed
+    // after construction, so many threads may open documents from it.
+    // Stylesheet is not part of prologue, such documents have no styles.
+    class RtfPrologue
+    {
+        public:
+            // Compiles prologue, arguments are those of RtfDocument::open()
+            RtfPrologue( const char* fonts = NULL,
+                         const char* colors = NULL,
+                         RTF_DOCUMENT_FORMAT* fmt = NULL );
+
+        private:
+            RtfPrologue( const RtfPrologue& );
+            RtfPrologue& operator=( const RtfPrologue& );
+
+        public:
+            // Gets compile result, RTF_SUCCESS when prologue is usable
+            RTF_ERROR_TYPE get_error() const    { return error; }
+            // Gets prologue bytes
+            const char* data() const            { return bytes.data(); }
+            // Gets prologue size in bytes
+            size_t size() const                 { return bytes.size(); }
+
+        private:
+            friend class RtfDocument;
+
+            RtfDocument     document;   /// tables and formats of prologue
+            std::string     bytes;
+            RTF_ERROR_TYPE  error;
+    };
+};
+
+#endif /// of __LIBRTFPROLOGUE_H__
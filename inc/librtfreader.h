@@ -0,0 +1,74 @@
+#ifndef __LIBRTFREADER_H__
+#define __LIBRTFREADER_H__
+
+#include <cstddef>
+
+#include "librtferrors.h"
+#include "librtfdefines.h"
+
+namespace librtf
+{
+    // RTF token, text points into tokenized data
+    struct RTF_TOKEN
+    {
+        int type;                           // RTF_TOKEN_* token type
+        const char* text;                   // Word name, symbol, text, hex digits or binary data
+        size_t length;                      // Text length in bytes
+        int param;                          // Word parameter, hex byte value or binary size
+        bool hasParam;                      // Word has a parameter
+    };
+
+    // Gets token, returns false to stop tokenizing
+    typedef bool (*RTF_TOKEN_CALLBACK)( const RTF_TOKEN& token, void* param );
+
+    // Streaming RTF tokenizer.
+    // Splits RTF data in group starts and ends, control words with
+    // their parameter, control symbols, text runs, \'hh hex bytes and
+    // \binN binary data. Tokens point into data, nothing is copied, so
+    // data must be kept while tokens are used. CR and LF are not text
+    // and are skipped. Text runs end at \ { } CR LF, found 16 or 32
+    // bytes at a time with the fastest RTF_ESCAPE_* method of CPU.
+    class RtfTokenizer
+    {
+        public:
+            // Uses given RTF_ESCAPE_* method for delimiter scan
+            RtfTokenizer( int method = RTF_ESCAPE_AUTO );
+
+        public:
+            // Sets data to tokenize, group depth is kept. When last is
+            // false more data follows, tokens which may go on past end
+            // of data are then left for next data, see get_offset().
+            void set_data( const char* data, size_t size, bool last = true );
+
+            // Drops data and group depth
+            void reset();
+
+            // Gets next token, false when data is done
+            bool next( RTF_TOKEN& token );
+
+            // Gets offset of first data byte not tokenized
+            size_t get_offset() const           { return pos; }
+
+            // Gets group depth, negative after an unbalanced }
+            int get_depth() const               { return depth; }
+
+        private:
+            bool next_controlword( RTF_TOKEN& token );
+            bool next_controlsymbol( RTF_TOKEN& token );
+
+        private:
+            const char*     data;
+            size_t          size;
+            size_t          pos;
+            bool            last;
+            int             depth;
+            int             method;
+    };
+
+    // Tokenizes whole data, calls back for each token. Returns RTF_ERROR
+    // on RTF_TOKEN_ERROR tokens or when callback stops.
+    RTF_ERROR_TYPE tokenize( const char* data, size_t size,
+                             RTF_TOKEN_CALLBACK cb, void* param = NULL );
+};
+
+#endif /// of __LIBRTFREADER_H__
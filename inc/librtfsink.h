@@ -0,0 +1,148 @@
+#ifndef __LIBRTFSINK_H__
+#define __LIBRTFSINK_H__
+
+#include <cstdio>
+#include <cstddef>
+
+#include "librtfdefines.h"
+
+namespace librtf
+{
+    // Scatter write block
+    struct RTF_IOVEC
+    {
+        const void* base;                   // Block data
+        size_t size;                        // Block size in bytes
+    };
+
+    // RTF output sink, receives all bytes of a RTF document.
+    class RtfSink
+    {
+        public:
+            virtual ~RtfSink() {}
+
+        public:
+            // Writes data, returns false if not all bytes are written
+            virtual bool write( const void* data, size_t size ) = 0;
+
+            // Writes several blocks in order, as one call when possible
+            virtual bool writev( const RTF_IOVEC* iov, int count );
+
+            // Flushes buffered data, sink stays usable, returns false on error
+            virtual bool flush() { return true; }
+
+            // Flushes and closes sink, returns false on error
+            virtual bool close() { return true; }
+    };
+
+    // Writes to a stdio FILE
+    class RtfFileSink : public RtfSink
+    {
+        public:
+            // Creates (truncates) a file in binary mode
+            RtfFileSink( const char* filename );
+            // Writes to an opened FILE, which is not closed by sink
+            RtfFileSink( FILE* fp );
+            ~RtfFileSink();
+
+        public:
+            bool write( const void* data, size_t size );
+            bool flush();
+            bool close();
+            bool is_open() { return ( fp != NULL ); }
+
+        private:
+            FILE*   fp;
+            bool    owned;
+    };
+
+    // Writes to a growable memory buffer
+    class RtfMemorySink : public RtfSink
+    {
+        public:
+            RtfMemorySink( size_t reserve = 0 );
+            ~RtfMemorySink();
+
+        public:
+            bool write( const void* data, size_t size );
+
+            // Gets written data, not NUL terminated
+            const char* data() { return buffer; }
+            // Gets written data size in bytes
+            size_t size() { return length; }
+            // Drops written data but keeps allocated buffer
+            void clear() { length = 0; }
+            // Takes buffer ownership, caller must free() it
+            char* detach( size_t* size );
+
+        private:
+            char*   buffer;
+            size_t  length;
+            size_t  capacity;
+    };
+
+    // Keeps written data in memory up to limit bytes, then rest of
+    // it in a temporary file, so memory use stays bounded
+    class RtfSpoolSink : public RtfSink
+    {
+        public:
+            RtfSpoolSink( size_t limit = RTF_DEFAULT_SPOOLSIZE );
+            ~RtfSpoolSink();
+
+        private:
+            RtfSpoolSink( const RtfSpoolSink& );
+            RtfSpoolSink& operator=( const RtfSpoolSink& );
+
+        public:
+            bool write( const void* data, size_t size );
+
+            // Writes all spooled data to sink
+            bool copy_to( RtfSink* sink );
+
+            // Gets spooled data size in bytes
+            size_t size() { return length; }
+
+        private:
+            RtfMemorySink   memory;
+            FILE*           file;
+            size_t          length;
+            size_t          limit;
+    };
+
+    // Writes to a raw file descriptor
+    class RtfFdSink : public RtfSink
+    {
+        public:
+            // Closes fd on close() if owned is true
+            RtfFdSink( int fd, bool owned = false );
+            ~RtfFdSink();
+
+        public:
+            bool write( const void* data, size_t size );
+            bool writev( const RTF_IOVEC* iov, int count );
+            bool close();
+
+        private:
+            int     fd;
+            bool    owned;
+    };
+
+    // User write callback, returns false to stop writing
+    typedef bool (*RTF_WRITE_CALLBACK)( const void* data, size_t size, void* param );
+
+    // Writes through a user callback
+    class RtfCallbackSink : public RtfSink
+    {
+        public:
+            RtfCallbackSink( RTF_WRITE_CALLBACK cb, void* param = NULL );
+
+        public:
+            bool write( const void* data, size_t size );
+
+        private:
+            RTF_WRITE_CALLBACK  callback;
+            void*               param;
+    };
+};
+
+#endif /// of __LIBRTFSINK_H__
@@ -0,0 +1,135 @@
+#ifndef __LIBRTFTABLE_H__
+#define __LIBRTFTABLE_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "librtferrors.h"
+#include "librtfdefines.h"
+#include "librtfstructures.h"
+#include "librtfparagraph.h"
+#include "librtfnumber.h"
+
+namespace librtf
+{
+    // Text of a table cell, NULL text is an empty cell
+    struct RTF_TEXTSPAN
+    {
+        const char* text;                   // Cell text, not NUL terminated
+        size_t length;                      // Cell text length in bytes
+    };
+
+    // Frozen table row definition.
+    // Holds \trowd and \cellx control words of a row format and its cells
+    // serialized once, so starting a row with it is a copy of those bytes.
+    // Template is immutable once built, it may be shared between threads.
+    class RtfRowTemplate
+    {
+        public:
+            RtfRowTemplate( const RTF_TABLEROW_FORMAT* rf );
+
+        public:
+            // Adds cell definition, rightMargin is absolute as in
+            // start_tablecell(). Returns cell index or -1.
+            int add_cell( int rightMargin, const RTF_TABLECELL_FORMAT* cf );
+
+            // Gets number of cells
+            size_t get_cells() const                        { return cells; }
+            // Gets control words, from \trowd up to last \cellx
+            const char* data() const                        { return definition.data(); }
+            // Gets control words size in bytes
+            size_t size() const                             { return definition.size(); }
+
+        private:
+            std::string     definition;
+            size_t          cells;
+    };
+
+    // Table layout, columns with cell and paragraph formats.
+    // Row definition is frozen as columns are added, so writing a row
+    // copies it and cell texts only.
+    class RtfTableSchema
+    {
+        public:
+            RtfTableSchema( const RTF_TABLEROW_FORMAT* rf );
+
+        public:
+            // Adds column of given width in twips, returns column index
+            int add_column( int width,
+                            const RTF_TABLECELL_FORMAT* cf,
+                            const RTF_PARAGRAPH_FORMAT* pf );
+
+            // Gets number of columns
+            size_t get_columns() const                      { return paragraphs.size(); }
+
+            // Gets row and cell definitions
+            const RtfRowTemplate& get_row() const           { return row; }
+
+            // Gets column paragraph format
+            const RtfParagraphHandle& get_paragraph( size_t column ) const
+            {
+                return paragraphs[ column ];
+            }
+
+        private:
+            RtfRowTemplate                      row;
+            std::vector<RtfParagraphHandle>     paragraphs;
+            int                                 rightMargin;
+    };
+
+    class RtfDocument;
+
+    // Streaming table writer.
+    // Writes table rows by schema into document as cells come, holding
+    // no more than the current column of the row, so memory stays flat
+    // however many rows are written. Cells missing at end of row are
+    // written empty.
+    class RtfTableWriter
+    {
+        public:
+            RtfTableWriter( RtfDocument* doc, const RtfTableSchema* schema );
+
+        private:
+            RtfTableWriter( const RtfTableWriter& );
+            RtfTableWriter& operator=( const RtfTableWriter& );
+
+        public:
+            // Writes next cell of current row, starting a row if needed
+            RTF_ERROR_TYPE write_cell( const char* text );
+            RTF_ERROR_TYPE write_cell( const char* text, size_t length );
+
+            // Writes next cell of number text, after a \tab if column
+            // paragraph has a decimal tab stop
+            RTF_ERROR_TYPE write_number( const char* text, size_t length );
+
+            // Writes next cell of number, see librtfnumber.h
+            RTF_ERROR_TYPE write_integer( long long value, const RTF_NUMBER_FORMAT* nf = NULL );
+            RTF_ERROR_TYPE write_fixed( long long value, int scale,
+                                        const RTF_NUMBER_FORMAT* nf = NULL );
+            RTF_ERROR_TYPE write_double( double value, const RTF_NUMBER_FORMAT* nf = NULL );
+
+            // Ends current row
+            RTF_ERROR_TYPE end_row();
+
+            // Writes whole row of schema columns cells
+            RTF_ERROR_TYPE write_row( const RTF_TEXTSPAN* cells );
+
+            // Gets number of rows written
+            size_t get_rows() const                         { return rows; }
+
+            // Gets largest number of output bytes buffered at once
+            size_t get_highwater() const;
+
+        private:
+            RTF_ERROR_TYPE begin_cell();
+
+        private:
+            RtfDocument*            document;
+            const RtfTableSchema*   schema;
+            size_t                  column;
+            size_t                  rows;
+    };
+};
+
+#endif /// of __LIBRTFTABLE_H__
@@ -1,5 +1,8 @@
-#include <windows.h>
+#ifdef _WIN32
+    #include <windows.h>
+#endif
 
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -7,8 +10,11 @@
 
 #include <fcntl.h>
 #include <sys/stat.h>
-#include <io.h>
-#include <olectl.h>
+
+#ifdef _WIN32
+    #include <io.h>
+    #include <olectl.h>
+#endif
 
 #include "librtf.h"
 
@@ -16,144 +22,692 @@ using namespace std;
 
 ////////////////////////////////////////////////////////////////////////////////
 
-// RTF document formatting params
-static RTF_DOCUMENT_FORMAT rtfDocFormat = {0};
+static void strcats( char* ob, const char* ib, size_t obsz )
+{
+    if ( ( ob == NULL ) || ( ib == NULL ) || ( obsz == 0 ) )
+        return;
+
+#ifdef _WIN32
+    strcat_s( ob, obsz, ib );
+#else
+    size_t obl = strlen( ob );
+
+    if ( obl < obsz )
+        strncat( ob, ib, obsz - obl - 1 );
+#endif
+}
 
-// RTF section formatting params
-static RTF_SECTION_FORMAT rtfSecFormat = {0};
+// Gets next ';' separated token, empty tokens are skipped as strtok() does.
+static bool next_token( const char*& src, const char*& tok, size_t& toklen )
+{
+    while ( *src == ';' )
+        src++;
 
-// RTF paragraph formatting params
-static RTF_PARAGRAPH_FORMAT rtfParFormat = {0};
+    if ( *src == 0 )
+        return false;
 
-// RTF table row formatting params
-static RTF_TABLEROW_FORMAT rtfRowFormat = {0};
+    tok = src;
 
-// RTF table cell formatting params
-static RTF_TABLECELL_FORMAT rtfCellFormat = {0};
+    while ( ( *src != ';' ) && ( *src != 0 ) )
+        src++;
 
-// RTF library global params
-static FILE*        rtfFile = NULL;
-static string       rtfFontTable;
-static string       rtfColorTable;
-static IPicture*    rtfPicture = NULL;
+    toklen = src - tok;
 
-static void strcats( char* ob, const char* ib, size_t obsz )
+    return true;
+}
+
+// Gets color index key of RGB components
+static inline unsigned int get_colorkey( int red, int green, int blue )
 {
-    if ( ( ob == NULL ) || ( ib == NULL ) || ( obsz == 0 ) )
-        return;
+    return ( ( red & 0xff ) << 16 ) | ( ( green & 0xff ) << 8 ) | ( blue & 0xff );
+}
 
-    strcat_s( ob, obsz, ib );
+// Control word literal and its length
+struct RtfControlWord
+{
+    const char* text;
+    size_t      length;
+};
+
+#define RTF_WORD( s )           { s, sizeof(s) - 1 }
+#define RTF_WORDCOUNT( t )      ( sizeof(t) / sizeof(RtfControlWord) )
+
+// Border control words by RTF_PARAGRAPHBORDERTYPE_*
+static const RtfControlWord borderNames[] =
+{
+    RTF_WORD( "\\brdrs" ),                // Single-thickness border
+    RTF_WORD( "\\brdrth" ),               // Double-thickness border
+    RTF_WORD( "\\brdrsh" ),               // Shadowed border
+    RTF_WORD( "\\brdrdb" ),               // Double border
+    RTF_WORD( "\\brdrdot" ),              // Dotted border
+    RTF_WORD( "\\brdrdash" ),             // Dashed border
+    RTF_WORD( "\\brdrhair" ),             // Hairline border
+    RTF_WORD( "\\brdrinset" ),            // Inset border
+    RTF_WORD( "\\brdrdashsm" ),           // Dashed border (small)
+    RTF_WORD( "\\brdrdashd" ),            // Dot-dashed border
+    RTF_WORD( "\\brdrdashdd" ),           // Dot-dot-dashed border
+    RTF_WORD( "\\brdroutset" ),           // Outset border
+    RTF_WORD( "\\brdrtriple" ),           // Triple border
+    RTF_WORD( "\\brdrwavy" ),             // Wavy border
+    RTF_WORD( "\\brdrwavydb" ),           // Double wavy border
+    RTF_WORD( "\\brdrdashdotstr" ),       // Striped border
+    RTF_WORD( "\\brdremboss" ),           // Embossed border
+    RTF_WORD( "\\brdrengrave" )           // Engraved border
+};
+
+// Paragraph shading control words by RTF_PARAGRAPHSHADINGTYPE_*
+static const RtfControlWord paragraphShadingNames[] =
+{
+    RTF_WORD( "" ),                         // Fill shading
+    RTF_WORD( "\\bghoriz" ),              // Horizontal background pattern
+    RTF_WORD( "\\bgvert" ),               // Vertical background pattern
+    RTF_WORD( "\\bgfdiag" ),              // Forward diagonal background pattern
+    RTF_WORD( "\\bgbdiag" ),              // Backward diagonal background pattern
+    RTF_WORD( "\\bgcross" ),              // Cross background pattern
+    RTF_WORD( "\\bgdcross" ),             // Diagonal cross background pattern
+    RTF_WORD( "\\bgdkhoriz" ),            // Dark horizontal background pattern
+    RTF_WORD( "\\bgdkvert" ),             // Dark vertical background pattern
+    RTF_WORD( "\\bgdkfdiag" ),            // Dark forward diagonal background pattern
+    RTF_WORD( "\\bgdkbdiag" ),            // Dark backward diagonal background pattern
+    RTF_WORD( "\\bgdkcross" ),            // Dark cross background pattern
+    RTF_WORD( "\\bgdkdcross" )            // Dark diagonal cross background pattern
+};
+
+// Cell shading control words by RTF_CELLSHADINGTYPE_*
+static const RtfControlWord cellShadingNames[] =
+{
+    RTF_WORD( "" ),                         // Fill shading
+    RTF_WORD( "\\clbghoriz" ),            // Horizontal background pattern
+    RTF_WORD( "\\clbgvert" ),             // Vertical background pattern
+    RTF_WORD( "\\clbgfdiag" ),            // Forward diagonal background pattern
+    RTF_WORD( "\\clbgbdiag" ),            // Backward diagonal background pattern
+    RTF_WORD( "\\clbgcross" ),            // Cross background pattern
+    RTF_WORD( "\\clbgdcross" ),           // Diagonal cross background pattern
+    RTF_WORD( "\\clbgdkhoriz" ),          // Dark horizontal background pattern
+    RTF_WORD( "\\clbgdkvert" ),           // Dark vertical background pattern
+    RTF_WORD( "\\clbgdkfdiag" ),          // Dark forward diagonal background pattern
+    RTF_WORD( "\\clbgdkbdiag" ),          // Dark backward diagonal background pattern
+    RTF_WORD( "\\clbgdkcross" ),          // Dark cross background pattern
+    RTF_WORD( "\\clbgdkdcross" )          // Dark diagonal cross background pattern
+};
+
+// Gets control word of a table by type, empty word for unknown types
+static inline const RtfControlWord& get_controlword( const RtfControlWord* table,
+                                                     size_t count, int type )
+{
+    static const RtfControlWord none = RTF_WORD( "" );
+
+    if ( ( type < 0 ) || ( (size_t)type >= count ) )
+        return none;
+
+    return table[type];
+}
+
+// Puts control word of a table by type
+static inline void put_controlword( librtf::RtfBuffer& out, const RtfControlWord* table,
+                                    size_t count, int type )
+{
+    const RtfControlWord& word = get_controlword( table, count, type );
+
+    out.put( word.text, word.length );
+}
+
+// Default RTF document used by librtf:: functions
+static librtf::RtfDocument rtfDocument;
+
+librtf::RtfDocument::RtfDocument()
+ : rtfRowStart( NULL ),
+   rtfRowTemplated( false ),
+   rtfSink( NULL ),
+   rtfSinkOwned( false ),
+   rtfFragment( false ),
+   rtfUnbuffered( false ),
+   rtfDeltaFormat( false ),
+   rtfEscapeText( false ),
+   rtfUtf8Text( false ),
+   rtfBinaryImages( false ),
+   rtfImageCache( NULL ),
+   rtfLastValid( false ),
+   rtfParStyle( -1 ),
+   rtfCharStyle( -1 ),
+   rtfLastParStyle( -1 ),
+   rtfLastCharStyle( -1 ),
+   rtfFontCount( 0 ),
+   rtfColorCount( 0 ),
+   rtfPicture( NULL ),
+   rtfTextBuffer( NULL ),
+   rtfTextSize( 0 ),
+   rtfSpool( NULL ),
+   rtfDeferredSink( NULL ),
+   rtfTableSource( NULL )
+{
+    memset( &rtfDocFormat, 0, sizeof(RTF_DOCUMENT_FORMAT) );
+    memset( &rtfSecFormat, 0, sizeof(RTF_SECTION_FORMAT) );
+    memset( &rtfParFormat, 0, sizeof(RTF_PARAGRAPH_FORMAT) );
+    memset( &rtfRowFormat, 0, sizeof(RTF_TABLEROW_FORMAT) );
+    memset( &rtfCellFormat, 0, sizeof(RTF_TABLECELL_FORMAT) );
+    memset( &rtfLastParFormat, 0, sizeof(RTF_PARAGRAPH_FORMAT) );
+}
+
+librtf::RtfDocument::~RtfDocument()
+{
+    close();
+
+    delete[] rtfTextBuffer;
 }
 
 // Creates new RTF document
-RTF_ERROR_TYPE librtf::open( const char* filename, const char* fonts, const char* colors,
-                             RTF_DOCUMENT_FORMAT* fmt )
+RTF_ERROR_TYPE librtf::RtfDocument::open( const char* filename, const char* fonts, const char* colors,
+                                          RTF_DOCUMENT_FORMAT* fmt )
+{
+    return open_sink( NULL, filename, fonts, colors, fmt );
+}
+
+// Creates new RTF document written to sink
+RTF_ERROR_TYPE librtf::RtfDocument::open( RtfSink* sink, const char* fonts, const char* colors,
+                                          RTF_DOCUMENT_FORMAT* fmt )
+{
+    if ( sink == NULL )
+        return RTF_OPEN_ERROR;
+
+    return open_sink( sink, NULL, fonts, colors, fmt );
+}
+
+// Creates new RTF document, on a file sink if sink is NULL
+RTF_ERROR_TYPE librtf::RtfDocument::open_sink( RtfSink* sink, const char* filename,
+                                               const char* fonts, const char* colors,
+                                               RTF_DOCUMENT_FORMAT* fmt )
 {
     // Set error flag
     RTF_ERROR_TYPE error = RTF_SUCCESS;
 
-    // Initialize global params
-    librtf::init();
+    // Close previous RTF document
+    if ( rtfSink != NULL )
+        close();
+
+    rtfLastValid = false;
+    rtfTableSource = NULL;
+
+    // Initialize document params
+    init();
 
     // Set RTF document font table
     if ( fonts != NULL )
     {
         if ( strlen( fonts ) > 0 )
-            librtf::set_fonttable(fonts);
+            set_fonttable(fonts);
     }
 
     // Set RTF document color table
     if ( colors != NULL )
     {
         if ( strlen( colors ) > 0 )
-            librtf::set_colortable(colors);
+            set_colortable(colors);
     }
 
     // Set Document format
     if ( fmt != NULL )
     {
-        librtf::set_documentformat( fmt );
+        set_documentformat( fmt );
     }
 
     // Create RTF document
-    rtfFile = fopen( filename, "wb" );
+    if ( attach_sink( sink, filename ) == false )
+    {
+        error = RTF_OPEN_ERROR;
+        return error;
+    }
+
+    // Write RTF document header
+    if ( write_header() == false )
+    {
+        release_sink();
+        error = RTF_HEADER_ERROR;
+        return error;
+    }
+
+    // Write RTF document formatting properties
+    if ( write_documentformat() == false )
+    {
+        release_sink();
+        error = RTF_DOCUMENTFORMAT_ERROR;
+        return error;
+    }
+
+    // Create first RTF document section with default formatting
+    if ( write_sectionformat() == false )
+    {
+        release_sink();
+        error = RTF_SECTIONFORMAT_ERROR;
+        return error;
+    }
+
+    // Return error flag
+    return error;
+}
+
+// Creates new RTF document from prologue
+RTF_ERROR_TYPE librtf::RtfDocument::open( const char* filename, const RtfPrologue& prologue )
+{
+    return open_prologue( NULL, filename, prologue );
+}
+
+// Creates new RTF document from prologue written to sink
+RTF_ERROR_TYPE librtf::RtfDocument::open( RtfSink* sink, const RtfPrologue& prologue )
+{
+    if ( sink == NULL )
+        return RTF_OPEN_ERROR;
+
+    return open_prologue( sink, NULL, prologue );
+}
+
+// Creates new RTF document from prologue, on a file sink if sink is NULL
+RTF_ERROR_TYPE librtf::RtfDocument::open_prologue( RtfSink* sink, const char* filename,
+                                                   const RtfPrologue& prologue )
+{
+    if ( prologue.get_error() != RTF_SUCCESS )
+        return prologue.get_error();
+
+    const RtfDocument* source = &prologue.document;
+
+    // Close previous RTF document
+    if ( rtfSink != NULL )
+        close();
+
+    // Formats prologue was written with, tables are looked up in prologue
+    memcpy( &rtfDocFormat, &source->rtfDocFormat, sizeof(RTF_DOCUMENT_FORMAT) );
+    memcpy( &rtfSecFormat, &source->rtfSecFormat, sizeof(RTF_SECTION_FORMAT) );
+    memcpy( &rtfParFormat, &source->rtfParFormat, sizeof(RTF_PARAGRAPH_FORMAT) );
+    memcpy( &rtfRowFormat, &source->rtfRowFormat, sizeof(RTF_TABLEROW_FORMAT) );
+    memcpy( &rtfCellFormat, &source->rtfCellFormat, sizeof(RTF_TABLECELL_FORMAT) );
+
+    clear_fonttable();
+    clear_colortable();
+    rtfStyles.clear();
+    rtfParStyle = -1;
+    rtfCharStyle = -1;
+    rtfLastValid = false;
+    rtfTableSource = source;
+
+    if ( attach_sink( sink, filename ) == false )
+        return RTF_OPEN_ERROR;
+
+    // Header, document format and first section in one copy
+    if ( write_out( prologue.data(), prologue.size() ) == false )
+    {
+        release_sink();
+        return RTF_HEADER_ERROR;
+    }
 
-    if ( rtfFile != NULL )
+    return RTF_SUCCESS;
+}
+
+// Sets output sink, a new file sink if sink is NULL
+bool librtf::RtfDocument::attach_sink( RtfSink* sink, const char* filename )
+{
+    if ( sink == NULL )
     {
-        // Write RTF document header
-        if ( librtf::write_header() == false )
+        RtfFileSink* fsink = new RtfFileSink( filename );
+
+        if ( fsink->is_open() == false )
         {
-            fclose( rtfFile );
-            rtfFile = NULL;
-            error = RTF_HEADER_ERROR;
-            return error;
+            delete fsink;
+            return false;
         }
 
-        // Write RTF document formatting properties
-        if ( librtf::write_documentformat() == false )
+        rtfSink = fsink;
+        rtfSinkOwned = true;
+    }
+    else
+    {
+        rtfSink = sink;
+        rtfSinkOwned = false;
+    }
+
+    rtfOut.set_sink( rtfSink );
+
+    return true;
+}
+
+// Creates new RTF document with tables of used fonts and colors
+RTF_ERROR_TYPE librtf::RtfDocument::open_deferred( RtfSink* sink, RTF_DOCUMENT_FORMAT* fmt )
+{
+    if ( sink == NULL )
+        return RTF_OPEN_ERROR;
+
+    // Close previous RTF document
+    if ( rtfSink != NULL )
+        close();
+
+    rtfLastValid = false;
+    rtfTableSource = NULL;
+
+    // Initialize document params, tables start with default font and
+    // color only, \f0 and \cf0 of default formatting stay defaults
+    init();
+    clear_fonttable();
+    add_fontentry( "Times New Roman", 15, "\\froman" );
+    clear_colortable();
+    add_colorentry( 0, 0, 0 );
+
+    // Set Document format
+    if ( fmt != NULL )
+    {
+        set_documentformat( fmt );
+    }
+
+    // Body is kept in spool until header can be written at close()
+    rtfSpool = new RtfSpoolSink();
+    rtfDeferredSink = sink;
+
+    rtfSink = rtfSpool;
+    rtfSinkOwned = false;
+    rtfOut.set_sink( rtfSink );
+
+    // Write RTF document formatting properties
+    if ( write_documentformat() == false )
+    {
+        release_sink();
+        return RTF_DOCUMENTFORMAT_ERROR;
+    }
+
+    // Create first RTF document section with default formatting
+    if ( write_sectionformat() == false )
+    {
+        release_sink();
+        return RTF_SECTIONFORMAT_ERROR;
+    }
+
+    return RTF_SUCCESS;
+}
+
+// Writes header of deferred document and spooled body to its sink
+bool librtf::RtfDocument::write_deferred()
+{
+    bool result = rtfOut.flush();
+
+    rtfSink = rtfDeferredSink;
+    rtfOut.set_sink( rtfSink );
+
+    if ( write_header() == false )
+        result = false;
+
+    // Body follows header
+    if ( rtfOut.flush() == false )
+        result = false;
+
+    if ( rtfSpool->copy_to( rtfSink ) == false )
+        result = false;
+
+    return result;
+}
+
+// Opens document fragment written to sink
+RTF_ERROR_TYPE librtf::RtfDocument::open_fragment( RtfSink* sink, const RtfDocument* parent )
+{
+    if ( ( sink == NULL ) || ( parent == NULL ) || ( parent == this ) )
+        return RTF_OPEN_ERROR;
+
+    // Close previous RTF document
+    if ( rtfSink != NULL )
+        close();
+
+    memcpy( &rtfDocFormat, &parent->rtfDocFormat, sizeof(RTF_DOCUMENT_FORMAT) );
+    memcpy( &rtfSecFormat, &parent->rtfSecFormat, sizeof(RTF_SECTION_FORMAT) );
+    memcpy( &rtfParFormat, &parent->rtfParFormat, sizeof(RTF_PARAGRAPH_FORMAT) );
+    memcpy( &rtfRowFormat, &parent->rtfRowFormat, sizeof(RTF_TABLEROW_FORMAT) );
+    memcpy( &rtfCellFormat, &parent->rtfCellFormat, sizeof(RTF_TABLECELL_FORMAT) );
+    rtfParFormat.paragraphText = NULL;
+
+    rtfDeltaFormat   = parent->rtfDeltaFormat;
+    rtfEscapeText    = parent->rtfEscapeText;
+    rtfUtf8Text      = parent->rtfUtf8Text;
+    rtfBinaryImages  = parent->rtfBinaryImages;
+    rtfImageCache    = parent->rtfImageCache;
+    rtfStyles        = parent->rtfStyles;
+    rtfParStyle      = parent->rtfParStyle;
+    rtfCharStyle     = parent->rtfCharStyle;
+    rtfFontTable     = parent->rtfFontTable;
+    rtfColorTable    = parent->rtfColorTable;
+    rtfFontIndex     = parent->rtfFontIndex;
+    rtfColorIndex    = parent->rtfColorIndex;
+    rtfFontCount     = parent->rtfFontCount;
+    rtfColorCount    = parent->rtfColorCount;
+    rtfTableSource   = parent->rtfTableSource;
+    rtfLastValid     = false;
+
+    rtfSink = sink;
+    rtfSinkOwned = false;
+    rtfFragment = true;
+    rtfOut.set_sink( rtfSink );
+
+    return RTF_SUCCESS;
+}
+
+// Appends rendered document fragment
+RTF_ERROR_TYPE librtf::RtfDocument::write_fragment( const char* data, size_t size )
+{
+    if ( rtfSink == NULL )
+        return RTF_FAILURE;
+
+    // Formatting in effect after fragment is unknown
+    rtfLastValid = false;
+
+    if ( ( data == NULL ) || ( size == 0 ) )
+        return RTF_SUCCESS;
+
+    if ( write_out( data, size ) == false )
+        return RTF_ERROR;
+
+    return RTF_SUCCESS;
+}
+
+// Drops output sink, owned sink is closed and deleted, caller sink is
+// only flushed. Returns false on flush or close error.
+bool librtf::RtfDocument::release_sink()
+{
+    bool result = true;
+
+    if ( rtfSink != NULL )
+    {
+        result = rtfOut.flush();
+
+        if ( rtfSinkOwned == true )
         {
-            fclose( rtfFile );
-            rtfFile = NULL;
-            error = RTF_DOCUMENTFORMAT_ERROR;
-            return error;
+            if ( rtfSink->close() == false )
+                result = false;
         }
-
-        // Create first RTF document section with default formatting
-        if ( librtf::write_sectionformat() == false )
+        else
         {
-            fclose( rtfFile );
-            rtfFile = NULL;
-            error = RTF_SECTIONFORMAT_ERROR;
-            return error;
+            if ( rtfSink->flush() == false )
+                result = false;
         }
+
+        rtfOut.set_sink( NULL );
+
+        if ( rtfSinkOwned == true )
+            delete rtfSink;
+
+        rtfSink = NULL;
+        rtfSinkOwned = false;
     }
-    else
+
+    // Deferred document spool, body is written or dropped by now
+    if ( rtfSpool != NULL )
     {
-        error = RTF_OPEN_ERROR;
+        delete rtfSpool;
+        rtfSpool = NULL;
+        rtfDeferredSink = NULL;
     }
 
-    // Return error flag
-    return error;
+    return result;
+}
+
+// Writes data to output buffer
+bool librtf::RtfDocument::write_out( const char* data, size_t size )
+{
+    if ( rtfSink == NULL )
+        return false;
+
+    rtfOut.put( data, size );
+
+    return end_fragment();
+}
+
+// Ends an output fragment, flushes it when output is unbuffered
+bool librtf::RtfDocument::end_fragment()
+{
+    if ( rtfUnbuffered == true )
+        rtfOut.flush();
+
+    return rtfOut.good();
+}
+
+// Sets output buffer size, 0 writes every fragment straight to sink
+bool librtf::RtfDocument::set_buffersize( size_t size )
+{
+    rtfUnbuffered = ( size == 0 );
+
+    if ( rtfUnbuffered == true )
+        size = RTF_FRAGMENT_BUFFERSIZE;
+
+    return rtfOut.set_size( size );
+}
+
+// Flushes buffered output to sink
+bool librtf::RtfDocument::flush()
+{
+    return rtfOut.flush();
+}
+
+// Gets largest number of output bytes buffered at once
+size_t librtf::RtfDocument::get_highwater()
+{
+    return rtfOut.get_highwater();
+}
+
+// Sets delta formatting, paragraphs only write formatting that changed
+void librtf::RtfDocument::set_deltaformat( bool enable )
+{
+    rtfDeltaFormat = enable;
+    rtfLastValid = false;
+}
+
+// Gets delta formatting state
+bool librtf::RtfDocument::get_deltaformat()
+{
+    return rtfDeltaFormat;
+}
+
+// Sets text escaping of paragraph text
+void librtf::RtfDocument::set_textescaping( bool enable )
+{
+    rtfEscapeText = enable;
+}
+
+// Gets text escaping state
+bool librtf::RtfDocument::get_textescaping()
+{
+    return rtfEscapeText;
+}
+
+// Sets UTF-8 paragraph text
+void librtf::RtfDocument::set_utf8text( bool enable )
+{
+    rtfUtf8Text = enable;
+}
+
+// Gets UTF-8 paragraph text state
+bool librtf::RtfDocument::get_utf8text()
+{
+    return rtfUtf8Text;
+}
+
+// Sets binary picture data
+void librtf::RtfDocument::set_binaryimages( bool enable )
+{
+    rtfBinaryImages = enable;
+}
+
+// Gets binary picture data state
+bool librtf::RtfDocument::get_binaryimages()
+{
+    return rtfBinaryImages;
+}
+
+// Sets image cache
+void librtf::RtfDocument::set_imagecache( RtfImageCache* cache )
+{
+    rtfImageCache = cache;
+}
+
+// Gets image cache
+librtf::RtfImageCache* librtf::RtfDocument::get_imagecache()
+{
+    return rtfImageCache;
+}
+
+// Writes paragraph text, escaped if enabled
+void librtf::RtfDocument::put_text( const char* text )
+{
+    put_text( text, strlen( text ) );
+}
+
+// Writes paragraph text of given length, escaped if enabled
+void librtf::RtfDocument::put_text( const char* text, size_t length )
+{
+    if ( rtfUtf8Text == true )
+        put_escapedutf8( rtfOut, text, length );
+    else if ( rtfEscapeText == true )
+        put_escaped( rtfOut, text, length );
+    else
+        rtfOut.put( text, length );
 }
 
 // Closes created RTF document
-RTF_ERROR_TYPE librtf::close()
+RTF_ERROR_TYPE librtf::RtfDocument::close()
 {
     // Set error flag
     RTF_ERROR_TYPE error = RTF_SUCCESS;
 
-    if( rtfFile != NULL )
+    if( rtfSink != NULL )
     {
+#ifdef _WIN32
         // Free IPicture object
         if ( rtfPicture != NULL )
         {
-            rtfPicture->Release();
+            ((IPicture*)rtfPicture)->Release();
             rtfPicture = NULL;
         }
+#endif
+
+        // Write RTF document end part, fragment has none
+        if ( rtfFragment == false )
+        {
+            char rtfText[] = "\n\\par}";
+            write_out( rtfText, sizeof(rtfText) - 1 );
+        }
+
+        rtfFragment = false;
 
-        // Write RTF document end part
-        char rtfText[] = "\n\\par}";
-        fwrite( rtfText, 1, strlen(rtfText), rtfFile );
+        // Deferred document, header goes before spooled body
+        if ( ( rtfSpool != NULL ) && ( write_deferred() == false ) )
+            error = RTF_HEADER_ERROR;
 
         // Close RTF document
-        if ( fclose(rtfFile) != 0 )
+        if ( release_sink() == false )
             error = RTF_CLOSE_ERROR;
-
-        rtfFile = NULL;
     }
 
-    if ( rtfParFormat.paragraphText  != NULL )
-    {
-        delete[] rtfParFormat.paragraphText;
-        rtfParFormat.paragraphText = NULL;
-    }
+    // Paragraph text is kept in text buffer, reused by next document
+    rtfParFormat.paragraphText = NULL;
 
     // Return error flag
     return error;
 }
 
 // Writes RTF document header
-bool librtf::write_header()
+bool librtf::RtfDocument::write_header()
 {
     // Set error flag
     bool result = true;
@@ -175,19 +729,18 @@ bool librtf::write_header()
         wrbuff += "}";
     }
 
-    wrbuff += "{\\*\\generator librtf v1.2;}\n";
+    // Writes standard RTF document header part
+    if ( write_out( wrbuff.c_str(), wrbuff.size() ) == false )
+        result = false;
+
+    // Writes RTF stylesheet
+    put_stylesheet();
+
+    wrbuff = "{\\*\\generator librtf v1.2;}\n";
     wrbuff += "{\\info{\\author none}{\\company none}}";
 
-    // Writes standard RTF document header part
-    if ( rtfFile != NULL )
-    {
-        if ( fwrite( wrbuff.c_str(), 1, wrbuff.size(), rtfFile ) < wrbuff.size() )
-            result = false;
-    }
-    else
-    {
+    if ( write_out( wrbuff.c_str(), wrbuff.size() ) == false )
         result = false;
-    }
 
     wrbuff.clear();
 
@@ -195,54 +748,52 @@ bool librtf::write_header()
     return result;
 }
 
-// Sets global RTF library params
-void librtf::init()
+// Sets RTF document params
+void librtf::RtfDocument::init()
 {
     // Set RTF document default font table
-    if ( rtfFontTable.size() > 0 )
-        rtfFontTable.clear();
-
-    rtfFontTable += "{\\f0\\froman\\fcharset0\\cpg1252 Times New Roman}";
-    rtfFontTable += "{\\f1\\fswiss\\fcharset0\\cpg1252 Arial}";
-    rtfFontTable += "{\\f2\\fmodern\\fcharset0\\cpg1252 Courier New}";
-    rtfFontTable += "{\\f3\\fscript\\fcharset0\\cpg1252 Cursive}";
-    rtfFontTable += "{\\f4\\fdecor\\fcharset0\\cpg1252 Old English}";
-    rtfFontTable += "{\\f5\\ftech\\fcharset0\\cpg1252 Symbol}";
-    rtfFontTable += "{\\f6\\fbidi\\fcharset0\\cpg1252 Miriam}";
+    clear_fonttable();
+    add_fontentry( "Times New Roman", 15, "\\froman" );
+    add_fontentry( "Arial", 5, "\\fswiss" );
+    add_fontentry( "Courier New", 11, "\\fmodern" );
+    add_fontentry( "Cursive", 7, "\\fscript" );
+    add_fontentry( "Old English", 11, "\\fdecor" );
+    add_fontentry( "Symbol", 6, "\\ftech" );
+    add_fontentry( "Miriam", 6, "\\fbidi" );
 
     // Set RTF document default color table
-    if ( rtfColorTable.size() > 0 )
-        rtfColorTable.clear();
-
-    rtfColorTable += "\\red0\\green0\\blue0;";
-    rtfColorTable += "\\red255\\green0\\blue0;";
-    rtfColorTable += "\\red0\\green255\\blue0;";
-    rtfColorTable += "\\red0\\green0\\blue255;";
-    rtfColorTable += "\\red255\\green255\\blue0;";
-    rtfColorTable += "\\red255\\green0\\blue255;";
-    rtfColorTable += "\\red0\\green255\\blue255;";
-    rtfColorTable += "\\red255\\green255\\blue255;";
-    rtfColorTable += "\\red128\\green0\\blue0;";
-    rtfColorTable += "\\red0\\green128\\blue0;";
-    rtfColorTable += "\\red0\\green0\\blue128;";
-    rtfColorTable += "\\red128\\green128\\blue0;";
-    rtfColorTable += "\\red128\\green0\\blue128;";
-    rtfColorTable += "\\red0\\green128\\blue128;";
-    rtfColorTable += "\\red128\\green128\\blue128;";
+    clear_colortable();
+    add_colorentry( 0, 0, 0 );
+    add_colorentry( 255, 0, 0 );
+    add_colorentry( 0, 255, 0 );
+    add_colorentry( 0, 0, 255 );
+    add_colorentry( 255, 255, 0 );
+    add_colorentry( 255, 0, 255 );
+    add_colorentry( 0, 255, 255 );
+    add_colorentry( 255, 255, 255 );
+    add_colorentry( 128, 0, 0 );
+    add_colorentry( 0, 128, 0 );
+    add_colorentry( 0, 0, 128 );
+    add_colorentry( 128, 128, 0 );
+    add_colorentry( 128, 0, 128 );
+    add_colorentry( 0, 128, 128 );
+    add_colorentry( 128, 128, 128 );
 
     // Set default formatting
-    librtf::set_defaultformat();
+    set_defaultformat();
+    rtfRowCells.clear();
+    rtfRowTemplated = false;
 }
 
 // Sets default RTF document formatting
-void librtf::set_defaultformat()
+void librtf::RtfDocument::set_defaultformat()
 {
     // Set default RTF document formatting properties
     RTF_DOCUMENT_FORMAT df = { RTF_DOCUMENTVIEWKIND_PAGE,
                                100, 12240, 15840, 1800, 1800, 1440, 1440,
                                false, 0, false };
 
-    librtf::set_documentformat( &df );
+    set_documentformat( &df );
 
     // Set default RTF section formatting properties
     RTF_SECTION_FORMAT sf = { RTF_SECTIONBREAK_CONTINUOUS,
@@ -254,7 +805,7 @@ void librtf::set_defaultformat()
                               1, 720,
                               false };
 
-    librtf::set_sectionformat(&sf);
+    set_sectionformat(&sf);
 
     // Set default RTF paragraph formatting properties
     RTF_PARAGRAPH_FORMAT pf = { RTF_PARAGRAPHBREAK_NONE,
@@ -305,13 +856,13 @@ void librtf::set_defaultformat()
     pf.TABS.tabLead = RTF_PARAGRAPHTABLEAD_NONE;
     pf.TABS.tabPosition = 0;
 
-    librtf::set_paragraphformat( &pf );
+    set_paragraphformat( &pf );
 
     // Set default RTF table row formatting properties
     RTF_TABLEROW_FORMAT rf = { RTF_ROWTEXTALIGN_LEFT,
                                0, 0, 0, 0, 0, 0 };
 
-    librtf::set_tablerowformat( &rf );
+    set_tablerowformat( &rf );
 
     // Set default RTF table cell formatting properties
     RTF_TABLECELL_FORMAT cf = { RTF_CELLTEXTALIGN_CENTER,
@@ -352,108 +903,176 @@ void librtf::set_defaultformat()
     cf.borderTop.BORDERS.borderType = RTF_PARAGRAPHBORDERTYPE_STHICK;
     cf.borderTop.BORDERS.borderWidth = 5;
 
-    librtf::set_tablecellformat( &cf );
+    set_tablecellformat( &cf );
 }
 
 // Sets new RTF document font table
-void librtf::set_fonttable( const char* fonts )
+void librtf::RtfDocument::set_fonttable( const char* fonts )
 {
     if ( fonts == NULL )
         return;
 
-    char* tmpbsrc = strdup( fonts );
-
-    if ( tmpbsrc == NULL )
-        return;
-
-    char* tmpb = tmpbsrc;
-
     // Clear old font table
-    if ( rtfFontTable.size() > 0 )
-        rtfFontTable.clear();
-
-    // Set separator list
-    char separator[] = ";";
+    clear_fonttable();
 
     // Create new RTF document font table
-    int   font_number = 0;
-    char  font_table_entry[1024] = {0};
-    char* token = strtok( tmpb, separator );
-
-    while ( token != NULL )
-    {
-        // Format font table entry
-        snprintf( font_table_entry, 1024,
-                  "{\\f%d\\fnil\\fcharset0\\cpg1252 %s}",
-                  font_number, token );
-
-        rtfFontTable += font_table_entry;
-
-        // Get next font
-        token = strtok( NULL, separator );
-        font_number++;
-    }
+    const char* token = NULL;
+    size_t      toklen = 0;
 
-    delete[] tmpbsrc;
+    while ( next_token( fonts, token, toklen ) == true )
+        add_fontentry( token, toklen, "\\fnil" );
 }
 
 // Sets new RTF document color table
-void librtf::set_colortable( const char* colors )
+void librtf::RtfDocument::set_colortable( const char* colors )
 {
     if ( colors == NULL )
         return;
 
     // Clear old color table
-    if ( rtfColorTable.size() > 0 )
-        rtfColorTable.clear();
-
-    char* tmpbsrc = strdup( colors );
+    clear_colortable();
 
-    if ( tmpbsrc == NULL )
-        return;
-
-    char* tmpb = tmpbsrc;
+    // Create new RTF document color table, components are written as given
+    const char* token[3] = { NULL, NULL, NULL };
+    size_t      toklen[3] = { 0, 0, 0 };
 
-    // Set separator list
-    char separator[] = ";";
+    while ( next_token( colors, token[0], toklen[0] ) == true )
+    {
+        int count = 1;
 
-    // Create new RTF document color table
-    int   color_number = 0;
-    char  color_table_entry[40] = {0};
-    char* token = strtok( tmpb, separator );
+        while ( ( count < 3 ) && ( next_token( colors, token[count], toklen[count] ) == true ) )
+            count++;
 
-    while ( token != NULL )
-    {
-        // Red
-        snprintf( color_table_entry, 40, "\\red%s", token );
-        rtfColorTable += color_table_entry;
+        rtfColorTable += "\\red";
+        rtfColorTable.append( token[0], toklen[0] );
 
-        // Green
-        token = strtok( NULL, separator );
-        if ( token != NULL )
+        if ( count > 1 )
         {
-            snprintf( color_table_entry, 40, "\\green%s", token );
-            rtfColorTable += color_table_entry;
+            rtfColorTable += "\\green";
+            rtfColorTable.append( token[1], toklen[1] );
         }
 
-        // Blue
-        token = strtok( NULL, separator );
-        if ( token != NULL )
+        if ( count > 2 )
         {
-            snprintf( color_table_entry, 40, "\\blue%s;", token );
-            rtfColorTable += color_table_entry;
+            rtfColorTable += "\\blue";
+            rtfColorTable.append( token[2], toklen[2] );
+            rtfColorTable += ";";
+
+            unsigned int key = get_colorkey( atoi( token[0] ), atoi( token[1] ), atoi( token[2] ) );
+
+            rtfColorIndex.insert( std::make_pair( key, rtfColorCount ) );
         }
 
-        // Get next color
-        token = strtok( NULL, separator );
-        color_number++;
+        rtfColorCount++;
     }
+}
+
+// Clears font table and its index
+void librtf::RtfDocument::clear_fonttable()
+{
+    rtfFontTable.clear();
+    rtfFontIndex.clear();
+    rtfFontCount = 0;
+}
+
+// Adds font table entry, returns its font number
+int librtf::RtfDocument::add_fontentry( const char* name, size_t length, const char* family )
+{
+    int number = rtfFontCount++;
+
+    rtfFontTable += "{\\f";
+    rtfFontTable += to_string( number );
+    rtfFontTable += family;
+    rtfFontTable += "\\fcharset0\\cpg1252 ";
+    rtfFontTable.append( name, length );
+    rtfFontTable += "}";
+
+    // First entry of a name keeps it
+    rtfFontIndex.insert( std::make_pair( string( name, length ), number ) );
+
+    return number;
+}
+
+// Clears color table and its index
+void librtf::RtfDocument::clear_colortable()
+{
+    rtfColorTable.clear();
+    rtfColorIndex.clear();
+    rtfColorCount = 0;
+}
+
+// Adds color table entry, returns its color number
+int librtf::RtfDocument::add_colorentry( int red, int green, int blue )
+{
+    int number = rtfColorCount++;
+
+    rtfColorTable += "\\red";
+    rtfColorTable += to_string( red );
+    rtfColorTable += "\\green";
+    rtfColorTable += to_string( green );
+    rtfColorTable += "\\blue";
+    rtfColorTable += to_string( blue );
+    rtfColorTable += ";";
+
+    rtfColorIndex.insert( std::make_pair( get_colorkey( red, green, blue ), number ) );
+
+    return number;
+}
+
+// Checks font or color table can still change
+bool librtf::RtfDocument::can_addentry()
+{
+    // Header is written at open, except by deferred documents
+    return ( rtfSpool != NULL );
+}
+
+// Gets font number, adds font if new
+int librtf::RtfDocument::font( const char* name )
+{
+    if ( name == NULL )
+        return -1;
+
+    size_t length = strlen( name );
+
+    // Names are table text, delimiters would break it
+    if ( ( length == 0 ) || ( strpbrk( name, ";{}\\" ) != NULL ) )
+        return -1;
+
+    const RtfFontIndex&          index = ( rtfTableSource != NULL ) ? rtfTableSource->rtfFontIndex
+                                                                    : rtfFontIndex;
+    RtfFontIndex::const_iterator it = index.find( string( name, length ) );
+
+    if ( it != index.end() )
+        return it->second;
+
+    if ( can_addentry() == false )
+        return -1;
+
+    return add_fontentry( name, length, "\\fnil" );
+}
+
+// Gets color number, adds color if new
+int librtf::RtfDocument::color( int red, int green, int blue )
+{
+    if ( ( red < 0 ) || ( red > 255 ) || ( green < 0 ) || ( green > 255 ) ||
+         ( blue < 0 ) || ( blue > 255 ) )
+        return -1;
+
+    const RtfColorIndex&          index = ( rtfTableSource != NULL ) ? rtfTableSource->rtfColorIndex
+                                                                     : rtfColorIndex;
+    RtfColorIndex::const_iterator it = index.find( get_colorkey( red, green, blue ) );
 
-    delete[] tmpbsrc;
+    if ( it != index.end() )
+        return it->second;
+
+    if ( can_addentry() == false )
+        return -1;
+
+    return add_colorentry( red, green, blue );
 }
 
 // Sets RTF document formatting properties
-void librtf::set_documentformat( RTF_DOCUMENT_FORMAT* df )
+void librtf::RtfDocument::set_documentformat( RTF_DOCUMENT_FORMAT* df )
 {
     if ( df != NULL )
     {
@@ -463,7 +1082,7 @@ void librtf::set_documentformat( RTF_DOCUMENT_FORMAT* df )
 }
 
 // Writes RTF document formatting properties
-bool librtf::write_documentformat()
+bool librtf::RtfDocument::write_documentformat()
 {
     // Set error flag
     bool result = true;
@@ -490,22 +1109,15 @@ bool librtf::write_documentformat()
         strcats( rtfText, "\\annotprot", 1024 );
 
     // Writes RTF document formatting properties
-    if ( rtfFile != NULL )
-    {
-        if ( fwrite( rtfText, 1, strlen(rtfText), rtfFile ) < strlen(rtfText) )
-            result = false;
-    }
-    else
-    {
+    if ( write_out( rtfText, strlen(rtfText) ) == false )
         result = false;
-    }
 
     // Return error flag
     return result;
 }
 
 // Sets RTF section formatting properties
-void librtf::set_sectionformat(RTF_SECTION_FORMAT* sf)
+void librtf::RtfDocument::set_sectionformat(RTF_SECTION_FORMAT* sf)
 {
     if ( sf != NULL )
     {
@@ -515,7 +1127,7 @@ void librtf::set_sectionformat(RTF_SECTION_FORMAT* sf)
 }
 
 // Writes RTF section formatting properties
-bool librtf::write_sectionformat()
+bool librtf::RtfDocument::write_sectionformat()
 {
     // Set error flag
     bool result = true;
@@ -585,25 +1197,21 @@ bool librtf::write_sectionformat()
             strcats( cols, "\\linebetcol", 100 );
     }
 
-    snprintf( rtfText, 1024,
-              "\n%s%s%s\\pgwsxn%d\\pghsxn%d\\marglsxn%d\\margrsxn%d\\margtsxn%d\\margbsxn%d\\guttersxn%d\\headery%d\\footery%d",
-              text, sbr, cols,
-              rtfSecFormat.pageWidth, rtfSecFormat.pageHeight,
-              rtfSecFormat.pageMarginLeft, rtfSecFormat.pageMarginRight,
-              rtfSecFormat.pageMarginTop, rtfSecFormat.pageMarginBottom,
-              rtfSecFormat.pageGutterWidth, rtfSecFormat.pageHeaderOffset,
-              rtfSecFormat.pageFooterOffset );
+    int len = snprintf( rtfText, 1024,
+                        "\n%s%s%s\\pgwsxn%d\\pghsxn%d\\marglsxn%d\\margrsxn%d\\margtsxn%d\\margbsxn%d\\guttersxn%d\\headery%d\\footery%d",
+                        text, sbr, cols,
+                        rtfSecFormat.pageWidth, rtfSecFormat.pageHeight,
+                        rtfSecFormat.pageMarginLeft, rtfSecFormat.pageMarginRight,
+                        rtfSecFormat.pageMarginTop, rtfSecFormat.pageMarginBottom,
+                        rtfSecFormat.pageGutterWidth, rtfSecFormat.pageHeaderOffset,
+                        rtfSecFormat.pageFooterOffset );
+
+    if ( ( len < 0 ) || ( len >= 1024 ) )
+        len = strlen( rtfText );
 
     // Writes RTF section formatting properties
-    if ( rtfFile != NULL )
-    {
-        if ( fwrite( rtfText, 1, strlen(rtfText), rtfFile ) < strlen(rtfText) )
-            result = false;
-    }
-    else
-    {
+    if ( write_out( rtfText, len ) == false )
         result = false;
-    }
 
     // Return error flag
     return result;
@@ -611,7 +1219,7 @@ bool librtf::write_sectionformat()
 
 
 // Starts new RTF section
-RTF_ERROR_TYPE librtf::start_section()
+RTF_ERROR_TYPE librtf::RtfDocument::start_section()
 {
     // Set error flag
     RTF_ERROR_TYPE error = RTF_SUCCESS;
@@ -620,7 +1228,7 @@ RTF_ERROR_TYPE librtf::start_section()
     rtfSecFormat.newSection = true;
 
     // Starts new RTF section
-    if( librtf::write_sectionformat() == false )
+    if( write_sectionformat() == false )
         error = RTF_SECTIONFORMAT_ERROR;
 
     // Return error flag
@@ -628,7 +1236,7 @@ RTF_ERROR_TYPE librtf::start_section()
 }
 
 // Sets RTF paragraph formatting properties
-void librtf::set_paragraphformat(RTF_PARAGRAPH_FORMAT* pf)
+void librtf::RtfDocument::set_paragraphformat(RTF_PARAGRAPH_FORMAT* pf)
 {
     if ( pf != NULL )
     {
@@ -637,30 +1245,181 @@ void librtf::set_paragraphformat(RTF_PARAGRAPH_FORMAT* pf)
     }
 }
 
-// Writes RTF paragraph formatting properties
-bool librtf::write_paragraphformat()
+// Puts RTF underline control word, returns false for unknown kind
+static bool put_underline( librtf::RtfBuffer& out, int kind )
 {
-    // Set error flag
-    bool result = true;
+    switch ( kind )
+    {
+        // None underline
+        case 0:
+            out.put( "\\ulnone" );
+            return true;
 
-    // RTF document text
-    char rtfText[4096] = {0};
+        // Continuous underline
+        case 1:
+            out.put( "\\ul" );
+            return true;
 
-    // Format new paragraph
-    string text;
+        // Dotted underline
+        case 2:
+            out.put( "\\uld" );
+            return true;
 
-    if ( rtfParFormat.newParagraph )
-        text += "\\par";
+        // Dashed underline
+        case 3:
+            out.put( "\\uldash" );
+            return true;
 
-    if ( rtfParFormat.defaultParagraph )
-        text += "\\pard";
+        // Dash-dotted underline
+        case 4:
+            out.put( "\\uldashd" );
+            return true;
 
-    if ( rtfParFormat.tableText == false )
-        text += "\\plain";
+        // Dash-dot-dotted underline
+        case 5:
+            out.put( "\\uldashdd" );
+            return true;
+
+        // Double underline
+        case 6:
+            out.put( "\\uldb" );
+            return true;
+
+        // Heavy wave underline
+        case 7:
+            out.put( "\\ulhwave" );
+            return true;
+
+        // Long dashed underline
+        case 8:
+            out.put( "\\ulldash" );
+            return true;
+
+        // Thick underline
+        case 9:
+            out.put( "\\ulth" );
+            return true;
+
+        // Thick dotted underline
+        case 10:
+            out.put( "\\ulthd" );
+            return true;
+
+        // Thick dashed underline
+        case 11:
+            out.put( "\\ulthdash" );
+            return true;
+
+        // Thick dash-dotted underline
+        case 12:
+            out.put( "\\ulthdashd" );
+            return true;
+
+        // Thick dash-dot-dotted underline
+        case 13:
+            out.put( "\\ulthdashdd" );
+            return true;
+
+        // Thick long dashed underline
+        case 14:
+            out.put( "\\ulthldash" );
+            return true;
+
+        // Double wave underline
+        case 15:
+            out.put( "\\ululdbwave" );
+            return true;
+
+        // Word underline
+        case 16:
+            out.put( "\\ulw" );
+            return true;
+
+        // Wave underline
+        case 17:
+            out.put( "\\ulwave" );
+            return true;
+    }
+
+    return false;
+}
+
+// Puts RTF character formatting properties
+static void put_characterformat( librtf::RtfBuffer& out, const RTF_CHARACTER_FORMAT& cf )
+{
+    out.put( "\\animtext" );
+    out.put_int( cf.animatedCharacter );
+    out.put( "\\expndtw" );
+    out.put_int( cf.expandCharacter );
+    out.put( "\\kerning" );
+    out.put_int( cf.kerningCharacter );
+    out.put( "\\charscalex" );
+    out.put_int( cf.scaleCharacter );
+    out.put( "\\f" );
+    out.put_int( cf.fontNumber );
+    out.put( "\\fs" );
+    out.put_int( cf.fontSize );
+    out.put( "\\cf" );
+    out.put_int( cf.foregroundColor );
+
+    if ( cf.boldCharacter )
+        out.put( "\\b" );
+    else
+        out.put( "\\b0" );
+
+    if ( cf.capitalCharacter )
+        out.put( "\\caps" );
+    else
+        out.put( "\\caps0" );
+
+    if ( cf.doublestrikeCharacter )
+        out.put( "\\striked1" );
+    else
+        out.put( "\\striked0" );
+
+    if ( cf.embossCharacter )
+        out.put( "\\embo" );
+    if ( cf.engraveCharacter )
+        out.put( "\\impr" );
+
+    if ( cf.italicCharacter )
+        out.put( "\\i" );
+    else
+        out.put( "\\i0" );
+
+    if ( cf.outlineCharacter )
+        out.put( "\\outl" );
+    else
+        out.put( "\\outl0" );
+
+    if ( cf.shadowCharacter )
+        out.put( "\\shad" );
+    else
+        out.put( "\\shad0" );
+
+    if ( cf.smallcapitalCharacter )
+        out.put( "\\scaps" );
+    else
+        out.put( "\\scaps0" );
+
+    if ( cf.strikeCharacter )
+        out.put( "\\strike" );
     else
-        text += "\\intbl";
+        out.put( "\\strike0" );
+
+    if ( cf.subscriptCharacter )
+        out.put( "\\sub" );
+
+    if ( cf.superscriptCharacter )
+        out.put( "\\super" );
+
+    put_underline( out, cf.underlineCharacter );
+}
 
-    switch ( rtfParFormat.paragraphBreak )
+// Puts RTF paragraph break, returns true if anything was put
+static bool put_paragraphbreak( librtf::RtfBuffer& out, const RTF_PARAGRAPH_FORMAT& pf )
+{
+    switch ( pf.paragraphBreak )
     {
         // No break
         case RTF_PARAGRAPHBREAK_NONE:
@@ -668,49 +1427,55 @@ bool librtf::write_paragraphformat()
 
         // Page break;
         case RTF_PARAGRAPHBREAK_PAGE:
-            text += "\\page";
-            break;
+            out.put( "\\page" );
+            return true;
 
         // Column break;
         case RTF_PARAGRAPHBREAK_COLUMN:
-            text += "\\column";
-            break;
+            out.put( "\\column" );
+            return true;
 
         // Line break;
         case RTF_PARAGRAPHBREAK_LINE:
-            text += "\\line";
-            break;
+            out.put( "\\line" );
+            return true;
     }
 
+    return false;
+}
+
+// Puts RTF paragraph properties, without character formatting
+static void put_paragraphproperties( librtf::RtfBuffer& out, const RTF_PARAGRAPH_FORMAT& pf )
+{
     // Format aligment
-    switch ( rtfParFormat.paragraphAligment )
+    switch ( pf.paragraphAligment )
     {
         // Left aligned paragraph
         case RTF_PARAGRAPHALIGN_LEFT:
-            text += "\\ql";
+            out.put( "\\ql" );
             break;
 
         // Center aligned paragraph
         case RTF_PARAGRAPHALIGN_CENTER:
-            text += "\\qc";
+            out.put( "\\qc" );
             break;
 
         // Right aligned paragraph
         case RTF_PARAGRAPHALIGN_RIGHT:
-            text += "\\qr";
+            out.put( "\\qr" );
             break;
 
         // Justified aligned paragraph
         case RTF_PARAGRAPHALIGN_JUSTIFY:
-            text += "\\qj";
+            out.put( "\\qj" );
             break;
     }
 
     // Format tabs
-    if ( rtfParFormat.paragraphTabs == true )
+    if ( pf.paragraphTabs == true )
     {
         // Set tab kind
-        switch ( rtfParFormat.TABS.tabKind )
+        switch ( pf.TABS.tabKind )
         {
             // No tab
             case RTF_PARAGRAPHTABKIND_NONE:
@@ -718,22 +1483,22 @@ bool librtf::write_paragraphformat()
 
             // Centered tab
             case RTF_PARAGRAPHTABKIND_CENTER:
-                text += "\\tqc";
+                out.put( "\\tqc" );
                 break;
 
             // Flush-right tab
             case RTF_PARAGRAPHTABKIND_RIGHT:
-                text += "\\tqr";
+                out.put( "\\tqr" );
                 break;
 
             // Decimal tab
             case RTF_PARAGRAPHTABKIND_DECIMAL:
-                text += "\\tqdec";
+                out.put( "\\tqdec" );
                 break;
         }
 
         // Set tab leader
-        switch ( rtfParFormat.TABS.tabLead )
+        switch ( pf.TABS.tabLead )
         {
             // No lead
             case RTF_PARAGRAPHTABLEAD_NONE:
@@ -741,60 +1506,57 @@ bool librtf::write_paragraphformat()
 
             // Leader dots
             case RTF_PARAGRAPHTABLEAD_DOT:
-                text += "\\tldot";
+                out.put( "\\tldot" );
                 break;
 
             // Leader middle dots
             case RTF_PARAGRAPHTABLEAD_MDOT:
-                text += "\\tlmdot";
+                out.put( "\\tlmdot" );
                 break;
 
             // Leader hyphens
             case RTF_PARAGRAPHTABLEAD_HYPH:
-                text += "\\tlhyph";
+                out.put( "\\tlhyph" );
                 break;
 
             // Leader underline
             case RTF_PARAGRAPHTABLEAD_UNDERLINE:
-                text += "\\tlul";
+                out.put( "\\tlul" );
                 break;
 
             // Leader thick line
             case RTF_PARAGRAPHTABLEAD_THICKLINE:
-                text += "\\tlth";
+                out.put( "\\tlth" );
                 break;
 
             // Leader equal sign
             case RTF_PARAGRAPHTABLEAD_EQUAL:
-                text += "\\tleq";
+                out.put( "\\tleq" );
                 break;
         }
 
         // Set tab position
-        char tb[20] = {0};
-        snprintf( tb, 20, "\\tx%d", rtfParFormat.TABS.tabPosition );
-        text += tb;
+        out.put( "\\tx" );
+        out.put_int( pf.TABS.tabPosition );
     }
 
     // Format bullets and numbering
-    if ( rtfParFormat.paragraphNums == true )
+    if ( pf.paragraphNums == true )
     {
-        char nums[80] = {0};
-        snprintf( nums, 80,
-                  "{\\*\\pn\\pnlvl%d\\pnsp%d\\pntxtb %c}",
-                  rtfParFormat.NUMS.numsLevel,
-                  rtfParFormat.NUMS.numsSpace,
-                  rtfParFormat.NUMS.numsChar );
-        text += nums;
+        out.put( "{\\*\\pn\\pnlvl" );
+        out.put_int( pf.NUMS.numsLevel );
+        out.put( "\\pnsp" );
+        out.put_int( pf.NUMS.numsSpace );
+        out.put( "\\pntxtb " );
+        out.put_char( pf.NUMS.numsChar );
+        out.put_char( '}' );
     }
 
     // Format paragraph borders
-    if ( rtfParFormat.paragraphBorders == true )
+    if ( pf.paragraphBorders == true )
     {
-        string border;
-
         // Format paragraph border kind
-        switch (rtfParFormat.BORDERS.borderKind)
+        switch ( pf.BORDERS.borderKind )
         {
             // No border
             case RTF_PARAGRAPHBORDERKIND_NONE:
@@ -802,1056 +1564,1926 @@ bool librtf::write_paragraphformat()
 
             // Border top
             case RTF_PARAGRAPHBORDERKIND_TOP:
-                border += "\\brdrt";
+                out.put( "\\brdrt" );
                 break;
 
             // Border bottom
             case RTF_PARAGRAPHBORDERKIND_BOTTOM:
-                border += "\\brdrb";
+                out.put( "\\brdrb" );
                 break;
 
             // Border left
             case RTF_PARAGRAPHBORDERKIND_LEFT:
-                border += "\\brdrl";
+                out.put( "\\brdrl" );
                 break;
 
             // Border right
             case RTF_PARAGRAPHBORDERKIND_RIGHT:
-                border += "\\brdrr";
+                out.put( "\\brdrr" );
                 break;
 
             // Border box
             case RTF_PARAGRAPHBORDERKIND_BOX:
-                border += "\\box";
+                out.put( "\\box" );
                 break;
         }
 
         // Format paragraph border type
-        const char *br = librtf::get_bordername( rtfParFormat.BORDERS.borderType );
-        if ( br != NULL )
-        {
-            border += br;
-        }
+        put_controlword( out, borderNames, RTF_WORDCOUNT( borderNames ),
+                         pf.BORDERS.borderType );
 
         // Set paragraph border width
-        char brd[100] = {0};
-        snprintf( brd, 100, "\\brdrw%d\\brsp%d",
-                  rtfParFormat.BORDERS.borderWidth,
-                  rtfParFormat.BORDERS.borderSpace );
-        border += brd;
-        text += border;
+        out.put( "\\brdrw" );
+        out.put_int( pf.BORDERS.borderWidth );
+        out.put( "\\brsp" );
+        out.put_int( pf.BORDERS.borderSpace );
 
         // Set paragraph border color
-        char brdcol[100] = {0};
-        snprintf( brdcol, 100, "\\brdrcf%d",
-                  rtfParFormat.BORDERS.borderColor );
-        text += brdcol;
+        out.put( "\\brdrcf" );
+        out.put_int( pf.BORDERS.borderColor );
     }
 
     // Format paragraph shading
-    if ( rtfParFormat.paragraphShading == true )
+    if ( pf.paragraphShading == true )
     {
-        char shading[40] = {0};
-        snprintf( shading, 40, "\\shading%d", rtfParFormat.SHADING.shadingIntensity );
-
         // Format paragraph shading
-        const char* sh = librtf::get_shadingname( rtfParFormat.SHADING.shadingType, false );
-        if ( sh != NULL )
-            text += sh;
+        put_controlword( out, paragraphShadingNames, RTF_WORDCOUNT( paragraphShadingNames ),
+                         pf.SHADING.shadingType );
 
         // Set paragraph shading color
-        char shcol[100] = {0};
-        snprintf( shcol, 100,
-                  "\\cfpat%d\\cbpat%d",
-                  rtfParFormat.SHADING.shadingFillColor,
-                  rtfParFormat.SHADING.shadingBkColor );
-        text += shcol;
+        out.put( "\\cfpat" );
+        out.put_int( pf.SHADING.shadingFillColor );
+        out.put( "\\cbpat" );
+        out.put_int( pf.SHADING.shadingBkColor );
     }
 
-    // Format paragraph font
-    string font;
-    char tmps[1024] = {0};
-
-    snprintf( tmps, 1024,
-              "\\animtext%d\\expndtw%d\\kerning%d\\charscalex%d\\f%d\\fs%d\\cf%d",
-              rtfParFormat.CHARACTER.animatedCharacter,
-              rtfParFormat.CHARACTER.expandCharacter,
-              rtfParFormat.CHARACTER.kerningCharacter,
-              rtfParFormat.CHARACTER.scaleCharacter,
-              rtfParFormat.CHARACTER.fontNumber,
-              rtfParFormat.CHARACTER.fontSize,
-              rtfParFormat.CHARACTER.foregroundColor );
-
-    font += tmps;
-
-    if ( rtfParFormat.CHARACTER.boldCharacter )
-        font += "\\b";
-    else
-        font += "\\b0";
+    // Format paragraph indents and spacing
+    out.put( "\\fi" );
+    out.put_int( pf.firstLineIndent );
+    out.put( "\\li" );
+    out.put_int( pf.leftIndent );
+    out.put( "\\ri" );
+    out.put_int( pf.rightIndent );
+    out.put( "\\sb" );
+    out.put_int( pf.spaceBefore );
+    out.put( "\\sa" );
+    out.put_int( pf.spaceAfter );
+    out.put( "\\sl" );
+    out.put_int( pf.lineSpacing );
+}
 
-    if ( rtfParFormat.CHARACTER.capitalCharacter )
-        font += "\\caps";
-    else
-        font += "\\caps0";
+// Puts RTF paragraph formatting properties, all control words
+// following \par up to paragraph text.
+static void put_paragraphformat( librtf::RtfBuffer& out, const RTF_PARAGRAPH_FORMAT& pf )
+{
+    if ( pf.defaultParagraph )
+        out.put( "\\pard" );
 
-    if ( rtfParFormat.CHARACTER.doublestrikeCharacter )
-        font += "\\striked1";
+    if ( pf.tableText == false )
+        out.put( "\\plain" );
     else
-        font += "\\striked0";
+        out.put( "\\intbl" );
 
-    if ( rtfParFormat.CHARACTER.embossCharacter )
-        font += "\\embo";
-    if ( rtfParFormat.CHARACTER.engraveCharacter )
-        font += "\\impr";
+    put_paragraphbreak( out, pf );
+    put_paragraphproperties( out, pf );
 
-    if ( rtfParFormat.CHARACTER.italicCharacter )
-        font += "\\i";
-    else
-        font += "\\i0";
+    // Format paragraph font
+    put_characterformat( out, pf.CHARACTER );
+}
 
-    if ( rtfParFormat.CHARACTER.outlineCharacter )
-        font += "\\outl";
-    else
-        font += "\\outl0";
+// Puts on/off character toggle if it changed
+static bool put_toggledelta( librtf::RtfBuffer& out, bool last, bool now,
+                             const char* on, const char* off )
+{
+    if ( last == now )
+        return false;
 
-    if ( rtfParFormat.CHARACTER.shadowCharacter )
-        font += "\\shad";
-    else
-        font += "\\shad0";
+    out.put( now ? on : off );
 
-    if ( rtfParFormat.CHARACTER.smallcapitalCharacter )
-        font += "\\scaps";
-    else
-        font += "\\scaps0";
+    return true;
+}
 
-    if ( rtfParFormat.CHARACTER.strikeCharacter )
-        font += "\\strike";
-    else
-        font += "\\strike0";
+// Puts numeric control word if its value changed
+static bool put_valuedelta( librtf::RtfBuffer& out, int last, int now, const char* word )
+{
+    if ( last == now )
+        return false;
 
-    if ( rtfParFormat.CHARACTER.subscriptCharacter )
-        font += "\\sub";
+    out.put( word );
+    out.put_int( now );
 
-    if ( rtfParFormat.CHARACTER.superscriptCharacter )
-        font += "\\super";
+    return true;
+}
 
-    switch (rtfParFormat.CHARACTER.underlineCharacter)
+// Puts only the character formatting properties changed since last.
+// Returns true if anything was put.
+static bool put_characterdelta( librtf::RtfBuffer& out, const RTF_CHARACTER_FORMAT& last,
+                                const RTF_CHARACTER_FORMAT& cf )
+{
+    bool changed = false;
+
+    changed |= put_valuedelta( out, last.animatedCharacter, cf.animatedCharacter, "\\animtext" );
+    changed |= put_valuedelta( out, last.expandCharacter, cf.expandCharacter, "\\expndtw" );
+    changed |= put_valuedelta( out, last.kerningCharacter, cf.kerningCharacter, "\\kerning" );
+    changed |= put_valuedelta( out, last.scaleCharacter, cf.scaleCharacter, "\\charscalex" );
+    changed |= put_valuedelta( out, last.fontNumber, cf.fontNumber, "\\f" );
+    changed |= put_valuedelta( out, last.fontSize, cf.fontSize, "\\fs" );
+    changed |= put_valuedelta( out, last.foregroundColor, cf.foregroundColor, "\\cf" );
+
+    changed |= put_toggledelta( out, last.boldCharacter, cf.boldCharacter, "\\b", "\\b0" );
+    changed |= put_toggledelta( out, last.capitalCharacter, cf.capitalCharacter, "\\caps", "\\caps0" );
+    changed |= put_toggledelta( out, last.doublestrikeCharacter, cf.doublestrikeCharacter, "\\striked1", "\\striked0" );
+    changed |= put_toggledelta( out, last.embossCharacter, cf.embossCharacter, "\\embo", "\\embo0" );
+    changed |= put_toggledelta( out, last.engraveCharacter, cf.engraveCharacter, "\\impr", "\\impr0" );
+    changed |= put_toggledelta( out, last.italicCharacter, cf.italicCharacter, "\\i", "\\i0" );
+    changed |= put_toggledelta( out, last.outlineCharacter, cf.outlineCharacter, "\\outl", "\\outl0" );
+    changed |= put_toggledelta( out, last.shadowCharacter, cf.shadowCharacter, "\\shad", "\\shad0" );
+    changed |= put_toggledelta( out, last.smallcapitalCharacter, cf.smallcapitalCharacter, "\\scaps", "\\scaps0" );
+    changed |= put_toggledelta( out, last.strikeCharacter, cf.strikeCharacter, "\\strike", "\\strike0" );
+
+    // Sub and superscript share one off switch
+    if ( ( last.subscriptCharacter != cf.subscriptCharacter ) ||
+         ( last.superscriptCharacter != cf.superscriptCharacter ) )
     {
-        // None underline
-        case 0:
-            font += "\\ulnone";
-            break;
+        out.put( "\\nosupersub" );
 
-        // Continuous underline
-        case 1:
-            font += "\\ul";
-            break;
+        if ( cf.subscriptCharacter )
+            out.put( "\\sub" );
 
-        // Dotted underline
-        case 2:
-            font += "\\uld";
-            break;
+        if ( cf.superscriptCharacter )
+            out.put( "\\super" );
 
-        // Dashed underline
-        case 3:
-            font += "\\uldash";
-            break;
+        changed = true;
+    }
 
-        // Dash-dotted underline
-        case 4:
-            font += "\\uldashd";
-            break;
+    if ( last.underlineCharacter != cf.underlineCharacter )
+    {
+        // Unknown underline kinds are written as none, like after \plain
+        if ( put_underline( out, cf.underlineCharacter ) == false )
+            out.put( "\\ulnone" );
 
-        // Dash-dot-dotted underline
-        case 5:
-            font += "\\uldashdd";
-            break;
+        changed = true;
+    }
 
-        // Double underline
-        case 6:
-            font += "\\uldb";
-            break;
+    return changed;
+}
 
-        // Heavy wave underline
-        case 7:
-            font += "\\ulhwave";
-            break;
+// Checks tabs, numbering, borders and shading are the same.
+// Those ones are only cleared by \pard.
+static bool is_paragraphsticky( const RTF_PARAGRAPH_FORMAT& last, const RTF_PARAGRAPH_FORMAT& pf )
+{
+    if ( pf.paragraphTabs != last.paragraphTabs )
+        return false;
 
-        // Long dashed underline
-        case 8:
-            font += "\\ulldash";
-            break;
+    if ( pf.paragraphTabs &&
+         memcmp( &pf.TABS, &last.TABS, sizeof(RTF_TABS_FORMAT) ) != 0 )
+        return false;
 
-        // Thick underline
-        case 9:
-            font += "\\ulth";
-            break;
+    if ( pf.paragraphNums != last.paragraphNums )
+        return false;
 
-        // Thick dotted underline
-        case 10:
-            font += "\\ulthd";
-            break;
+    if ( pf.paragraphNums &&
+         ( ( pf.NUMS.numsLevel != last.NUMS.numsLevel ) ||
+           ( pf.NUMS.numsSpace != last.NUMS.numsSpace ) ||
+           ( pf.NUMS.numsChar != last.NUMS.numsChar ) ) )
+        return false;
 
-        // Thick dashed underline
-        case 11:
-            font += "\\ulthdash";
-            break;
+    if ( pf.paragraphBorders != last.paragraphBorders )
+        return false;
 
-        // Thick dash-dotted underline
-        case 12:
-            font += "\\ulthdashd";
-            break;
+    if ( pf.paragraphBorders &&
+         memcmp( &pf.BORDERS, &last.BORDERS, sizeof(RTF_BORDERS_FORMAT) ) != 0 )
+        return false;
 
-        // Thick dash-dot-dotted underline
-        case 13:
-            font += "\\ulthdashdd";
-            break;
+    if ( pf.paragraphShading != last.paragraphShading )
+        return false;
 
-        // Thick long dashed underline
-        case 14:
-            font += "\\ulthldash";
-            break;
+    if ( pf.paragraphShading &&
+         memcmp( &pf.SHADING, &last.SHADING, sizeof(RTF_SHADING_FORMAT) ) != 0 )
+        return false;
 
-        // Double wave underline
-        case 15:
-            font += "\\ululdbwave";
-            break;
+    return true;
+}
 
-        // Word underline
-        case 16:
-            font += "\\ulw";
-            break;
+// Checks paragraph formatting can be written as delta of last,
+// which needs a \pard paragraph with same table state and the same
+// sticky properties.
+static bool is_paragraphdelta( const RTF_PARAGRAPH_FORMAT& last, const RTF_PARAGRAPH_FORMAT& pf )
+{
+    if ( ( pf.defaultParagraph == false ) || ( last.defaultParagraph == false ) )
+        return false;
 
-        // Wave underline
-        case 17:
-            font += "\\ulwave";
-            break;
-    }
+    if ( pf.tableText != last.tableText )
+        return false;
 
-    // Set paragraph tabbed text
-    if ( rtfParFormat.paragraphText != NULL )
+    return is_paragraphsticky( last, pf );
+}
+
+// Puts only the paragraph properties changed since last, without
+// break and character formatting. Returns true if anything was put.
+static bool put_paragraphdelta( librtf::RtfBuffer& out, const RTF_PARAGRAPH_FORMAT& last,
+                                const RTF_PARAGRAPH_FORMAT& pf )
+{
+    bool changed = false;
+
+    if ( pf.paragraphAligment != last.paragraphAligment )
     {
-        if ( rtfParFormat.tabbedText == false )
-        {
-            snprintf( rtfText, 4096,
-                      "\n%s\\fi%d\\li%d\\ri%d\\sb%d\\sa%d\\sl%d%s %s",
-                      text.c_str(),
-                      rtfParFormat.firstLineIndent,
-                      rtfParFormat.leftIndent,
-                      rtfParFormat.rightIndent,
-                      rtfParFormat.spaceBefore,
-                      rtfParFormat.spaceAfter,
-                      rtfParFormat.lineSpacing,
-                      font.c_str(),
-                      rtfParFormat.paragraphText );
-        }
-        else
+        switch ( pf.paragraphAligment )
         {
-            snprintf( rtfText, 4096, "\\tab %s",
-                      rtfParFormat.paragraphText );
+            case RTF_PARAGRAPHALIGN_CENTER:
+                out.put( "\\qc" );
+                break;
+
+            case RTF_PARAGRAPHALIGN_RIGHT:
+                out.put( "\\qr" );
+                break;
+
+            case RTF_PARAGRAPHALIGN_JUSTIFY:
+                out.put( "\\qj" );
+                break;
+
+            // Left and unknown aligments, as after \pard
+            default:
+                out.put( "\\ql" );
+                break;
         }
-    }
 
-    // Writes RTF paragraph formatting properties
-    if ( rtfFile != NULL )
-    {
-        if ( fwrite( rtfText, 1, strlen(rtfText), rtfFile ) < strlen(rtfText) )
-            result = false;
-    }
-    else
-    {
-        result = false;
+        changed = true;
     }
 
-    // Return error flag
-    return result;
+    changed |= put_valuedelta( out, last.firstLineIndent, pf.firstLineIndent, "\\fi" );
+    changed |= put_valuedelta( out, last.leftIndent, pf.leftIndent, "\\li" );
+    changed |= put_valuedelta( out, last.rightIndent, pf.rightIndent, "\\ri" );
+    changed |= put_valuedelta( out, last.spaceBefore, pf.spaceBefore, "\\sb" );
+    changed |= put_valuedelta( out, last.spaceAfter, pf.spaceAfter, "\\sa" );
+    changed |= put_valuedelta( out, last.lineSpacing, pf.lineSpacing, "\\sl" );
+
+    return changed;
 }
 
-// Starts new RTF paragraph
-RTF_ERROR_TYPE librtf::start_paragraph( const char* text, bool newPar )
+// Adds paragraph style to stylesheet
+int librtf::RtfDocument::add_paragraphstyle( const char* name, RTF_PARAGRAPH_FORMAT* pf )
 {
-    // Set error flag
-    RTF_ERROR_TYPE error = RTF_ERROR;
+    if ( ( name == NULL ) || ( pf == NULL ) )
+        return -1;
 
-    if ( rtfParFormat.paragraphText != NULL )
-    {
-        delete[] rtfParFormat.paragraphText;
-        rtfParFormat.paragraphText = NULL;
-    }
+    RtfStyle style;
 
-    if ( text != NULL )
-    {
-        // Copy paragraph text
-        size_t sl = strlen(text);
-        rtfParFormat.paragraphText = new char[sl+1];
-
-        if ( rtfParFormat.paragraphText != NULL )
-        {
-            memset( rtfParFormat.paragraphText, 0, sl+1 );
-            memcpy( rtfParFormat.paragraphText, text, sl );
+    style.number    = (int)rtfStyles.size() + 1;
+    style.character = false;
+    style.name      = name;
 
-            // Set new paragraph
-            rtfParFormat.newParagraph = newPar;
+    memcpy( &style.format, pf, sizeof(RTF_PARAGRAPH_FORMAT) );
+    style.format.paragraphText = NULL;
 
-            // Starts new RTF paragraph
-            if( librtf::write_paragraphformat() == false )
-                error = RTF_PARAGRAPHFORMAT_ERROR;
-            else
-                error = RTF_SUCCESS;
-        }
-    }
+    rtfStyles.push_back( style );
 
-    // Return error flag
-    return error;
+    return style.number;
 }
 
-// Gets RTF document formatting properties
-RTF_DOCUMENT_FORMAT* librtf::get_documentformat()
+// Adds character style to stylesheet
+int librtf::RtfDocument::add_characterstyle( const char* name, RTF_CHARACTER_FORMAT* cf )
 {
-    // Get current RTF document formatting properties
-    return &rtfDocFormat;
-}
+    if ( ( name == NULL ) || ( cf == NULL ) )
+        return -1;
 
-// Gets RTF section formatting properties
-RTF_SECTION_FORMAT* librtf::get_sectionformat()
-{
-    // Get current RTF section formatting properties
-    return &rtfSecFormat;
+    RtfStyle style;
+
+    style.number    = (int)rtfStyles.size() + 1;
+    style.character = true;
+    style.name      = name;
+
+    memset( &style.format, 0, sizeof(RTF_PARAGRAPH_FORMAT) );
+    memcpy( &style.format.CHARACTER, cf, sizeof(RTF_CHARACTER_FORMAT) );
+
+    rtfStyles.push_back( style );
+
+    return style.number;
 }
 
-// Gets RTF paragraph formatting properties
-RTF_PARAGRAPH_FORMAT* librtf::get_paragraphformat()
+// Removes all styles
+void librtf::RtfDocument::clear_styles()
 {
-    // Get current RTF paragraph formatting properties
-    return &rtfParFormat;
+    rtfStyles.clear();
+    rtfParStyle = -1;
+    rtfCharStyle = -1;
 }
 
-// Loads image from file
-RTF_ERROR_TYPE librtf::load_image( const char* image, int width, int height )
+// Sets paragraph style of following paragraphs, -1 for none
+bool librtf::RtfDocument::set_paragraphstyle( int style )
 {
-    // Set error flag
-    RTF_ERROR_TYPE error = RTF_FAILURE;
-
-    if ( rtfFile == NULL )
-        return error;
-
-    // Check image type by file extension
-    bool err = false;
-
-    // If valid image type
-    // Free IPicture object
-    if ( rtfPicture != NULL )
+    if ( style >= 0 )
     {
-        rtfPicture->Release();
-        rtfPicture = NULL;
-    }
+        if ( ( style < 1 ) || ( style > (int)rtfStyles.size() ) )
+            return false;
 
-    // Read image file
-    int imageFile = _open( image, _O_RDONLY | _O_BINARY );
-    struct _stat st;
-    _fstat( imageFile, &st );
-    DWORD nSize = st.st_size;
-    BYTE* pBuff = new BYTE[nSize];
-    _read( imageFile, pBuff, nSize );
+        if ( rtfStyles[ style - 1 ].character == true )
+            return false;
+    }
 
-    // Alocate memory for image data
-    HGLOBAL hGlobal = GlobalAlloc(GMEM_MOVEABLE, nSize);
-    void* pData = GlobalLock(hGlobal);
-    memcpy(pData, pBuff, nSize);
-    GlobalUnlock(hGlobal);
+    rtfParStyle = ( style < 0 ) ? -1 : style;
 
-    // Load image using OLE
-    IStream* pStream = NULL;
+    return true;
+}
 
-    if ( CreateStreamOnHGlobal(hGlobal, TRUE, &pStream) == S_OK )
+// Sets character style of following paragraphs, -1 for none
+bool librtf::RtfDocument::set_characterstyle( int style )
+{
+    if ( style >= 0 )
     {
-        HRESULT hr;
-
-        if ((hr = OleLoadPicture( pStream, nSize, FALSE, IID_IPicture, (LPVOID *)&rtfPicture)) != S_OK)
-            error = RTF_IMAGE_ERROR;
+        if ( ( style < 1 ) || ( style > (int)rtfStyles.size() ) )
+            return false;
 
-        pStream->Release();
+        if ( rtfStyles[ style - 1 ].character == false )
+            return false;
     }
 
-    delete []pBuff;
-    _close(imageFile);
+    rtfCharStyle = ( style < 0 ) ? -1 : style;
 
-    // If image is loaded
-    if ( rtfPicture != NULL )
+    return true;
+}
+
+// Puts RTF stylesheet group
+void librtf::RtfDocument::put_stylesheet()
+{
+    if ( rtfStyles.size() == 0 )
+        return;
+
+    rtfOut.put( "{\\stylesheet{\\s0 Normal;}" );
+
+    for ( size_t cnt=0; cnt<rtfStyles.size(); cnt++ )
     {
-        // Calculate image size
-        long hmWidth = 0;
-        long hmHeight = 0;
-        rtfPicture->get_Width(&hmWidth);
-        rtfPicture->get_Height(&hmHeight);
-        int nWidth  = MulDiv( hmWidth, GetDeviceCaps(GetDC(NULL),LOGPIXELSX), 2540 );
-        int nHeight = MulDiv( hmHeight, GetDeviceCaps(GetDC(NULL),LOGPIXELSY), 2540 );
+        const RtfStyle& style = rtfStyles[cnt];
 
-        // Create metafile;
-        HDC hdcMeta = CreateMetaFile(NULL);
+        if ( style.character == false )
+        {
+            rtfOut.put( "{\\s" );
+            rtfOut.put_int( style.number );
+            put_paragraphproperties( rtfOut, style.format );
+            put_characterformat( rtfOut, style.format.CHARACTER );
+        }
+        else
+        {
+            rtfOut.put( "{\\*\\cs" );
+            rtfOut.put_int( style.number );
+            rtfOut.put( "\\additive" );
+            put_characterformat( rtfOut, style.format.CHARACTER );
+        }
 
-        // Render picture to metafile
-        rtfPicture->Render( hdcMeta, 0, 0, nWidth, nHeight, 0, hmHeight, hmWidth, -hmHeight, NULL );
+        rtfOut.put_char( ' ' );
+        rtfOut.put( style.name.c_str(), style.name.size() );
+        rtfOut.put( ";}" );
+    }
 
-        // Close metafile
-        HMETAFILE hmf = CloseMetaFile(hdcMeta);
+    rtfOut.put_char( '}' );
+}
 
-        // Get metafile data
-        UINT size = GetMetaFileBitsEx( hmf, 0, NULL );
-        BYTE* buffer = new BYTE[size];
-        GetMetaFileBitsEx( hmf, size, buffer );
-        DeleteMetaFile(hmf);
+// Puts styled paragraph formatting, \sN and \csN followed by
+// properties differing from the styles only.
+void librtf::RtfDocument::put_styledparagraph()
+{
+    const RTF_PARAGRAPH_FORMAT* ps = NULL;
+    const RTF_CHARACTER_FORMAT* cs = NULL;
 
-        // Convert metafile binary data to hexadecimal
-        char* hexstr = librtf::bin_hex_convert( buffer, size );
-        delete []buffer;
+    rtfOut.put( "\\pard" );
 
-        // Format picture paragraph
-        RTF_PARAGRAPH_FORMAT* pf = librtf::get_paragraphformat();
-        pf->paragraphText = NULL;
-        librtf::write_paragraphformat();
+    if ( rtfParFormat.tableText == false )
+        rtfOut.put( "\\plain" );
+    else
+        rtfOut.put( "\\intbl" );
 
-        // Writes RTF picture data
-        char rtfText[128] = {0};
-        snprintf( rtfText, 128,
-                  "\n{\\pict\\wmetafile8\\picwgoal%d\\pichgoal%d\\picscalex%d\\picscaley%d\n",
-                  hmWidth, hmHeight, width, height );
+    if ( rtfParStyle >= 0 )
+    {
+        ps = &rtfStyles[ rtfParStyle - 1 ].format;
+        cs = &ps->CHARACTER;
 
-        if ( fwrite( rtfText, 1, strlen(rtfText), rtfFile ) < strlen(rtfText) )
-        {
-            error = RTF_IMAGE_ERROR;
-            return error;
-        }
+        rtfOut.put( "\\s" );
+        rtfOut.put_int( rtfParStyle );
+    }
 
-        fwrite( hexstr, 1, 2*size, rtfFile );
+    put_paragraphbreak( rtfOut, rtfParFormat );
 
-        delete[] hexstr;
+    // Style can't drop its tabs, numbering, borders or shading,
+    // so write all properties when those differ.
+    if ( ( ps != NULL ) && is_paragraphsticky( *ps, rtfParFormat ) )
+        put_paragraphdelta( rtfOut, *ps, rtfParFormat );
+    else
+        put_paragraphproperties( rtfOut, rtfParFormat );
 
-        strncpy( rtfText, "}", 128 );
-        fwrite( rtfText, 1, strlen(rtfText), rtfFile );
+    if ( rtfCharStyle >= 0 )
+    {
+        cs = &rtfStyles[ rtfCharStyle - 1 ].format.CHARACTER;
 
-        error = RTF_SUCCESS;
+        rtfOut.put( "\\cs" );
+        rtfOut.put_int( rtfCharStyle );
     }
 
-    // Return error flag
-    return error;
+    if ( cs != NULL )
+        put_characterdelta( rtfOut, *cs, rtfParFormat.CHARACTER );
+    else
+        put_characterformat( rtfOut, rtfParFormat.CHARACTER );
 }
 
-// Converts binary data to hex
-char* librtf::bin_hex_convert( const unsigned char* binary, size_t size )
+// Compiles paragraph format
+librtf::RtfParagraphHandle::RtfParagraphHandle( const RTF_PARAGRAPH_FORMAT* pf )
 {
-    if ( (binary == NULL ) || ( size == 0 ) )
-        return NULL;
+    memset( &fmt, 0, sizeof(RTF_PARAGRAPH_FORMAT) );
 
-    size_t actualsize = (2 * size) + 1;
-    char* result = new char[ actualsize ];
+    if ( pf != NULL )
+    {
+        memcpy( &fmt, pf, sizeof(RTF_PARAGRAPH_FORMAT) );
+        fmt.paragraphText = NULL;
+    }
 
-    if ( result == NULL )
-        return NULL;
+    RtfBuffer out( 256 );
 
-    memset( result, 0, actualsize );
+    put_paragraphformat( out, fmt );
+    prefix.assign( out.data(), out.size() );
+}
 
-    char part1, part2;
+// Writes RTF paragraph formatting properties
+bool librtf::RtfDocument::write_paragraphformat()
+{
+    if ( rtfSink == NULL )
+        return false;
 
-    for ( size_t cnt=0; cnt<size; cnt++ )
+    // Set paragraph tabbed text
+    if ( rtfParFormat.paragraphText != NULL )
     {
-        part1 = binary[cnt] / 16;
-
-        if ( part1 < 10 )
-            part1 += 48;
-        else
+        if ( rtfParFormat.tabbedText == false )
         {
-            if ( part1 == 10 )
-                part1 = 'a';
-            if ( part1 == 11 )
-                part1 = 'b';
-            if ( part1 == 12 )
-                part1 = 'c';
-            if ( part1 == 13 )
-                part1 = 'd';
-            if ( part1 == 14 )
-                part1 = 'e';
-            if ( part1 == 15 )
-                part1 = 'f';
+            rtfOut.put_char( '\n' );
+
+            // Format new paragraph
+            bool delimit = false;
+
+            if ( rtfParFormat.newParagraph )
+            {
+                rtfOut.put( "\\par" );
+                delimit = true;
+            }
+
+            if ( ( rtfDeltaFormat == true ) && ( rtfLastValid == true ) &&
+                 ( rtfLastParStyle == rtfParStyle ) &&
+                 ( rtfLastCharStyle == rtfCharStyle ) &&
+                 is_paragraphdelta( rtfLastParFormat, rtfParFormat ) )
+            {
+                if ( put_paragraphbreak( rtfOut, rtfParFormat ) == true )
+                    delimit = true;
+
+                if ( put_paragraphdelta( rtfOut, rtfLastParFormat, rtfParFormat ) == true )
+                    delimit = true;
+
+                if ( put_characterdelta( rtfOut, rtfLastParFormat.CHARACTER,
+                                         rtfParFormat.CHARACTER ) == true )
+                    delimit = true;
+            }
+            else if ( ( rtfParStyle >= 0 ) || ( rtfCharStyle >= 0 ) )
+            {
+                put_styledparagraph();
+                delimit = true;
+            }
+            else
+            {
+                put_paragraphformat( rtfOut, rtfParFormat );
+                delimit = true;
+            }
+
+            // Remember formatting in effect after this paragraph
+            if ( rtfDeltaFormat == true )
+            {
+                memcpy( &rtfLastParFormat, &rtfParFormat, sizeof(RTF_PARAGRAPH_FORMAT) );
+                rtfLastParFormat.paragraphText = NULL;
+                rtfLastParStyle = rtfParStyle;
+                rtfLastCharStyle = rtfCharStyle;
+                rtfLastValid = true;
+            }
+
+            if ( delimit == true )
+                rtfOut.put_char( ' ' );
+
+            put_text( rtfParFormat.paragraphText );
         }
-
-        part2 = binary[cnt] % 16;
-
-        if ( part2 < 10 )
-            part2 += 48;
         else
         {
-            if ( part2 == 10 )
-                part2 = 'a';
-            if ( part2 == 11 )
-                part2 = 'b';
-            if ( part2 == 12 )
-                part2 = 'c';
-            if ( part2 == 13 )
-                part2 = 'd';
-            if ( part2 == 14 )
-                part2 = 'e';
-            if ( part2 == 15 )
-                part2 = 'f';
+            rtfOut.put( "\\tab " );
+            put_text( rtfParFormat.paragraphText );
         }
-
-        result[2*cnt  ] = part1;
-        result[2*cnt+1] = part2;
     }
 
-    return result;
+    // Return error flag
+    return end_fragment();
 }
 
-
-// Starts new RTF table row
-RTF_ERROR_TYPE librtf::start_tablerow()
+// Starts new RTF paragraph
+RTF_ERROR_TYPE librtf::RtfDocument::start_paragraph( const char* text, bool newPar )
 {
     // Set error flag
-    RTF_ERROR_TYPE error = RTF_SUCCESS;
+    RTF_ERROR_TYPE error = RTF_ERROR;
 
-    string tblrw;
+    rtfParFormat.paragraphText = NULL;
 
-    // Format table row aligment
-    switch (rtfRowFormat.rowAligment)
+    if ( text != NULL )
     {
-        // Left align
-        case RTF_ROWTEXTALIGN_LEFT:
-            tblrw = "\\trql";
-            break;
+        // Copy paragraph text into text buffer, grown only for longer text
+        size_t sl = strlen(text);
 
-        // Center align
-        case RTF_ROWTEXTALIGN_CENTER:
-            tblrw = "\\trqc";
-            break;
+        if ( sl + 1 > rtfTextSize )
+        {
+            size_t newsize = ( rtfTextSize > 0 ) ? rtfTextSize * 2 : 256;
 
-        // Right align
-        case RTF_ROWTEXTALIGN_RIGHT:
-            tblrw = "\\trqr";
-            break;
-    }
+            while ( newsize < sl + 1 )
+                newsize *= 2;
 
-    // Writes RTF table data
-    char rtfText[1024] = {0};
+            delete[] rtfTextBuffer;
+            rtfTextBuffer = new char[newsize];
+            rtfTextSize = newsize;
+        }
 
-    snprintf( rtfText, 1024,
-              "\n\\trowd\\trgaph115%s\\trleft%d\\trrh%d\\trpaddb%d\\trpaddfb3\\trpaddl%d\\trpaddfl3\\trpaddr%d\\trpaddfr3\\trpaddt%d\\trpaddft3",
-              tblrw.c_str(),
-              rtfRowFormat.rowLeftMargin,
-              rtfRowFormat.rowHeight,
-              rtfRowFormat.marginTop,
-              rtfRowFormat.marginBottom,
-              rtfRowFormat.marginLeft,
-              rtfRowFormat.marginRight );
-
-    if ( rtfFile != NULL )
-    {
-        if ( fwrite( rtfText, 1, strlen(rtfText), rtfFile ) < strlen(rtfText) )
-            error = RTF_TABLE_ERROR;
-    }
-    else
-    {
-        error = RTF_FAILURE;
+        if ( rtfTextBuffer != NULL )
+        {
+            // Text may be previous paragraph text in buffer
+            memmove( rtfTextBuffer, text, sl + 1 );
+            rtfParFormat.paragraphText = rtfTextBuffer;
+
+            // Set new paragraph
+            rtfParFormat.newParagraph = newPar;
+
+            // Starts new RTF paragraph
+            if( write_paragraphformat() == false )
+                error = RTF_PARAGRAPHFORMAT_ERROR;
+            else
+                error = RTF_SUCCESS;
+        }
     }
 
     // Return error flag
     return error;
 }
 
-
-// Ends RTF table row
-RTF_ERROR_TYPE librtf::end_tablerow()
+// Puts RTF paragraph start with precompiled format, up to paragraph text
+void librtf::RtfDocument::put_handleparagraph( const RtfParagraphHandle& handle, bool newPar )
 {
-    // Set error flag
-    RTF_ERROR_TYPE error = RTF_SUCCESS;
-
-    // Writes RTF table data
-    char rtfText[] = "\n\\trgaph115\\row\\pard";
+    const RTF_PARAGRAPH_FORMAT* pf = handle.format();
 
-    if ( rtfFile != NULL )
+    if ( pf->tabbedText == false )
     {
-        if ( fwrite( rtfText, 1, strlen(rtfText), rtfFile ) < strlen(rtfText) )
-            error = RTF_TABLE_ERROR;
+        rtfOut.put_char( '\n' );
+
+        if ( newPar == true )
+            rtfOut.put( "\\par" );
+
+        rtfOut.put( handle.data(), handle.size() );
+        rtfOut.put_char( ' ' );
+
+        // Formatting in effect is now the handle one
+        if ( rtfDeltaFormat == true )
+        {
+            memcpy( &rtfLastParFormat, pf, sizeof(RTF_PARAGRAPH_FORMAT) );
+            rtfLastParStyle = -1;
+            rtfLastCharStyle = -1;
+            rtfLastValid = pf->defaultParagraph;
+        }
     }
     else
     {
-        error = RTF_FAILURE;
+        rtfOut.put( "\\tab " );
     }
-
-    // Return error flag
-    return error;
 }
 
-
-// Starts new RTF table cell
-RTF_ERROR_TYPE librtf::start_tablecell(int rightMargin)
+// Writes RTF paragraph with precompiled format
+RTF_ERROR_TYPE librtf::RtfDocument::write_paragraph( const RtfParagraphHandle& handle,
+                                                     const char* text, bool newPar )
 {
-    // Set error flag
-    RTF_ERROR_TYPE error = RTF_SUCCESS;
+    if ( text == NULL )
+        return RTF_ERROR;
 
-    char tblcla[20] = {0};
+    if ( rtfSink == NULL )
+        return RTF_PARAGRAPHFORMAT_ERROR;
 
-    // Format table cell text aligment
-    switch (rtfCellFormat.textVerticalAligment)
-    {
-        // Top align
-        case RTF_CELLTEXTALIGN_TOP:
-            strncpy( tblcla, "\\clvertalt", 20 );
-            break;
+    put_handleparagraph( handle, newPar );
+    put_text( text );
 
-        // Center align
-        case RTF_CELLTEXTALIGN_CENTER:
-            strncpy( tblcla, "\\clvertalc", 20 );
-            break;
+    if ( end_fragment() == false )
+        return RTF_PARAGRAPHFORMAT_ERROR;
 
-        // Bottom align
-        case RTF_CELLTEXTALIGN_BOTTOM:
-            strncpy( tblcla, "\\clvertalb", 20 );
-            break;
-    }
+    return RTF_SUCCESS;
+}
 
-    char tblcld[20] = {0};
+// Checks paragraph has a decimal tab stop to align numbers at
+static bool is_decimaltabbed( const RTF_PARAGRAPH_FORMAT* pf )
+{
+    return ( pf->tabbedText == false ) && ( pf->paragraphTabs == true ) &&
+           ( pf->TABS.tabKind == RTF_PARAGRAPHTABKIND_DECIMAL );
+}
 
-    // Format table cell text direction
-    switch (rtfCellFormat.textDirection)
-    {
-        // Left to right, top to bottom
-        case RTF_CELLTEXTDIRECTION_LRTB:
-            strncpy( tblcld, "\\cltxlrtb", 20 );
-            break;
+// Writes RTF paragraph of number text with precompiled format
+RTF_ERROR_TYPE librtf::RtfDocument::write_number( const RtfParagraphHandle& handle,
+                                                  const char* text, size_t length,
+                                                  bool newPar )
+{
+    if ( text == NULL )
+        return RTF_ERROR;
 
-        // Right to left, top to bottom
-        case RTF_CELLTEXTDIRECTION_RLTB:
-            strncpy( tblcld, "\\cltxtbrl", 20 );
-            break;
+    if ( rtfSink == NULL )
+        return RTF_PARAGRAPHFORMAT_ERROR;
 
-        // Left to right, bottom to top
-        case RTF_CELLTEXTDIRECTION_LRBT:
-            strncpy( tblcld, "\\cltxbtlr", 20 );
-            break;
+    put_handleparagraph( handle, newPar );
 
-        // Left to right, top to bottom, vertical
-        case RTF_CELLTEXTDIRECTION_LRTBV:
-            strncpy( tblcld, "\\cltxlrtbv", 20 );
-            break;
+    if ( is_decimaltabbed( handle.format() ) == true )
+        rtfOut.put( "\\tab " );
 
-        // Right to left, top to bottom, vertical
-        case RTF_CELLTEXTDIRECTION_RLTBV:
-            strncpy( tblcld, "\\cltxtbrlv", 20 );
-            break;
-    }
+    put_text( text, length );
 
-    char tbclbrb[1024] = {0};
-    char tbclbrl[1024] = {0};
-    char tbclbrr[1024] = {0};
-    char tbclbrt[1024] = {0};
+    if ( end_fragment() == false )
+        return RTF_PARAGRAPHFORMAT_ERROR;
 
-    // Format table cell border
-    if ( rtfCellFormat.borderBottom.border == true )
-    {
-        // Bottom cell border
-        const char* border = librtf::get_bordername(rtfCellFormat.borderBottom.BORDERS.borderType);
+    return RTF_SUCCESS;
+}
 
-        if ( border != NULL )
-        {
-            snprintf( tbclbrb, 1024,
-                      "%s%s\\brdrw%d\\brsp%d\\brdrcf%d",
-                      "\\clbrdrb",
-                      border,
-                      rtfCellFormat.borderBottom.BORDERS.borderWidth,
-                      rtfCellFormat.borderBottom.BORDERS.borderSpace,
-                      rtfCellFormat.borderBottom.BORDERS.borderColor );
-        }
-    }
+// Writes RTF paragraph of integer
+RTF_ERROR_TYPE librtf::RtfDocument::write_integer( const RtfParagraphHandle& handle,
+                                                   long long value,
+                                                   const RTF_NUMBER_FORMAT* nf, bool newPar )
+{
+    char   text[RTF_NUMBER_BUFFERSIZE];
+    size_t length = format_integer( text, value, nf );
 
-    if ( rtfCellFormat.borderLeft.border == true )
-    {
-        // Left cell border
-        const char* border = librtf::get_bordername(rtfCellFormat.borderLeft.BORDERS.borderType);
+    return write_number( handle, text, length, newPar );
+}
 
-        if ( border != NULL )
-        {
-            snprintf( tbclbrl, 1024,
-                      "%s%s\\brdrw%d\\brsp%d\\brdrcf%d",
-                      "\\clbrdrl",
-                      border,
-                      rtfCellFormat.borderLeft.BORDERS.borderWidth,
-                      rtfCellFormat.borderLeft.BORDERS.borderSpace,
-                      rtfCellFormat.borderLeft.BORDERS.borderColor );
-        }
-    }
-    if ( rtfCellFormat.borderRight.border == true )
-    {
-        // Right cell border
-        const char* border = librtf::get_bordername(rtfCellFormat.borderRight.BORDERS.borderType);
+// Writes RTF paragraph of fixed-point number
+RTF_ERROR_TYPE librtf::RtfDocument::write_fixed( const RtfParagraphHandle& handle,
+                                                 long long value, int scale,
+                                                 const RTF_NUMBER_FORMAT* nf, bool newPar )
+{
+    char   text[RTF_NUMBER_BUFFERSIZE];
+    size_t length = format_fixed( text, value, scale, nf );
 
-        if ( border != NULL )
-        {
-            snprintf( tbclbrr, 1024,
-                      "%s%s\\brdrw%d\\brsp%d\\brdrcf%d",
-                      "\\clbrdrr",
-                      border,
-                      rtfCellFormat.borderRight.BORDERS.borderWidth,
-                      rtfCellFormat.borderRight.BORDERS.borderSpace,
-                      rtfCellFormat.borderRight.BORDERS.borderColor );
-        }
-    }
-    if ( rtfCellFormat.borderTop.border == true )
-    {
-        // Top cell border
-        const char* border = librtf::get_bordername(rtfCellFormat.borderTop.BORDERS.borderType);
-        if ( border != NULL )
-        {
-            snprintf( tbclbrt, 1024,
-                      "%s%s\\brdrw%d\\brsp%d\\brdrcf%d",
-                      "\\clbrdrt",
-                      border,
-                      rtfCellFormat.borderTop.BORDERS.borderWidth,
-                      rtfCellFormat.borderTop.BORDERS.borderSpace,
-                      rtfCellFormat.borderTop.BORDERS.borderColor );
-        }
-    }
+    return write_number( handle, text, length, newPar );
+}
 
-    // Format table cell shading
-    char shading[128] = {0};
+// Writes RTF paragraph of double
+RTF_ERROR_TYPE librtf::RtfDocument::write_double( const RtfParagraphHandle& handle,
+                                                  double value,
+                                                  const RTF_NUMBER_FORMAT* nf, bool newPar )
+{
+    char   text[RTF_NUMBER_BUFFERSIZE];
+    size_t length = format_double( text, value, nf );
 
-    if ( rtfCellFormat.cellShading == true )
-    {
-        const char* sh = librtf::get_shadingname( rtfCellFormat.SHADING.shadingType, true );
+    return write_number( handle, text, length, newPar );
+}
 
-        if ( sh != NULL )
-        {
-            // Set paragraph shading color
-            snprintf( shading, 128,
-                      "%s\\clshdgn%d\\clcfpat%d\\clcbpat%d",
-                      sh,
-                      rtfCellFormat.SHADING.shadingIntensity,
-                      rtfCellFormat.SHADING.shadingFillColor,
-                      rtfCellFormat.SHADING.shadingBkColor );
+// Gets RTF document formatting properties
+RTF_DOCUMENT_FORMAT* librtf::RtfDocument::get_documentformat()
+{
+    // Get current RTF document formatting properties
+    return &rtfDocFormat;
+}
+
+// Gets RTF section formatting properties
+RTF_SECTION_FORMAT* librtf::RtfDocument::get_sectionformat()
+{
+    // Get current RTF section formatting properties
+    return &rtfSecFormat;
+}
+
+// Gets RTF paragraph formatting properties
+RTF_PARAGRAPH_FORMAT* librtf::RtfDocument::get_paragraphformat()
+{
+    // Get current RTF paragraph formatting properties
+    return &rtfParFormat;
+}
+
+// Reads whole file, caller must free() data
+static unsigned char* read_file( const char* filename, size_t* size )
+{
+    if ( filename == NULL )
+        return NULL;
+
+    FILE* fp = fopen( filename, "rb" );
+
+    if ( fp == NULL )
+        return NULL;
+
+    unsigned char* data = NULL;
+    long           len = -1;
+
+    if ( fseek( fp, 0, SEEK_END ) == 0 )
+        len = ftell( fp );
+
+    if ( ( len > 0 ) && ( fseek( fp, 0, SEEK_SET ) == 0 ) )
+    {
+        data = (unsigned char*)malloc( len );
+
+        if ( ( data != NULL ) && ( fread( data, 1, len, fp ) != (size_t)len ) )
+        {
+            free( data );
+            data = NULL;
         }
     }
 
-    // Writes RTF table data
-    char rtfText[1024] = {0};
-    snprintf( rtfText, 1024,
-              "\n\\tcelld%s%s%s%s%s%s%s\\cellx%d",
-              tblcla, tblcld, tbclbrb, tbclbrl, tbclbrr, tbclbrt,
-              shading, rightMargin );
+    fclose( fp );
 
-    if ( fwrite( rtfText, 1, strlen(rtfText), rtfFile ) < strlen(rtfText) )
-        error = RTF_TABLE_ERROR;
+    if ( data != NULL )
+        *size = (size_t)len;
 
-    // Return error flag
-    return error;
+    return data;
 }
 
-// Ends RTF table cell
-RTF_ERROR_TYPE librtf::end_tablecell()
+// Checks picture data size fits \binN parameter, hex data has no limit
+static bool is_picturesize( size_t size, bool binary )
 {
-    // Set error flag
-    RTF_ERROR_TYPE error = RTF_SUCCESS;
-
-    // Writes RTF table data
-    char rtfText[] = "\n\\cell ";
+    return ( binary == false ) || ( size <= INT_MAX );
+}
 
-    if ( rtfFile != NULL )
+// Puts picture data as hex, or as raw bytes after \binN, size checked
+// by is_picturesize()
+static void put_picturedata( librtf::RtfBuffer& out, const unsigned char* data,
+                             size_t size, bool binary )
+{
+    if ( binary == true )
     {
-        if ( fwrite( rtfText, 1, strlen(rtfText), rtfFile ) <= 0 )
-            error = RTF_TABLE_ERROR;
+        out.put( "\\bin" );
+        out.put_int( (int)size );
+        out.put_char( ' ' );
+        out.put( (const char*)data, size );
     }
     else
     {
-        error = RTF_FAILURE;
+        librtf::put_hex( out, data, size, RTF_HEX_LINEWIDTH );
     }
-
-    // Return error flag
-    return error;
 }
 
-
-// Gets RTF table row formatting properties
-RTF_TABLEROW_FORMAT* librtf::get_tablerowformat()
+// Puts PNG or JPEG picture, compressed image data is embedded as is
+static void put_blippicture( librtf::RtfBuffer& out, const librtf::RTF_IMAGE_INFO& info,
+                             const unsigned char* data, size_t size,
+                             int width, int height, bool binary )
 {
-    // Get current RTF table row formatting properties
-    return &rtfRowFormat;
+    if ( info.imageType == RTF_IMAGETYPE_PNG )
+        out.put( "\n{\\pict\\pngblip" );
+    else
+        out.put( "\n{\\pict\\jpegblip" );
+
+    // Size in pixels, goal size in twips
+    out.put( "\\picw" );
+    out.put_int( info.width );
+    out.put( "\\pich" );
+    out.put_int( info.height );
+    out.put( "\\picwgoal" );
+    out.put_int( (int)( (long long)info.width * 1440 / info.dpiX ) );
+    out.put( "\\pichgoal" );
+    out.put_int( (int)( (long long)info.height * 1440 / info.dpiY ) );
+    out.put( "\\picscalex" );
+    out.put_int( width );
+    out.put( "\\picscaley" );
+    out.put_int( height );
+    out.put_char( '\n' );
+
+    put_picturedata( out, data, size, binary );
+
+    out.put_char( '}' );
 }
 
-
-// Sets RTF table row formatting properties
-void librtf::set_tablerowformat(RTF_TABLEROW_FORMAT* rf)
+// Formats picture paragraph
+void librtf::RtfDocument::begin_picture()
 {
-    // Set new RTF table row formatting properties
-    if ( rf != NULL )
-        memcpy( &rtfRowFormat, rf, sizeof(RTF_TABLEROW_FORMAT) );
+    RTF_PARAGRAPH_FORMAT* pf = get_paragraphformat();
+    pf->paragraphText = NULL;
+    write_paragraphformat();
 }
 
-
-// Gets RTF table cell formatting properties
-RTF_TABLECELL_FORMAT* librtf::get_tablecellformat()
+// Puts picture group of image data
+RTF_ERROR_TYPE librtf::RtfDocument::put_picture( RtfBuffer& out,
+                                                 const unsigned char* data, size_t size,
+                                                 int width, int height )
 {
-    // Get current RTF table cell formatting properties
-    return &rtfCellFormat;
-}
+    // \binN length is a 32 bit parameter
+    if ( is_picturesize( size, rtfBinaryImages ) == false )
+        return RTF_IMAGE_ERROR;
 
+    // PNG and JPEG are embedded without decoding
+    RTF_IMAGE_INFO info;
 
-// Sets RTF table cell formatting properties
-void librtf::set_tablecellformat(RTF_TABLECELL_FORMAT* cf)
-{
-    // Set new RTF table cell formatting properties
-    if ( cf != NULL )
-        memcpy( &rtfCellFormat, cf, sizeof(RTF_TABLECELL_FORMAT) );
+    if ( get_imageinfo( data, size, &info ) == true )
+    {
+        put_blippicture( out, info, data, size, width, height, rtfBinaryImages );
+        return RTF_SUCCESS;
+    }
+
+#ifdef _WIN32
+    // Other formats are rendered to metafile with OLE
+    return put_oleimage( out, data, size, width, height );
+#else
+    return RTF_IMAGE_ERROR;
+#endif
 }
 
-// Gets border name
-const char* librtf::get_bordername(int border_type)
+// Gets cache key of picture group rendered from content key
+std::string librtf::RtfDocument::get_picturekey( const std::string& key, int width, int height )
 {
-    static string border;
+    return key + ":" + std::to_string( width ) + ":" + std::to_string( height ) +
+           ( rtfBinaryImages ? ":bin" : ":hex" );
+}
 
-    if ( border.size() > 0 )
-        border.clear();
+// Prepares image insertion
+bool librtf::RtfDocument::begin_image()
+{
+    if ( rtfSink == NULL )
+        return false;
 
-    switch (border_type)
+#ifdef _WIN32
+    // Free IPicture object
+    if ( rtfPicture != NULL )
     {
-        // Single-thickness border
-        case RTF_PARAGRAPHBORDERTYPE_STHICK:
-            border = "\\brdrs";
-            break;
+        ((IPicture*)rtfPicture)->Release();
+        rtfPicture = NULL;
+    }
+#endif
 
-        // Double-thickness border
-        case RTF_PARAGRAPHBORDERTYPE_DTHICK:
-            border = "\\brdrth";
-            break;
+    // Picture group may change formatting state
+    rtfLastValid = false;
 
-        // Shadowed border
-        case RTF_PARAGRAPHBORDERTYPE_SHADOW:
-            border = "\\brdrsh";
-            break;
+    return true;
+}
 
-        // Double border
-        case RTF_PARAGRAPHBORDERTYPE_DOUBLE:
-            border = "\\brdrdb";
-            break;
+// Writes cached picture group
+RTF_ERROR_TYPE librtf::RtfDocument::write_picture( const RtfImageBlob& blob )
+{
+    begin_picture();
+    rtfOut.put( blob->data(), blob->size() );
 
-        // Dotted border
-        case RTF_PARAGRAPHBORDERTYPE_DOT:
-            border = "\\brdrdot";
-            break;
+    if ( end_fragment() == false )
+        return RTF_IMAGE_ERROR;
 
-        // Dashed border
-        case RTF_PARAGRAPHBORDERTYPE_DASH:
-            border =  "\\brdrdash";
-            break;
+    return RTF_SUCCESS;
+}
 
-        // Hairline border
-        case RTF_PARAGRAPHBORDERTYPE_HAIRLINE:
-            border = "\\brdrhair";
-            break;
+// Writes picture of image data, through image cache if set. key is
+// content key of data or empty, searched is true if picture was
+// already looked up in cache. key is cleared if it collides with a
+// picture of other data, which is then written uncached.
+RTF_ERROR_TYPE librtf::RtfDocument::write_image( const unsigned char* data, size_t size,
+                                                 int width, int height,
+                                                 std::string& key, bool searched )
+{
+    RTF_ERROR_TYPE error = RTF_IMAGE_ERROR;
 
-        // Inset border
-        case RTF_PARAGRAPHBORDERTYPE_INSET:
-            border = "\\brdrinset";
-            break;
+    // Picture is encoded from data in place
+    if ( rtfImageCache == NULL )
+    {
+        begin_picture();
 
-        // Dashed border (small)
-        case RTF_PARAGRAPHBORDERTYPE_SDASH:
-            border = "\\brdrdashsm";
-            break;
+        // Writes RTF picture data
+        error = put_picture( rtfOut, data, size, width, height );
 
-        // Dot-dashed border
-        case RTF_PARAGRAPHBORDERTYPE_DOTDASH:
-            border = "\\brdrdashd";
-            break;
+        if ( ( error == RTF_SUCCESS ) && ( end_fragment() == false ) )
+            error = RTF_IMAGE_ERROR;
 
-        // Dot-dot-dashed border
-        case RTF_PARAGRAPHBORDERTYPE_DOTDOTDASH:
-            border = "\\brdrdashdd";
-            break;
+        return error;
+    }
 
-        // Outset border
-        case RTF_PARAGRAPHBORDERTYPE_OUTSET:
-            border = "\\brdroutset";
-            break;
+    RtfImageBlob blob;
+    bool         collision = false;
 
-        // Triple border
-        case RTF_PARAGRAPHBORDERTYPE_TRIPLE:
-            border = "\\brdrtriple";
-            break;
+    if ( key.empty() == true )
+        key = RtfImageCache::get_contentkey( data, size );
 
-        // Wavy border
-        case RTF_PARAGRAPHBORDERTYPE_WAVY:
-            border = "\\brdrwavy";
-            break;
+    if ( searched == false )
+        blob = rtfImageCache->find( get_picturekey( key, width, height ), data, size, &collision );
 
-        // Double wavy border
-        case RTF_PARAGRAPHBORDERTYPE_DWAVY:
-            border = "\\brdrwavydb";
-            break;
+    if ( blob == NULL )
+    {
+        RtfBuffer picture( 2 * size + 256 );
 
-        // Striped border
-        case RTF_PARAGRAPHBORDERTYPE_STRIPED:
-            border = "\\brdrdashdotstr";
-            break;
+        error = put_picture( picture, data, size, width, height );
 
-        // Embossed border
-        case RTF_PARAGRAPHBORDERTYPE_EMBOSS:
-            border = "\\brdremboss";
-            break;
+        if ( error != RTF_SUCCESS )
+            return error;
 
-        // Engraved border
-        case RTF_PARAGRAPHBORDERTYPE_ENGRAVE:
-            border = "\\brdrengrave";
-            break;
+        if ( collision == false )
+        {
+            blob = rtfImageCache->insert( get_picturekey( key, width, height ),
+                                          picture.data(), picture.size(),
+                                          data, size, &collision );
+        }
+
+        if ( collision == true )
+        {
+            key.clear();
+
+            begin_picture();
+            rtfOut.put( picture.data(), picture.size() );
+
+            if ( end_fragment() == false )
+                return RTF_IMAGE_ERROR;
+
+            return RTF_SUCCESS;
+        }
     }
 
-    return border.c_str();
+    return write_picture( blob );
 }
 
-
-// Gets shading name
-const char* librtf::get_shadingname( int shading_type, bool cell )
+// Loads image file, read or memory mapped
+RTF_ERROR_TYPE librtf::RtfDocument::load_imagefile( const char* image, int width, int height,
+                                                    bool mapped )
 {
-    static string shading;
+    if ( begin_image() == false )
+        return RTF_FAILURE;
 
-    if( shading.size() > 0 )
-        shading.clear();
+    std::string      key;
+    RTF_IMAGEFILE_ID fileid;
+    bool             identified = false;
+    bool             indexed = false;
 
-    if ( cell == false )
+    // Unchanged file is taken from cache without reading it
+    if ( rtfImageCache != NULL )
     {
-        switch (shading_type)
+        identified = RtfImageCache::get_fileid( image, &fileid );
+
+        if ( identified == true )
         {
-            // Fill shading
-            case RTF_PARAGRAPHSHADINGTYPE_FILL:
-                break;
+            indexed = rtfImageCache->find_file( image, fileid, key );
 
-            // Horizontal background pattern
-            case RTF_PARAGRAPHSHADINGTYPE_HORIZ:
-                shading = "\\bghoriz";
-                break;
+            if ( indexed == true )
+            {
+                RtfImageBlob blob = rtfImageCache->find( get_picturekey( key, width, height ) );
 
-            // Vertical background pattern
-            case RTF_PARAGRAPHSHADINGTYPE_VERT:
-                shading = "\\bgvert";
-                break;
+                if ( blob != NULL )
+                    return write_picture( blob );
+            }
+        }
+    }
 
-            // Forward diagonal background pattern
-            case RTF_PARAGRAPHSHADINGTYPE_FDIAG:
-                shading = "\\bgfdiag";
-                break;
+    RtfMappedFile  map;
+    unsigned char* buffer = NULL;
+    size_t         size = 0;
+    const unsigned char* data = NULL;
 
-            // Backward diagonal background pattern
-            case RTF_PARAGRAPHSHADINGTYPE_BDIAG:
-                shading = "\\bgbdiag";
-                break;
+    if ( mapped == true )
+    {
+        if ( map.open( image ) == true )
+        {
+            data = map.data();
+            size = map.size();
+        }
+    }
+    else
+    {
+        // Read image file
+        buffer = read_file( image, &size );
+        data   = buffer;
+    }
 
-            // Cross background pattern
-            case RTF_PARAGRAPHSHADINGTYPE_CROSS:
-                shading = "\\bgcross";
-                break;
+    if ( data == NULL )
+        return RTF_IMAGE_ERROR;
 
-            // Diagonal cross background pattern
-            case RTF_PARAGRAPHSHADINGTYPE_CROSSD:
-                shading = "\\bgdcross";
-                break;
+    // Same content may be cached from another file
+    if ( ( rtfImageCache != NULL ) && ( indexed == false ) )
+        key = RtfImageCache::get_contentkey( data, size );
 
-            // Dark horizontal background pattern
-            case RTF_PARAGRAPHSHADINGTYPE_DHORIZ:
-                shading = "\\bgdkhoriz";
-                break;
+    RTF_ERROR_TYPE error = write_image( data, size, width, height, key, indexed );
 
-            // Dark vertical background pattern
-            case RTF_PARAGRAPHSHADINGTYPE_DVERT:
-                shading = "\\bgdkvert";
-                break;
+    // File is indexed once its picture is cached under its own content
+    if ( ( identified == true ) && ( indexed == false ) &&
+         ( error == RTF_SUCCESS ) && ( key.empty() == false ) )
+        rtfImageCache->insert_file( image, fileid, key );
 
-            // Dark forward diagonal background pattern
-            case RTF_PARAGRAPHSHADINGTYPE_DFDIAG:
-                shading = "\\bgdkfdiag";
-                break;
+    if ( buffer != NULL )
+        free( buffer );
 
-            // Dark backward diagonal background pattern
-            case RTF_PARAGRAPHSHADINGTYPE_DBDIAG:
-                shading = "\\bgdkbdiag";
-                break;
+    // Return error flag
+    return error;
+}
 
-            // Dark cross background pattern
-            case RTF_PARAGRAPHSHADINGTYPE_DCROSS:
-                shading = "\\bgdkcross";
-                break;
+// Loads image from file
+RTF_ERROR_TYPE librtf::RtfDocument::load_image( const char* image, int width, int height )
+{
+    return load_imagefile( image, width, height, false );
+}
 
-            // Dark diagonal cross background pattern
-            case RTF_PARAGRAPHSHADINGTYPE_DCROSSD:
-                shading = "\\bgdkdcross";
-                break;
-        }
+// Loads image from memory mapped file
+RTF_ERROR_TYPE librtf::RtfDocument::load_mappedimage( const char* image, int width, int height )
+{
+    return load_imagefile( image, width, height, true );
+}
+
+// Loads image from memory
+RTF_ERROR_TYPE librtf::RtfDocument::load_image( const unsigned char* data, size_t size,
+                                                int width, int height )
+{
+    if ( begin_image() == false )
+        return RTF_FAILURE;
+
+    if ( ( data == NULL ) || ( size == 0 ) )
+        return RTF_IMAGE_ERROR;
+
+    std::string key;
+
+    return write_image( data, size, width, height, key, false );
+}
+
+// Loads image from memory span
+RTF_ERROR_TYPE librtf::RtfDocument::load_image( RtfByteSpan image, int width, int height )
+{
+    return load_image( image.data(), image.size(), width, height );
+}
+
+#ifdef _WIN32
+// Loads image with OLE and puts it as metafile
+RTF_ERROR_TYPE librtf::RtfDocument::put_oleimage( RtfBuffer& out,
+                                                  const unsigned char* data, size_t nSize,
+                                                  int width, int height )
+{
+    // Set error flag
+    RTF_ERROR_TYPE error = RTF_IMAGE_ERROR;
+
+    IPicture* picture = NULL;
+
+    // Alocate memory for image data
+    HGLOBAL hGlobal = GlobalAlloc(GMEM_MOVEABLE, nSize);
+    void* pData = GlobalLock(hGlobal);
+    memcpy(pData, data, nSize);
+    GlobalUnlock(hGlobal);
+
+    // Load image using OLE
+    IStream* pStream = NULL;
+
+    if ( CreateStreamOnHGlobal(hGlobal, TRUE, &pStream) == S_OK )
+    {
+        HRESULT hr;
+
+        if ((hr = OleLoadPicture( pStream, nSize, FALSE, IID_IPicture, (LPVOID *)&picture)) != S_OK)
+            error = RTF_IMAGE_ERROR;
+
+        pStream->Release();
     }
-    else
+
+    rtfPicture = picture;
+
+    // If image is loaded
+    if ( picture != NULL )
     {
-        switch (shading_type)
+        // Calculate image size
+        long hmWidth = 0;
+        long hmHeight = 0;
+        picture->get_Width(&hmWidth);
+        picture->get_Height(&hmHeight);
+        int nWidth  = MulDiv( hmWidth, GetDeviceCaps(GetDC(NULL),LOGPIXELSX), 2540 );
+        int nHeight = MulDiv( hmHeight, GetDeviceCaps(GetDC(NULL),LOGPIXELSY), 2540 );
+
+        // Create metafile;
+        HDC hdcMeta = CreateMetaFile(NULL);
+
+        // Render picture to metafile
+        picture->Render( hdcMeta, 0, 0, nWidth, nHeight, 0, hmHeight, hmWidth, -hmHeight, NULL );
+
+        // Close metafile
+        HMETAFILE hmf = CloseMetaFile(hdcMeta);
+
+        // Get metafile data
+        UINT size = GetMetaFileBitsEx( hmf, 0, NULL );
+
+        if ( is_picturesize( size, rtfBinaryImages ) == false )
         {
-            // Fill shading
-            case RTF_CELLSHADINGTYPE_FILL:
-                break;
+            DeleteMetaFile(hmf);
+            return RTF_IMAGE_ERROR;
+        }
 
-            // Horizontal background pattern
-            case RTF_CELLSHADINGTYPE_HORIZ:
-                shading = "\\clbghoriz";
-                break;
+        BYTE* buffer = new BYTE[size];
+        GetMetaFileBitsEx( hmf, size, buffer );
+        DeleteMetaFile(hmf);
 
-            // Vertical background pattern
-            case RTF_CELLSHADINGTYPE_VERT:
-                shading = "\\clbgvert";
-                break;
+        // Writes RTF picture data
+        char rtfText[128] = {0};
+        snprintf( rtfText, 128,
+                  "\n{\\pict\\wmetafile8\\picwgoal%d\\pichgoal%d\\picscalex%d\\picscaley%d\n",
+                  hmWidth, hmHeight, width, height );
 
-            // Forward diagonal background pattern
-            case RTF_CELLSHADINGTYPE_FDIAG:
-                shading = "\\clbgfdiag";
-                break;
+        out.put( rtfText );
 
-            // Backward diagonal background pattern
-            case RTF_CELLSHADINGTYPE_BDIAG:
-                shading = "\\clbgbdiag";
-                break;
+        // Writes metafile binary data
+        put_picturedata( out, buffer, size, rtfBinaryImages );
+        delete []buffer;
 
-            // Cross background pattern
-            case RTF_CELLSHADINGTYPE_CROSS:
-                shading = "\\clbgcross";
-                break;
+        out.put_char( '}' );
 
-            // Diagonal cross background pattern
-            case RTF_CELLSHADINGTYPE_CROSSD:
-                shading = "\\clbgdcross";
-                break;
+        error = RTF_SUCCESS;
+    }
 
-            // Dark horizontal background pattern
-            case RTF_CELLSHADINGTYPE_DHORIZ:
-                shading = "\\clbgdkhoriz";
-                break;
+    // Return error flag
+    return error;
+}
+#endif /// of _WIN32
 
-            // Dark vertical background pattern
-            case RTF_CELLSHADINGTYPE_DVERT:
-                shading = "\\clbgdkvert";
-                break;
+// Converts binary data to hex
+char* librtf::bin_hex_convert( const unsigned char* binary, size_t size )
+{
+    if ( (binary == NULL ) || ( size == 0 ) )
+        return NULL;
 
-            // Dark forward diagonal background pattern
-            case RTF_CELLSHADINGTYPE_DFDIAG:
-                shading = "\\clbgdkfdiag";
-                break;
+    size_t actualsize = (2 * size) + 1;
+    char* result = new char[ actualsize ];
 
-            // Dark backward diagonal background pattern
-            case RTF_CELLSHADINGTYPE_DBDIAG:
-                shading = "\\clbgdkbdiag";
-                break;
+    if ( result == NULL )
+        return NULL;
 
-            // Dark cross background pattern
-            case RTF_CELLSHADINGTYPE_DCROSS:
-                shading = "\\clbgdkcross";
-                break;
+    hex_encode( result, binary, size );
+    result[ 2 * size ] = 0;
 
-            // Dark diagonal cross background pattern
-            case RTF_CELLSHADINGTYPE_DCROSSD:
-                shading = "\\clbgdkdcross";
-                break;
-        }
-    }
+    return result;
+}
+
+
+// Puts RTF table row definition
+static void put_tablerowformat( librtf::RtfBuffer& out, const RTF_TABLEROW_FORMAT& rf )
+{
+    out.put( "\n\\trowd\\trgaph115" );
 
-    return shading.c_str();
+    // Format table row aligment
+    switch ( rf.rowAligment )
+    {
+        // Left align
+        case RTF_ROWTEXTALIGN_LEFT:
+            out.put( "\\trql" );
+            break;
+
+        // Center align
+        case RTF_ROWTEXTALIGN_CENTER:
+            out.put( "\\trqc" );
+            break;
+
+        // Right align
+        case RTF_ROWTEXTALIGN_RIGHT:
+            out.put( "\\trqr" );
+            break;
+    }
+
+    out.put( "\\trleft" );
+    out.put_int( rf.rowLeftMargin );
+    out.put( "\\trrh" );
+    out.put_int( rf.rowHeight );
+    out.put( "\\trpaddb" );
+    out.put_int( rf.marginTop );
+    out.put( "\\trpaddfb3\\trpaddl" );
+    out.put_int( rf.marginBottom );
+    out.put( "\\trpaddfl3\\trpaddr" );
+    out.put_int( rf.marginLeft );
+    out.put( "\\trpaddfr3\\trpaddt" );
+    out.put_int( rf.marginRight );
+    out.put( "\\trpaddft3" );
+}
+
+// Starts new RTF table row
+RTF_ERROR_TYPE librtf::RtfDocument::start_tablerow()
+{
+    if ( rtfSink == NULL )
+        return RTF_FAILURE;
+
+    // Writes RTF table data
+    put_tablerowformat( rtfOut, rtfRowFormat );
+    rtfRowCells.clear();
+    rtfRowTemplated = false;
+
+    if ( end_fragment() == false )
+        return RTF_TABLE_ERROR;
+
+    return RTF_SUCCESS;
+}
+
+
+// Starts new RTF table row with frozen row definition
+RTF_ERROR_TYPE librtf::RtfDocument::start_tablerow( const RtfRowTemplate& row )
+{
+    if ( rtfSink == NULL )
+        return RTF_FAILURE;
+
+    rtfOut.put( row.data(), row.size() );
+    rtfRowCells.clear();
+
+    // Kept for freeze_tablerow(), copy reuses string capacity
+    rtfRowStart = row;
+    rtfRowTemplated = true;
+
+    if ( end_fragment() == false )
+        return RTF_TABLE_ERROR;
+
+    return RTF_SUCCESS;
+}
+
+// Ends RTF table row
+RTF_ERROR_TYPE librtf::RtfDocument::end_tablerow()
+{
+    // Set error flag
+    RTF_ERROR_TYPE error = RTF_SUCCESS;
+
+    // Writes RTF table data
+    char rtfText[] = "\n\\trgaph115\\row\\pard";
+
+    // \pard drops paragraph state for delta formatting
+    rtfLastValid = false;
+
+    if ( rtfSink != NULL )
+    {
+        if ( write_out( rtfText, sizeof(rtfText) - 1 ) == false )
+            error = RTF_TABLE_ERROR;
+    }
+    else
+    {
+        error = RTF_FAILURE;
+    }
+
+    // Return error flag
+    return error;
+}
+
+
+// Puts RTF table cell border
+static void put_tablecellborder( librtf::RtfBuffer& out, const char* kind,
+                                 const RTF_TABLEBORDER_FORMAT& bf )
+{
+    if ( bf.border == true )
+    {
+        out.put( kind );
+        put_controlword( out, borderNames, RTF_WORDCOUNT( borderNames ),
+                         bf.BORDERS.borderType );
+        out.put( "\\brdrw" );
+        out.put_int( bf.BORDERS.borderWidth );
+        out.put( "\\brsp" );
+        out.put_int( bf.BORDERS.borderSpace );
+        out.put( "\\brdrcf" );
+        out.put_int( bf.BORDERS.borderColor );
+    }
+}
+
+// Puts RTF table cell definition
+static void put_tablecellformat( librtf::RtfBuffer& out, const RTF_TABLECELL_FORMAT& cf,
+                                 int rightMargin )
+{
+    out.put( "\n\\tcelld" );
+
+    // Format table cell text aligment
+    switch ( cf.textVerticalAligment )
+    {
+        // Top align
+        case RTF_CELLTEXTALIGN_TOP:
+            out.put( "\\clvertalt" );
+            break;
+
+        // Center align
+        case RTF_CELLTEXTALIGN_CENTER:
+            out.put( "\\clvertalc" );
+            break;
+
+        // Bottom align
+        case RTF_CELLTEXTALIGN_BOTTOM:
+            out.put( "\\clvertalb" );
+            break;
+    }
+
+    // Format table cell text direction
+    switch ( cf.textDirection )
+    {
+        // Left to right, top to bottom
+        case RTF_CELLTEXTDIRECTION_LRTB:
+            out.put( "\\cltxlrtb" );
+            break;
+
+        // Right to left, top to bottom
+        case RTF_CELLTEXTDIRECTION_RLTB:
+            out.put( "\\cltxtbrl" );
+            break;
+
+        // Left to right, bottom to top
+        case RTF_CELLTEXTDIRECTION_LRBT:
+            out.put( "\\cltxbtlr" );
+            break;
+
+        // Left to right, top to bottom, vertical
+        case RTF_CELLTEXTDIRECTION_LRTBV:
+            out.put( "\\cltxlrtbv" );
+            break;
+
+        // Right to left, top to bottom, vertical
+        case RTF_CELLTEXTDIRECTION_RLTBV:
+            out.put( "\\cltxtbrlv" );
+            break;
+    }
+
+    // Format table cell border
+    put_tablecellborder( out, "\\clbrdrb", cf.borderBottom );
+    put_tablecellborder( out, "\\clbrdrl", cf.borderLeft );
+    put_tablecellborder( out, "\\clbrdrr", cf.borderRight );
+    put_tablecellborder( out, "\\clbrdrt", cf.borderTop );
+
+    // Format table cell shading
+    if ( cf.cellShading == true )
+    {
+        // Set cell shading pattern and color
+        put_controlword( out, cellShadingNames, RTF_WORDCOUNT( cellShadingNames ),
+                         cf.SHADING.shadingType );
+        out.put( "\\clshdgn" );
+        out.put_int( cf.SHADING.shadingIntensity );
+        out.put( "\\clcfpat" );
+        out.put_int( cf.SHADING.shadingFillColor );
+        out.put( "\\clcbpat" );
+        out.put_int( cf.SHADING.shadingBkColor );
+    }
+
+    out.put( "\\cellx" );
+    out.put_int( rightMargin );
+}
+
+// Starts new RTF table cell
+RTF_ERROR_TYPE librtf::RtfDocument::start_tablecell( int rightMargin )
+{
+    if ( rtfSink == NULL )
+        return RTF_FAILURE;
+
+    // Writes RTF table data
+    put_tablecellformat( rtfOut, rtfCellFormat, rightMargin );
+
+    // Kept for freeze_tablerow()
+    RtfRowCell cell;
+
+    cell.rightMargin = rightMargin;
+    memcpy( &cell.format, &rtfCellFormat, sizeof(RTF_TABLECELL_FORMAT) );
+    rtfRowCells.push_back( cell );
+
+    if ( end_fragment() == false )
+        return RTF_TABLE_ERROR;
+
+    return RTF_SUCCESS;
+}
+
+// Ends RTF table cell
+RTF_ERROR_TYPE librtf::RtfDocument::end_tablecell()
+{
+    // Set error flag
+    RTF_ERROR_TYPE error = RTF_SUCCESS;
+
+    // Writes RTF table data
+    char rtfText[] = "\n\\cell ";
+
+    if ( rtfSink != NULL )
+    {
+        if ( write_out( rtfText, sizeof(rtfText) - 1 ) == false )
+            error = RTF_TABLE_ERROR;
+    }
+    else
+    {
+        error = RTF_FAILURE;
+    }
+
+    // Return error flag
+    return error;
+}
+
+
+// Freezes current table row definition
+librtf::RtfRowTemplate librtf::RtfDocument::freeze_tablerow() const
+{
+    RtfRowTemplate row( &rtfRowFormat );
+
+    if ( rtfRowTemplated == true )
+        row = rtfRowStart;
+
+    for ( size_t cnt=0; cnt<rtfRowCells.size(); cnt++ )
+        row.add_cell( rtfRowCells[cnt].rightMargin, &rtfRowCells[cnt].format );
+
+    return row;
+}
+
+// Gets RTF table row formatting properties
+RTF_TABLEROW_FORMAT* librtf::RtfDocument::get_tablerowformat()
+{
+    // Get current RTF table row formatting properties
+    return &rtfRowFormat;
+}
+
+
+// Sets RTF table row formatting properties
+void librtf::RtfDocument::set_tablerowformat(RTF_TABLEROW_FORMAT* rf)
+{
+    // Set new RTF table row formatting properties
+    if ( rf != NULL )
+        memcpy( &rtfRowFormat, rf, sizeof(RTF_TABLEROW_FORMAT) );
+}
+
+
+// Gets RTF table cell formatting properties
+RTF_TABLECELL_FORMAT* librtf::RtfDocument::get_tablecellformat()
+{
+    // Get current RTF table cell formatting properties
+    return &rtfCellFormat;
+}
+
+
+// Sets RTF table cell formatting properties
+void librtf::RtfDocument::set_tablecellformat(RTF_TABLECELL_FORMAT* cf)
+{
+    // Set new RTF table cell formatting properties
+    if ( cf != NULL )
+        memcpy( &rtfCellFormat, cf, sizeof(RTF_TABLECELL_FORMAT) );
+}
+
+// Freezes table row definition
+librtf::RtfRowTemplate::RtfRowTemplate( const RTF_TABLEROW_FORMAT* rf )
+ : cells( 0 )
+{
+    RTF_TABLEROW_FORMAT row;
+
+    memset( &row, 0, sizeof(RTF_TABLEROW_FORMAT) );
+
+    if ( rf != NULL )
+        memcpy( &row, rf, sizeof(RTF_TABLEROW_FORMAT) );
+
+    RtfBuffer out( 256 );
+
+    put_tablerowformat( out, row );
+    definition.assign( out.data(), out.size() );
+}
+
+// Adds cell definition to frozen table row
+int librtf::RtfRowTemplate::add_cell( int rightMargin, const RTF_TABLECELL_FORMAT* cf )
+{
+    if ( cf == NULL )
+        return -1;
+
+    RtfBuffer out( 256 );
+
+    put_tablecellformat( out, *cf, rightMargin );
+    definition.append( out.data(), out.size() );
+
+    return (int)cells++;
+}
+
+// Creates table schema with row format
+librtf::RtfTableSchema::RtfTableSchema( const RTF_TABLEROW_FORMAT* rf )
+ : row( rf ),
+   rightMargin( 0 )
+{
+    if ( rf != NULL )
+        rightMargin = rf->rowLeftMargin;
+}
+
+// Adds table column, cell right margin is sum of column widths
+int librtf::RtfTableSchema::add_column( int width, const RTF_TABLECELL_FORMAT* cf,
+                                        const RTF_PARAGRAPH_FORMAT* pf )
+{
+    if ( ( cf == NULL ) || ( pf == NULL ) || ( width <= 0 ) )
+        return -1;
+
+    rightMargin += width;
+    row.add_cell( rightMargin, cf );
+
+    // Cell paragraphs are always table text
+    RTF_PARAGRAPH_FORMAT cellpf;
+
+    memcpy( &cellpf, pf, sizeof(RTF_PARAGRAPH_FORMAT) );
+    cellpf.tableText = true;
+
+    paragraphs.push_back( RtfParagraphHandle( &cellpf ) );
+
+    return (int)paragraphs.size() - 1;
+}
+
+// Puts RTF table cell paragraph and cell end
+void librtf::RtfDocument::put_tablecell( const RtfParagraphHandle& handle,
+                                         const char* text, size_t length )
+{
+    static const char cellEnd[] = "\n\\cell ";
+
+    // Empty cell has no paragraph, as start_paragraph( NULL ). Handle
+    // paragraph keeps delta formatting state in step.
+    if ( text != NULL )
+    {
+        put_handleparagraph( handle, false );
+        put_text( text, length );
+    }
+
+    rtfOut.put( cellEnd, sizeof(cellEnd) - 1 );
+}
+
+// Writes RTF table cell with precompiled format
+RTF_ERROR_TYPE librtf::RtfDocument::write_tablecell( const RtfParagraphHandle& handle,
+                                                     const char* text, size_t length )
+{
+    if ( rtfSink == NULL )
+        return RTF_FAILURE;
+
+    put_tablecell( handle, text, length );
+
+    if ( end_fragment() == false )
+        return RTF_TABLE_ERROR;
+
+    return RTF_SUCCESS;
+}
+
+// Writes RTF table cell of number text with precompiled format
+RTF_ERROR_TYPE librtf::RtfDocument::write_numbercell( const RtfParagraphHandle& handle,
+                                                      const char* text, size_t length )
+{
+    static const char cellEnd[] = "\n\\cell ";
+
+    if ( text == NULL )
+        return write_tablecell( handle, NULL, 0 );
+
+    if ( rtfSink == NULL )
+        return RTF_FAILURE;
+
+    put_handleparagraph( handle, false );
+
+    if ( is_decimaltabbed( handle.format() ) == true )
+        rtfOut.put( "\\tab " );
+
+    put_text( text, length );
+    rtfOut.put( cellEnd, sizeof(cellEnd) - 1 );
+
+    if ( end_fragment() == false )
+        return RTF_TABLE_ERROR;
+
+    return RTF_SUCCESS;
+}
+
+// Writes whole RTF table
+RTF_ERROR_TYPE librtf::RtfDocument::write_table( const RtfTableSchema& schema,
+                                                 const RTF_TEXTSPAN* cells, size_t rows,
+                                                 int layout )
+{
+    if ( rtfSink == NULL )
+        return RTF_FAILURE;
+
+    size_t columns = schema.get_columns();
+
+    if ( columns == 0 )
+        return RTF_TABLE_ERROR;
+
+    if ( ( cells == NULL ) && ( rows > 0 ) )
+        return RTF_ERROR;
+
+    // Cell [row, col] is at row * rowstep + col * colstep
+    size_t rowstep = columns;
+    size_t colstep = 1;
+
+    if ( layout == RTF_TABLELAYOUT_COLUMNS )
+    {
+        rowstep = 1;
+        colstep = rows;
+    }
+
+    const RtfRowTemplate& def = schema.get_row();
+    static const char rowEnd[] = "\n\\trgaph115\\row\\pard";
+
+    for ( size_t row=0; row<rows; row++ )
+    {
+        rtfOut.put( def.data(), def.size() );
+
+        const RTF_TEXTSPAN* cell = cells + row * rowstep;
+
+        for ( size_t col=0; col<columns; col++, cell+=colstep )
+            put_tablecell( schema.get_paragraph( col ), cell->text, cell->length );
+
+        rtfOut.put( rowEnd, sizeof(rowEnd) - 1 );
+
+        // \pard drops paragraph state for delta formatting
+        rtfLastValid = false;
+
+        if ( end_fragment() == false )
+            return RTF_TABLE_ERROR;
+    }
+
+    return RTF_SUCCESS;
+}
+
+// Creates streaming table writer
+librtf::RtfTableWriter::RtfTableWriter( RtfDocument* doc, const RtfTableSchema* sch )
+ : document( doc ),
+   schema( sch ),
+   column( 0 ),
+   rows( 0 )
+{
+}
+
+// Writes next table cell
+RTF_ERROR_TYPE librtf::RtfTableWriter::write_cell( const char* text )
+{
+    return write_cell( text, ( text != NULL ) ? strlen( text ) : 0 );
+}
+
+// Starts table row at first cell, checks next cell is in schema
+RTF_ERROR_TYPE librtf::RtfTableWriter::begin_cell()
+{
+    if ( ( document == NULL ) || ( schema == NULL ) )
+        return RTF_FAILURE;
+
+    if ( column >= schema->get_columns() )
+        return RTF_TABLE_ERROR;
+
+    if ( column == 0 )
+        return document->start_tablerow( schema->get_row() );
+
+    return RTF_SUCCESS;
+}
+
+// Writes next table cell of given length
+RTF_ERROR_TYPE librtf::RtfTableWriter::write_cell( const char* text, size_t length )
+{
+    RTF_ERROR_TYPE error = begin_cell();
+
+    if ( error != RTF_SUCCESS )
+        return error;
+
+    error = document->write_tablecell( schema->get_paragraph( column ), text, length );
+    column++;
+
+    return error;
+}
+
+// Writes next table cell of number text
+RTF_ERROR_TYPE librtf::RtfTableWriter::write_number( const char* text, size_t length )
+{
+    RTF_ERROR_TYPE error = begin_cell();
+
+    if ( error != RTF_SUCCESS )
+        return error;
+
+    error = document->write_numbercell( schema->get_paragraph( column ), text, length );
+    column++;
+
+    return error;
+}
+
+// Writes next table cell of integer
+RTF_ERROR_TYPE librtf::RtfTableWriter::write_integer( long long value, const RTF_NUMBER_FORMAT* nf )
+{
+    char   text[RTF_NUMBER_BUFFERSIZE];
+    size_t length = format_integer( text, value, nf );
+
+    return write_number( text, length );
+}
+
+// Writes next table cell of fixed-point number
+RTF_ERROR_TYPE librtf::RtfTableWriter::write_fixed( long long value, int scale,
+                                                    const RTF_NUMBER_FORMAT* nf )
+{
+    char   text[RTF_NUMBER_BUFFERSIZE];
+    size_t length = format_fixed( text, value, scale, nf );
+
+    return write_number( text, length );
+}
+
+// Writes next table cell of double
+RTF_ERROR_TYPE librtf::RtfTableWriter::write_double( double value, const RTF_NUMBER_FORMAT* nf )
+{
+    char   text[RTF_NUMBER_BUFFERSIZE];
+    size_t length = format_double( text, value, nf );
+
+    return write_number( text, length );
+}
+
+// Ends table row, missing cells are written empty
+RTF_ERROR_TYPE librtf::RtfTableWriter::end_row()
+{
+    if ( ( document == NULL ) || ( schema == NULL ) )
+        return RTF_FAILURE;
+
+    if ( column == 0 )
+        return RTF_TABLE_ERROR;
+
+    while ( column < schema->get_columns() )
+    {
+        RTF_ERROR_TYPE error = write_cell( NULL, 0 );
+
+        if ( error != RTF_SUCCESS )
+            return error;
+    }
+
+    column = 0;
+    rows++;
+
+    return document->end_tablerow();
+}
+
+// Writes whole table row
+RTF_ERROR_TYPE librtf::RtfTableWriter::write_row( const RTF_TEXTSPAN* cells )
+{
+    if ( ( document == NULL ) || ( schema == NULL ) )
+        return RTF_FAILURE;
+
+    if ( column != 0 )
+        return RTF_TABLE_ERROR;
+
+    RTF_ERROR_TYPE error = document->write_table( *schema, cells, 1 );
+
+    if ( error == RTF_SUCCESS )
+        rows++;
+
+    return error;
+}
+
+// Gets largest number of output bytes buffered at once
+size_t librtf::RtfTableWriter::get_highwater() const
+{
+    if ( document == NULL )
+        return 0;
+
+    return document->get_highwater();
+}
+
+// Gets border name
+const char* librtf::get_bordername(int border_type)
+{
+    return get_controlword( borderNames, RTF_WORDCOUNT( borderNames ), border_type ).text;
+}
+
+// Gets shading name
+const char* librtf::get_shadingname( int shading_type, bool cell )
+{
+    if ( cell == false )
+        return get_controlword( paragraphShadingNames, RTF_WORDCOUNT( paragraphShadingNames ),
+                                shading_type ).text;
+
+    return get_controlword( cellShadingNames, RTF_WORDCOUNT( cellShadingNames ),
+                            shading_type ).text;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Default RTF document wrappers
+
+// Gets default RTF document
+librtf::RtfDocument* librtf::get_defaultdocument()
+{
+    return &rtfDocument;
+}
+
+// Creates new RTF document
+RTF_ERROR_TYPE librtf::open( const char* filename, const char* fonts, const char* colors,
+                             RTF_DOCUMENT_FORMAT* fmt )
+{
+    return rtfDocument.open( filename, fonts, colors, fmt );
+}
+
+// Creates new RTF document written to sink
+RTF_ERROR_TYPE librtf::open( RtfSink* sink, const char* fonts, const char* colors,
+                             RTF_DOCUMENT_FORMAT* fmt )
+{
+    return rtfDocument.open( sink, fonts, colors, fmt );
+}
+
+// Closes created RTF document
+RTF_ERROR_TYPE librtf::close()
+{
+    return rtfDocument.close();
+}
+
+// Writes RTF document header
+bool librtf::write_header()
+{
+    return rtfDocument.write_header();
+}
+
+// Sets global RTF library params
+void librtf::init()
+{
+    rtfDocument.init();
+}
+
+// Sets new RTF document font table
+void librtf::set_fonttable( const char* fonts )
+{
+    rtfDocument.set_fonttable( fonts );
+}
+
+// Sets new RTF document color table
+void librtf::set_colortable( const char* colors )
+{
+    rtfDocument.set_colortable( colors );
+}
+
+// Gets RTF document formatting properties
+RTF_DOCUMENT_FORMAT* librtf::get_documentformat()
+{
+    return rtfDocument.get_documentformat();
+}
+
+// Sets RTF document formatting properties
+void librtf::set_documentformat( RTF_DOCUMENT_FORMAT* df )
+{
+    rtfDocument.set_documentformat( df );
+}
+
+// Writes RTF document formatting properties
+bool librtf::write_documentformat()
+{
+    return rtfDocument.write_documentformat();
+}
+
+// Gets RTF section formatting properties
+RTF_SECTION_FORMAT* librtf::get_sectionformat()
+{
+    return rtfDocument.get_sectionformat();
+}
+
+// Sets RTF section formatting properties
+void librtf::set_sectionformat( RTF_SECTION_FORMAT* sf )
+{
+    rtfDocument.set_sectionformat( sf );
+}
+
+// Writes RTF section formatting properties
+bool librtf::write_sectionformat()
+{
+    return rtfDocument.write_sectionformat();
+}
+
+// Starts new RTF section
+RTF_ERROR_TYPE librtf::start_section()
+{
+    return rtfDocument.start_section();
+}
+
+// Gets RTF paragraph formatting properties
+RTF_PARAGRAPH_FORMAT* librtf::get_paragraphformat()
+{
+    return rtfDocument.get_paragraphformat();
+}
+
+// Sets RTF paragraph formatting properties
+void librtf::set_paragraphformat( RTF_PARAGRAPH_FORMAT* pf )
+{
+    rtfDocument.set_paragraphformat( pf );
+}
+
+// Writes RTF paragraph formatting properties
+bool librtf::write_paragraphformat()
+{
+    return rtfDocument.write_paragraphformat();
+}
+
+// Starts new RTF paragraph
+RTF_ERROR_TYPE librtf::start_paragraph( const char* text, bool newPar )
+{
+    return rtfDocument.start_paragraph( text, newPar );
+}
+
+// Loads image from file
+RTF_ERROR_TYPE librtf::load_image( const char* image, int width, int height )
+{
+    return rtfDocument.load_image( image, width, height );
+}
+
+// Sets default RTF document formatting
+void librtf::set_defaultformat()
+{
+    rtfDocument.set_defaultformat();
+}
+
+// Starts new RTF table row
+RTF_ERROR_TYPE librtf::start_tablerow()
+{
+    return rtfDocument.start_tablerow();
+}
+
+// Ends RTF table row
+RTF_ERROR_TYPE librtf::end_tablerow()
+{
+    return rtfDocument.end_tablerow();
+}
+
+// Starts new RTF table cell
+RTF_ERROR_TYPE librtf::start_tablecell( int rightMargin )
+{
+    return rtfDocument.start_tablecell( rightMargin );
+}
+
+// Ends RTF table cell
+RTF_ERROR_TYPE librtf::end_tablecell()
+{
+    return rtfDocument.end_tablecell();
+}
+
+// Gets RTF table row formatting properties
+RTF_TABLEROW_FORMAT* librtf::get_tablerowformat()
+{
+    return rtfDocument.get_tablerowformat();
+}
+
+// Sets RTF table row formatting properties
+void librtf::set_tablerowformat( RTF_TABLEROW_FORMAT* rf )
+{
+    rtfDocument.set_tablerowformat( rf );
+}
+
+// Gets RTF table cell formatting properties
+RTF_TABLECELL_FORMAT* librtf::get_tablecellformat()
+{
+    return rtfDocument.get_tablecellformat();
+}
+
+// Sets RTF table cell formatting properties
+void librtf::set_tablecellformat( RTF_TABLECELL_FORMAT* cf )
+{
+    rtfDocument.set_tablecellformat( cf );
 }
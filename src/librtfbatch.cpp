@@ -0,0 +1,300 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "librtfbatch.h"
+#include "librtfdocument.h"
+#include "librtfprologue.h"
+
+using namespace librtf;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Worker thread state, kept for all batches
+struct BatchWorker
+{
+    std::mutex      lock;       /// guards job range
+    size_t          next;       /// next job of range
+    size_t          end;        /// end of range, lowered by thieves
+    RtfDocument     doc;        /// reused by every job of worker
+};
+
+// Pool of workers and batch they are running
+struct librtf::RtfBatchPool
+{
+    std::vector<BatchWorker*>   workers;
+    std::vector<std::thread>    threads;
+    std::mutex                  lock;
+    std::condition_variable     wake;
+    std::condition_variable     finished;
+    unsigned long long          generation; /// batch number
+    int                         running;
+    bool                        quit;
+    std::mutex                  batchlock;  /// one batch at a time
+
+    size_t                      count;
+    RTF_BATCH_CALLBACK          callback;
+    RTF_SINK_FACTORY            factory;
+    RTF_SINK_RELEASE            release;
+    void*                       param;
+    const RtfPrologue*          prologue;
+    std::atomic<size_t>         failed;
+    std::atomic<size_t>         stolen;
+};
+
+// Takes next job of worker range
+static bool take_job( BatchWorker* worker, size_t& index )
+{
+    std::lock_guard<std::mutex> guard( worker->lock );
+
+    if ( worker->next >= worker->end )
+        return false;
+
+    index = worker->next++;
+
+    return true;
+}
+
+// Moves upper half of jobs left to another worker into worker range
+static bool steal_jobs( RtfBatchPool* pool, size_t self )
+{
+    size_t workers = pool->workers.size();
+
+    for ( size_t cnt=1; cnt<workers; cnt++ )
+    {
+        BatchWorker* victim = pool->workers[ ( self + cnt ) % workers ];
+        size_t       first = 0;
+        size_t       last = 0;
+
+        {
+            std::lock_guard<std::mutex> guard( victim->lock );
+
+            size_t left = victim->end - victim->next;
+
+            if ( left == 0 )
+                continue;
+
+            first = victim->end - ( left + 1 ) / 2;
+            last = victim->end;
+            victim->end = first;
+        }
+
+        BatchWorker* worker = pool->workers[self];
+
+        {
+            std::lock_guard<std::mutex> guard( worker->lock );
+
+            worker->next = first;
+            worker->end = last;
+        }
+
+        pool->stolen += last - first;
+
+        return true;
+    }
+
+    return false;
+}
+
+// Renders job into worker document, returns false on failure
+static bool render_job( RtfBatchPool* pool, BatchWorker* worker, size_t index )
+{
+    RtfSink* sink = pool->factory( index, pool->param );
+
+    if ( sink == NULL )
+        return false;
+
+    RTF_ERROR_TYPE error = RTF_SUCCESS;
+
+    if ( pool->prologue != NULL )
+        error = worker->doc.open( sink, *pool->prologue );
+    else
+        error = worker->doc.open( sink );
+
+    bool failed = ( error != RTF_SUCCESS );
+
+    if ( failed == false )
+    {
+        failed = ( pool->callback( &worker->doc, index, pool->param ) == false );
+
+        if ( worker->doc.close() != RTF_SUCCESS )
+            failed = true;
+    }
+
+    if ( pool->release != NULL )
+        pool->release( sink, index, failed, pool->param );
+    else
+        delete sink;
+
+    return ( failed == false );
+}
+
+// Worker thread, runs jobs of each batch until pool quits
+static void run_worker( RtfBatchPool* pool, size_t self )
+{
+    BatchWorker*       worker = pool->workers[self];
+    unsigned long long generation = 0;
+
+    for ( ;; )
+    {
+        {
+            std::unique_lock<std::mutex> guard( pool->lock );
+
+            while ( ( pool->quit == false ) && ( pool->generation == generation ) )
+                pool->wake.wait( guard );
+
+            if ( pool->quit == true )
+                return;
+
+            generation = pool->generation;
+        }
+
+        for ( ;; )
+        {
+            size_t index = 0;
+
+            if ( take_job( worker, index ) == false )
+            {
+                if ( steal_jobs( pool, self ) == false )
+                    break;
+
+                continue;
+            }
+
+            if ( render_job( pool, worker, index ) == false )
+                pool->failed++;
+        }
+
+        std::lock_guard<std::mutex> guard( pool->lock );
+
+        if ( --pool->running == 0 )
+            pool->finished.notify_all();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfBatchRenderer::RtfBatchRenderer( int count )
+ : threads( count ),
+   pool( NULL )
+{
+    if ( threads <= 0 )
+        threads = (int)std::thread::hardware_concurrency();
+
+    if ( threads <= 0 )
+        threads = 1;
+
+    pool = new RtfBatchPool;
+
+    pool->generation = 0;
+    pool->running    = 0;
+    pool->quit       = false;
+    pool->count      = 0;
+    pool->callback   = NULL;
+    pool->factory    = NULL;
+    pool->release    = NULL;
+    pool->param      = NULL;
+    pool->prologue   = NULL;
+    pool->failed     = 0;
+    pool->stolen     = 0;
+
+    for ( int cnt=0; cnt<threads; cnt++ )
+    {
+        BatchWorker* worker = new BatchWorker;
+
+        worker->next = 0;
+        worker->end  = 0;
+
+        pool->workers.push_back( worker );
+    }
+
+    for ( int cnt=0; cnt<threads; cnt++ )
+        pool->threads.push_back( std::thread( run_worker, pool, (size_t)cnt ) );
+}
+
+RtfBatchRenderer::~RtfBatchRenderer()
+{
+    {
+        std::lock_guard<std::mutex> guard( pool->lock );
+
+        pool->quit = true;
+        pool->wake.notify_all();
+    }
+
+    for ( size_t cnt=0; cnt<pool->threads.size(); cnt++ )
+        pool->threads[cnt].join();
+
+    for ( size_t cnt=0; cnt<pool->workers.size(); cnt++ )
+        delete pool->workers[cnt];
+
+    delete pool;
+}
+
+RTF_ERROR_TYPE RtfBatchRenderer::render_batch( size_t count, RTF_BATCH_CALLBACK cb,
+                                               RTF_SINK_FACTORY factory,
+                                               RTF_SINK_RELEASE release, void* param )
+{
+    if ( ( cb == NULL ) || ( factory == NULL ) )
+        return RTF_ERROR;
+
+    std::lock_guard<std::mutex> batchguard( pool->batchlock );
+
+    pool->count    = count;
+    pool->callback = cb;
+    pool->factory  = factory;
+    pool->release  = release;
+    pool->param    = param;
+    pool->failed   = 0;
+    pool->stolen   = 0;
+
+    if ( count == 0 )
+        return RTF_SUCCESS;
+
+    // Even ranges to begin with, stealing evens out slow jobs
+    size_t workers = pool->workers.size();
+
+    for ( size_t cnt=0; cnt<workers; cnt++ )
+    {
+        BatchWorker*                worker = pool->workers[cnt];
+        std::lock_guard<std::mutex> guard( worker->lock );
+
+        worker->next = count * cnt / workers;
+        worker->end  = count * ( cnt + 1 ) / workers;
+    }
+
+    std::unique_lock<std::mutex> guard( pool->lock );
+
+    pool->running = (int)workers;
+    pool->generation++;
+    pool->wake.notify_all();
+
+    while ( pool->running > 0 )
+        pool->finished.wait( guard );
+
+    if ( pool->failed > 0 )
+        return RTF_ERROR;
+
+    return RTF_SUCCESS;
+}
+
+void RtfBatchRenderer::set_prologue( const RtfPrologue* prologue )
+{
+    std::lock_guard<std::mutex> batchguard( pool->batchlock );
+
+    pool->prologue = prologue;
+}
+
+size_t RtfBatchRenderer::get_failed()
+{
+    return pool->failed;
+}
+
+size_t RtfBatchRenderer::get_stolen()
+{
+    return pool->stolen;
+}
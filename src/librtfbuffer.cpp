@@ -0,0 +1,172 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "librtfbuffer.h"
+
+using namespace librtf;
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfBuffer::RtfBuffer( size_t size )
+ : buffer( NULL ),
+   length( 0 ),
+   capacity( 0 ),
+   highwater( 0 ),
+   sink( NULL ),
+   failed( false )
+{
+    set_size( size );
+}
+
+RtfBuffer::~RtfBuffer()
+{
+    if ( buffer != NULL )
+        free( buffer );
+}
+
+void RtfBuffer::set_sink( RtfSink* s )
+{
+    // Keep high water of last sink readable after it is released
+    if ( s != NULL )
+        highwater = 0;
+
+    sink   = s;
+    length = 0;
+    failed = false;
+}
+
+bool RtfBuffer::set_size( size_t size )
+{
+    if ( flush() == false )
+        return false;
+
+    if ( size == capacity )
+        return true;
+
+    if ( size == 0 )
+    {
+        if ( buffer != NULL )
+        {
+            free( buffer );
+            buffer = NULL;
+        }
+
+        capacity = 0;
+        return true;
+    }
+
+    char* newbuff = (char*)realloc( buffer, size );
+
+    if ( newbuff == NULL )
+        return false;
+
+    buffer   = newbuff;
+    capacity = size;
+
+    return true;
+}
+
+bool RtfBuffer::flush()
+{
+    if ( ( sink != NULL ) && ( length > 0 ) )
+    {
+        if ( length > highwater )
+            highwater = length;
+
+        if ( sink->write( buffer, length ) == false )
+            failed = true;
+
+        length = 0;
+    }
+
+    return good();
+}
+
+void RtfBuffer::clear()
+{
+    if ( length > highwater )
+        highwater = length;
+
+    length = 0;
+    failed = false;
+}
+
+size_t RtfBuffer::reserve( char** dst, size_t size )
+{
+    if ( size > capacity - length )
+    {
+        if ( sink != NULL )
+        {
+            flush();
+        }
+        else
+        {
+            size_t newcap = ( capacity > 0 ) ? capacity * 2 : 256;
+
+            while ( newcap < length + size )
+                newcap *= 2;
+
+            char* newbuff = (char*)realloc( buffer, newcap );
+
+            if ( newbuff == NULL )
+            {
+                failed = true;
+                return 0;
+            }
+
+            buffer   = newbuff;
+            capacity = newcap;
+        }
+    }
+
+    *dst = buffer + length;
+
+    return capacity - length;
+}
+
+void RtfBuffer::overflow( const char* src, size_t srcsize )
+{
+    if ( sink != NULL )
+    {
+        // Small piece, flush buffer and keep collecting
+        if ( srcsize < capacity )
+        {
+            flush();
+            memcpy( buffer + length, src, srcsize );
+            length += srcsize;
+            return;
+        }
+
+        // Large piece, write buffer and piece in one go
+        if ( length > highwater )
+            highwater = length;
+
+        RTF_IOVEC iov[2] = { { buffer, length }, { src, srcsize } };
+
+        if ( sink->writev( iov, 2 ) == false )
+            failed = true;
+
+        length = 0;
+        return;
+    }
+
+    // No sink, grow buffer
+    size_t newcap = ( capacity > 0 ) ? capacity * 2 : 256;
+
+    while ( newcap < length + srcsize )
+        newcap *= 2;
+
+    char* newbuff = (char*)realloc( buffer, newcap );
+
+    if ( newbuff == NULL )
+    {
+        failed = true;
+        return;
+    }
+
+    buffer   = newbuff;
+    capacity = newcap;
+
+    memcpy( buffer + length, src, srcsize );
+    length += srcsize;
+}
@@ -0,0 +1,83 @@
+#ifndef __LIBRTFCPU_H__
+#define __LIBRTFCPU_H__
+
+// Internal CPU feature detection for SIMD code paths.
+// LIBRTF_X86 is defined where SSE2 intrinsics are available, functions
+// using newer instruction sets must be marked with LIBRTF_TARGET_*.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define LIBRTF_X86
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#endif
+
+#ifdef LIBRTF_X86
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define LIBRTF_TARGET_SSSE3 __attribute__((target("ssse3")))
+    #define LIBRTF_TARGET_AVX2  __attribute__((target("avx2")))
+#else
+    #define LIBRTF_TARGET_SSSE3
+    #define LIBRTF_TARGET_AVX2
+#endif
+
+// Gets lowest set bit index of a non zero mask
+static inline unsigned lowest_bit( unsigned mask )
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward( &idx, mask );
+    return (unsigned)idx;
+#else
+    return (unsigned)__builtin_ctz( mask );
+#endif
+}
+
+// Checks SSSE3 support of CPU
+static inline bool has_ssse3()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return ( __builtin_cpu_supports( "ssse3" ) != 0 );
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid( info, 1 );
+    return ( ( info[2] & ( 1 << 9 ) ) != 0 );
+#else
+    return false;
+#endif
+}
+
+// Checks AVX2 support of CPU and OS
+static inline bool has_avx2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return ( __builtin_cpu_supports( "avx2" ) != 0 );
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid( info, 0 );
+    if ( info[0] < 7 )
+        return false;
+
+    __cpuid( info, 1 );
+    // OSXSAVE and AVX
+    if ( ( info[2] & ( 1 << 27 ) ) == 0 || ( info[2] & ( 1 << 28 ) ) == 0 )
+        return false;
+
+    // OS saves YMM state
+    if ( ( _xgetbv( 0 ) & 6 ) != 6 )
+        return false;
+
+    __cpuidex( info, 7, 0 );
+    return ( ( info[1] & ( 1 << 5 ) ) != 0 );
+#else
+    return false;
+#endif
+}
+
+#endif /// of LIBRTF_X86
+
+#endif /// of __LIBRTFCPU_H__
@@ -0,0 +1,725 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include "librtfescape.h"
+#include "librtfcpu.h"
+
+using namespace librtf;
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const char hexdigits[] = "0123456789abcdef";
+
+// Non zero for bytes written other than as is
+static const unsigned char escapebytes[256] =
+{
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,    /// 0x00
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,    /// 0x10
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,    /// 0x20
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,    /// 0x30
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,    /// 0x40
+    0,0,0,0,0,0,0,0,0,0,0,0,1,0,0,0,    /// 0x50, '\'
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,    /// 0x60
+    0,0,0,0,0,0,0,0,0,0,0,1,0,1,0,0,    /// 0x70, '{' and '}'
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,    /// 0x80
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+};
+
+typedef void (*RTF_ESCAPE_FUNC)( RtfBuffer& out, const unsigned char* src, size_t size, bool utf8 );
+
+// Stages one escaped byte at dst, at most 6 chars. Returns end of
+// staged chars, used is set to bytes consumed.
+static inline char* stage_escapedbyte( char* dst, const unsigned char* src, size_t size,
+                                       size_t& used )
+{
+    unsigned char c = src[0];
+
+    used = 1;
+
+    switch( c )
+    {
+        case '\\':
+        case '{':
+        case '}':
+            *dst++ = '\\';
+            *dst++ = (char)c;
+            break;
+
+        case '\t':
+            memcpy( dst, "\\tab ", 5 );
+            dst += 5;
+            break;
+
+        case '\r':
+            // CR LF is one line break
+            if ( ( size > 1 ) && ( src[1] == '\n' ) )
+                used = 2;
+            memcpy( dst, "\\line ", 6 );
+            dst += 6;
+            break;
+
+        case '\n':
+            memcpy( dst, "\\line ", 6 );
+            dst += 6;
+            break;
+
+        default:
+            *dst++ = '\\';
+            *dst++ = '\'';
+            *dst++ = hexdigits[ c >> 4 ];
+            *dst++ = hexdigits[ c & 0x0F ];
+            break;
+    }
+
+    return dst;
+}
+
+// Writes one escaped byte, returns bytes consumed
+static inline size_t put_escapedbyte( RtfBuffer& out, const unsigned char* src, size_t size )
+{
+    char   tmp[8];
+    size_t used = 0;
+    char*  end = stage_escapedbyte( tmp, src, size, used );
+
+    out.put( tmp, end - tmp );
+
+    return used;
+}
+
+// Two digit decimal strings of 0 to 99
+static const char digitpairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static inline char* put_digitpair( char* dst, unsigned int value )
+{
+    *dst++ = digitpairs[ value * 2 ];
+    *dst++ = digitpairs[ value * 2 + 1 ];
+
+    return dst;
+}
+
+// Writes UTF-16 code unit as \uN?, N is signed 16 bit as RTF requires
+static inline char* put_unicode( char* dst, unsigned int unit )
+{
+    int          value = (short)unit;
+    unsigned int uv = ( value < 0 ) ? 0u - (unsigned int)value : (unsigned int)value;
+
+    // Sign is written always and kept for negative values, CJK text
+    // mixes both
+    dst[0] = '\\';
+    dst[1] = 'u';
+    dst[2] = '-';
+    dst += 2 + ( value < 0 );
+
+    // At most 5 digits, written in pairs to keep divisions independent
+    if ( uv >= 10000 )
+    {
+        *dst++ = (char)( '0' + uv / 10000 );
+        dst = put_digitpair( dst, ( uv / 100 ) % 100 );
+        dst = put_digitpair( dst, uv % 100 );
+    }
+    else if ( uv >= 1000 )
+    {
+        dst = put_digitpair( dst, uv / 100 );
+        dst = put_digitpair( dst, uv % 100 );
+    }
+    else if ( uv >= 100 )
+    {
+        *dst++ = (char)( '0' + uv / 100 );
+        dst = put_digitpair( dst, uv % 100 );
+    }
+    else if ( uv >= 10 )
+    {
+        dst = put_digitpair( dst, uv );
+    }
+    else
+    {
+        *dst++ = (char)( '0' + uv );
+    }
+
+    *dst++ = '?';
+
+    return dst;
+}
+
+// Escape of a UTF-16 unit below 0x800, at most 7 chars
+struct RTF_SHORTESCAPE
+{
+    char          text[7];
+    unsigned char length;
+};
+
+// Escapes of 2 byte UTF-8 sequences, formatted once
+struct RtfShortEscapes
+{
+    RTF_SHORTESCAPE entry[0x800];
+
+    RtfShortEscapes()
+    {
+        for ( unsigned int unit=0; unit<0x800; unit++ )
+        {
+            char tmp[16];
+            char* end = put_unicode( tmp, unit );
+
+            memcpy( entry[unit].text, tmp, end - tmp );
+            entry[unit].length = (unsigned char)( end - tmp );
+        }
+    }
+};
+
+static const RTF_SHORTESCAPE* get_shortescapes()
+{
+    static const RtfShortEscapes escapes;
+
+    return escapes.entry;
+}
+
+// Writes UTF-16 unit as put_unicode() does, units below 0x800 from
+// table. Needs 8 bytes at dst.
+static inline char* put_unicodeunit( char* dst, unsigned int unit,
+                                     const RTF_SHORTESCAPE* shortescapes )
+{
+    if ( unit < 0x800 )
+    {
+        memcpy( dst, &shortescapes[unit], 8 );
+        return dst + shortescapes[unit].length;
+    }
+
+    return put_unicode( dst, unit );
+}
+
+static inline bool is_continuation( unsigned char c )
+{
+    return ( ( c & 0xC0 ) == 0x80 );
+}
+
+// Decodes one UTF-8 sequence. Overlong forms, surrogates, values above
+// U+10FFFF and truncated sequences decode as U+FFFD. Returns bytes consumed.
+static inline size_t decode_utf8char( const unsigned char* src, size_t size, unsigned int& cp )
+{
+    unsigned char c = src[0];
+    size_t        len = 0;
+    unsigned char lo = 0x80;
+    unsigned char hi = 0xBF;
+
+    if ( ( c >= 0xC2 ) && ( c <= 0xDF ) )
+    {
+        cp  = c & 0x1F;
+        len = 2;
+    }
+    else if ( ( c >= 0xE0 ) && ( c <= 0xEF ) )
+    {
+        cp  = c & 0x0F;
+        len = 3;
+        if ( c == 0xE0 )
+            lo = 0xA0;
+        else if ( c == 0xED )
+            hi = 0x9F;
+    }
+    else if ( ( c >= 0xF0 ) && ( c <= 0xF4 ) )
+    {
+        cp  = c & 0x07;
+        len = 4;
+        if ( c == 0xF0 )
+            lo = 0x90;
+        else if ( c == 0xF4 )
+            hi = 0x8F;
+    }
+    else
+    {
+        cp = 0xFFFD;
+        return 1;
+    }
+
+    // Second byte range excludes overlong and out of range forms
+    if ( ( size < 2 ) || ( src[1] < lo ) || ( src[1] > hi ) )
+    {
+        cp = 0xFFFD;
+        return 1;
+    }
+
+    cp = ( cp << 6 ) | ( src[1] & 0x3F );
+
+    for ( size_t cnt=2; cnt<len; cnt++ )
+    {
+        if ( ( cnt >= size ) || ( is_continuation( src[cnt] ) == false ) )
+        {
+            cp = 0xFFFD;
+            return cnt;
+        }
+
+        cp = ( cp << 6 ) | ( src[cnt] & 0x3F );
+    }
+
+    return len;
+}
+
+// Writes a run of non-ASCII UTF-8 characters as \uN? escapes, with
+// surrogate pairs above U+FFFF. Escapes are staged in a local block and
+// written in one piece. Returns bytes consumed.
+static inline size_t put_utf8run( RtfBuffer& out, const unsigned char* src, size_t size )
+{
+    const RTF_SHORTESCAPE* shortescapes = get_shortescapes();
+    char   tmp[512];
+    char*  dst = tmp;
+    size_t pos = 0;
+
+    while ( ( pos < size ) && ( src[pos] >= 0x80 ) )
+    {
+        unsigned int cp = 0;
+
+        pos += decode_utf8char( src + pos, size - pos, cp );
+
+        if ( cp > 0xFFFF )
+        {
+            cp -= 0x10000;
+            dst = put_unicode( dst, 0xD800 + ( cp >> 10 ) );
+            dst = put_unicode( dst, 0xDC00 + ( cp & 0x3FF ) );
+        }
+        else
+        {
+            dst = put_unicodeunit( dst, cp, shortescapes );
+        }
+
+        // Two escapes take at most 18 bytes
+        if ( dst > tmp + sizeof(tmp) - 18 )
+        {
+            out.put( tmp, dst - tmp );
+            dst = tmp;
+        }
+    }
+
+    if ( dst > tmp )
+        out.put( tmp, dst - tmp );
+
+    return pos;
+}
+
+// Writes plain bytes from run up to escaped byte at pos, then escaped byte.
+// Positions below run were consumed already by a CR LF pair or a UTF-8
+// sequence.
+static inline void put_escapeat( RtfBuffer& out, const unsigned char* src,
+                                 size_t size, size_t& run, size_t pos, bool utf8 )
+{
+    if ( pos < run )
+        return;
+
+    if ( pos > run )
+        out.put( (const char*)src + run, pos - run );
+
+    if ( ( utf8 == true ) && ( src[pos] >= 0x80 ) )
+        run = pos + put_utf8run( out, src + pos, size - pos );
+    else
+        run = pos + put_escapedbyte( out, src + pos, size - pos );
+}
+
+// Escapes bytes from pos to end one by one, writes rest of plain bytes
+static inline void escape_tail( RtfBuffer& out, const unsigned char* src,
+                                size_t size, size_t run, size_t pos, bool utf8 )
+{
+    for ( ; pos<size; pos++ )
+    {
+        if ( escapebytes[ src[pos] ] != 0 )
+            put_escapeat( out, src, size, run, pos, utf8 );
+    }
+
+    if ( size > run )
+        out.put( (const char*)src + run, size - run );
+}
+
+static void escape_scalar( RtfBuffer& out, const unsigned char* src, size_t size, bool utf8 )
+{
+    escape_tail( out, src, size, 0, 0, utf8 );
+}
+
+#ifdef LIBRTF_X86
+
+// Bytes of UTF-8 block, widened to 16 bit lanes 0-7 or 8-15
+#define UTF8_LANES( v, z, high ) \
+    ( (high) ? _mm_unpackhi_epi8( v, z ) : _mm_unpacklo_epi8( v, z ) )
+
+// Decodes 2 and 3 byte UTF-8 sequences of 8 lanes, cp of each lead byte
+// lane is stored to cps. Returns mask of lanes with overlong 3 byte forms
+// or surrogates.
+static inline unsigned decode_utf8lanes( __m128i b0, __m128i b1, __m128i b2, uint16_t* cps )
+{
+    const __m128i m3f = _mm_set1_epi16( 0x3F );
+    const __m128i f800 = _mm_set1_epi16( (short)0xF800 );
+
+    __m128i is3 = _mm_cmpeq_epi16( _mm_and_si128( b0, _mm_set1_epi16( 0xF0 ) ),
+                                   _mm_set1_epi16( 0xE0 ) );
+    __m128i c1  = _mm_slli_epi16( _mm_and_si128( b1, m3f ), 6 );
+    __m128i cp2 = _mm_or_si128( _mm_slli_epi16( _mm_and_si128( b0, _mm_set1_epi16( 0x1F ) ), 6 ),
+                                _mm_and_si128( b1, m3f ) );
+    __m128i cp3 = _mm_or_si128( _mm_slli_epi16( _mm_and_si128( b0, _mm_set1_epi16( 0x0F ) ), 12 ),
+                  _mm_or_si128( c1, _mm_and_si128( b2, m3f ) ) );
+    __m128i cp  = _mm_or_si128( _mm_and_si128( is3, cp3 ), _mm_andnot_si128( is3, cp2 ) );
+
+    // 3 byte forms must be U+0800 and up, not U+D800-DFFF
+    __m128i top = _mm_and_si128( cp, f800 );
+    __m128i bad = _mm_and_si128( is3,
+                  _mm_or_si128( _mm_cmpeq_epi16( top, _mm_setzero_si128() ),
+                                _mm_cmpeq_epi16( top, _mm_set1_epi16( (short)0xD800 ) ) ) );
+
+    _mm_storeu_si128( (__m128i*)cps, cp );
+
+    return (unsigned)_mm_movemask_epi8( bad );
+}
+
+// Writes 16 bytes of UTF-8 text at pos, needs 16 bytes after them.
+// Block is validated and decoded in vectors, then staged in one piece:
+// escaped ASCII bytes, \uN? escapes and plain bytes between. Bytes
+// below run were consumed by previous block, so blocks stay 16 bytes
+// apart whatever sequences cross them. Returns false without writing
+// for blocks with 4 byte or invalid sequences, left to scalar decoder.
+static bool put_utf8block( RtfBuffer& out, const unsigned char* src, size_t& run, size_t pos )
+{
+    const unsigned char* p = src + pos;
+    size_t               skip = ( run > pos ) ? run - pos : 0;
+
+    if ( skip > 2 )
+        return false;
+
+    unsigned skipped = ( 1u << skip ) - 1;
+
+    __m128i v0 = _mm_loadu_si128( (const __m128i*)p );
+    __m128i v1 = _mm_loadu_si128( (const __m128i*)( p + 1 ) );
+    __m128i v2 = _mm_loadu_si128( (const __m128i*)( p + 2 ) );
+
+    unsigned high = (unsigned)_mm_movemask_epi8( v0 );
+    unsigned cont = (unsigned)_mm_movemask_epi8(
+                    _mm_cmpeq_epi8( _mm_and_si128( v0, _mm_set1_epi8( (char)0xC0 ) ),
+                                    _mm_set1_epi8( (char)0x80 ) ) );
+    unsigned lead2 = (unsigned)_mm_movemask_epi8(
+                     _mm_cmpeq_epi8( _mm_and_si128( v0, _mm_set1_epi8( (char)0xE0 ) ),
+                                     _mm_set1_epi8( (char)0xC0 ) ) );
+    unsigned lead3 = (unsigned)_mm_movemask_epi8(
+                     _mm_cmpeq_epi8( _mm_and_si128( v0, _mm_set1_epi8( (char)0xF0 ) ),
+                                     _mm_set1_epi8( (char)0xE0 ) ) );
+    unsigned overlong = (unsigned)_mm_movemask_epi8(
+                        _mm_cmpeq_epi8( _mm_and_si128( v0, _mm_set1_epi8( (char)0xFE ) ),
+                                        _mm_set1_epi8( (char)0xC0 ) ) );
+
+    // Only 2 and 3 byte leads and continuations, no C0 C1 leads
+    if ( ( ( high & ~( cont | lead2 | lead3 ) ) != 0 ) || ( overlong != 0 ) )
+        return false;
+
+    // Continuations are exactly where leads expect them, a sequence may
+    // end in the 2 bytes after block
+    unsigned expect = ( lead2 << 1 ) | ( lead3 << 1 ) | ( lead3 << 2 );
+    unsigned after = ( ( ( p[16] & 0xC0 ) == 0x80 ) ? 0x10000u : 0 ) |
+                     ( ( ( p[17] & 0xC0 ) == 0x80 ) ? 0x20000u : 0 );
+
+    if ( ( ( expect & 0xFFFF ) != ( cont & ~skipped ) ) ||
+         ( ( expect & ~0xFFFFu & ~after ) != 0 ) )
+        return false;
+
+    uint16_t cps[16];
+    __m128i  z = _mm_setzero_si128();
+    unsigned bad = decode_utf8lanes( UTF8_LANES( v0, z, false ), UTF8_LANES( v1, z, false ),
+                                     UTF8_LANES( v2, z, false ), cps ) |
+                   ( decode_utf8lanes( UTF8_LANES( v0, z, true ), UTF8_LANES( v1, z, true ),
+                                       UTF8_LANES( v2, z, true ), cps + 8 ) << 16 );
+
+    // Lane masks have 2 bits per lane, lead bit i is lane bit 2i
+    for ( unsigned bits=lead3; bits!=0; bits&=bits-1 )
+    {
+        if ( ( ( bad >> ( lowest_bit( bits ) * 2 ) ) & 1 ) != 0 )
+            return false;
+    }
+
+    // ASCII bytes escaped as put_escapedbyte() does
+    const __m128i lim = _mm_set1_epi8( 0x20 );
+    unsigned ascii = (unsigned)_mm_movemask_epi8(
+                     _mm_or_si128( _mm_cmpeq_epi8( v0, _mm_set1_epi8( '\\' ) ),
+                     _mm_or_si128( _mm_cmpeq_epi8( v0, _mm_set1_epi8( '{' ) ),
+                     _mm_or_si128( _mm_cmpeq_epi8( v0, _mm_set1_epi8( '}' ) ),
+                                   _mm_cmplt_epi8( v0, lim ) ) ) ) ) & ~high;
+
+    if ( pos > run )
+        out.put( (const char*)src + run, pos - run );
+
+    // 16 bytes stage at most 96 chars, 6 per escaped byte. Plain bytes
+    // are copied 16 at a time, staged straight in buffer when it has room.
+    const RTF_SHORTESCAPE* shortescapes = get_shortescapes();
+    char   stage[128];
+    char*  base = stage;
+    char*  room = NULL;
+    size_t next = skip;
+
+    if ( out.reserve( &room, sizeof(stage) ) >= sizeof(stage) )
+        base = room;
+
+    char*  dst = base;
+
+    if ( ascii == 0 )
+    {
+        // Only sequences, lead3 bit adds third byte
+        for ( unsigned leads = lead2 | lead3; leads != 0; leads &= leads - 1 )
+        {
+            size_t at = lowest_bit( leads );
+
+            _mm_storeu_si128( (__m128i*)dst, _mm_loadu_si128( (const __m128i*)( p + next ) ) );
+            dst += at - next;
+            dst = put_unicodeunit( dst, cps[at], shortescapes );
+            next = at + 2 + ( ( lead3 >> at ) & 1 );
+        }
+    }
+    else
+    {
+        for ( unsigned events = ( ascii | lead2 | lead3 ) & ~skipped; events != 0; events &= events - 1 )
+        {
+            size_t at = lowest_bit( events );
+
+            // LF of a CR LF pair
+            if ( at < next )
+                continue;
+
+            _mm_storeu_si128( (__m128i*)dst, _mm_loadu_si128( (const __m128i*)( p + next ) ) );
+            dst += at - next;
+
+            if ( ( ( ascii >> at ) & 1 ) == 0 )
+            {
+                dst = put_unicodeunit( dst, cps[at], shortescapes );
+                next = at + 2 + ( ( lead3 >> at ) & 1 );
+            }
+            else
+            {
+                size_t used = 0;
+
+                dst = stage_escapedbyte( dst, p + at, 2, used );
+                next = at + used;
+            }
+        }
+    }
+
+    if ( base == stage )
+        out.put( stage, dst - stage );
+    else
+        out.commit( dst - base );
+
+    // Plain bytes left in block are written with next run
+    run = pos + next;
+
+    return true;
+}
+
+// Escapes 16 bytes of UTF-8 text at pos, vectorized for blocks of 2 and
+// 3 byte sequences. Returns position of next block.
+static size_t escape_utf8block( RtfBuffer& out, const unsigned char* src,
+                                size_t size, size_t& run, size_t pos )
+{
+    size_t end = pos + 16;
+
+    if ( ( pos + 32 <= size ) && ( put_utf8block( out, src, run, pos ) == true ) )
+        return end;
+
+    if ( end > size )
+        end = size;
+
+    for ( ; pos<end; pos++ )
+    {
+        if ( escapebytes[ src[pos] ] != 0 )
+            put_escapeat( out, src, size, run, pos, true );
+    }
+
+    return ( run > end ) ? run : end;
+}
+
+// Escaped bytes are those below 0x20 as signed bytes (controls and
+// non-ASCII), and \ { }. Every escaped byte of a block is handled from
+// its mask, plain bytes between are copied as one run.
+static void escape_sse2( RtfBuffer& out, const unsigned char* src, size_t size, bool utf8 )
+{
+    const __m128i lim = _mm_set1_epi8( 0x20 );
+    const __m128i bsl = _mm_set1_epi8( '\\' );
+    const __m128i obr = _mm_set1_epi8( '{' );
+    const __m128i cbr = _mm_set1_epi8( '}' );
+
+    size_t run = 0;
+    size_t pos = 0;
+
+    while ( pos + 16 <= size )
+    {
+        __m128i v = _mm_loadu_si128( (const __m128i*)( src + pos ) );
+
+        // Non-ASCII UTF-8 blocks are decoded as a whole
+        if ( ( utf8 == true ) && ( _mm_movemask_epi8( v ) != 0 ) )
+        {
+            pos = escape_utf8block( out, src, size, run, pos );
+            continue;
+        }
+
+        __m128i m = _mm_or_si128( _mm_cmplt_epi8( v, lim ),
+                    _mm_or_si128( _mm_cmpeq_epi8( v, bsl ),
+                    _mm_or_si128( _mm_cmpeq_epi8( v, obr ),
+                                  _mm_cmpeq_epi8( v, cbr ) ) ) );
+        unsigned mask = (unsigned)_mm_movemask_epi8( m );
+
+        while ( mask != 0 )
+        {
+            put_escapeat( out, src, size, run, pos + lowest_bit( mask ), utf8 );
+            mask &= mask - 1;
+        }
+
+        // Skip bytes already consumed past this block
+        pos += 16;
+        if ( run > pos )
+            pos = run;
+    }
+
+    escape_tail( out, src, size, run, pos, utf8 );
+}
+
+LIBRTF_TARGET_AVX2
+static void escape_avx2( RtfBuffer& out, const unsigned char* src, size_t size, bool utf8 )
+{
+    const __m256i lim = _mm256_set1_epi8( 0x20 );
+    const __m256i bsl = _mm256_set1_epi8( '\\' );
+    const __m256i obr = _mm256_set1_epi8( '{' );
+    const __m256i cbr = _mm256_set1_epi8( '}' );
+
+    size_t run = 0;
+    size_t pos = 0;
+
+    while ( pos + 32 <= size )
+    {
+        __m256i v = _mm256_loadu_si256( (const __m256i*)( src + pos ) );
+
+        // Non-ASCII UTF-8 blocks are decoded 16 bytes at a time
+        if ( ( utf8 == true ) && ( _mm256_movemask_epi8( v ) != 0 ) )
+        {
+            pos = escape_utf8block( out, src, size, run, pos );
+            continue;
+        }
+
+        __m256i m = _mm256_or_si256( _mm256_cmpgt_epi8( lim, v ),
+                    _mm256_or_si256( _mm256_cmpeq_epi8( v, bsl ),
+                    _mm256_or_si256( _mm256_cmpeq_epi8( v, obr ),
+                                     _mm256_cmpeq_epi8( v, cbr ) ) ) );
+        unsigned mask = (unsigned)_mm256_movemask_epi8( m );
+
+        while ( mask != 0 )
+        {
+            put_escapeat( out, src, size, run, pos + lowest_bit( mask ), utf8 );
+            mask &= mask - 1;
+        }
+
+        // Skip bytes already consumed past this block
+        pos += 32;
+        if ( run > pos )
+            pos = run;
+    }
+
+    escape_tail( out, src, size, run, pos, utf8 );
+}
+
+#endif /// of LIBRTF_X86
+
+static int detect_method()
+{
+#ifdef LIBRTF_X86
+    if ( has_avx2() == true )
+        return RTF_ESCAPE_AVX2;
+
+    return RTF_ESCAPE_SSE2;
+#else
+    return RTF_ESCAPE_SCALAR;
+#endif
+}
+
+static RTF_ESCAPE_FUNC get_escaper( int method )
+{
+    switch( method )
+    {
+#ifdef LIBRTF_X86
+        case RTF_ESCAPE_SSE2:
+            return escape_sse2;
+
+        case RTF_ESCAPE_AVX2:
+            return escape_avx2;
+#endif
+        default:
+            return escape_scalar;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Gets fastest escaping method of running CPU
+int librtf::get_escapemethod()
+{
+    static const int method = detect_method();
+
+    return method;
+}
+
+// Gets escaping method name
+const char* librtf::get_escapemethodname( int method )
+{
+    switch( method )
+    {
+        case RTF_ESCAPE_AUTO:
+            return get_escapemethodname( get_escapemethod() );
+
+        case RTF_ESCAPE_SCALAR:
+            return "scalar";
+
+        case RTF_ESCAPE_SSE2:
+            return "sse2";
+
+        case RTF_ESCAPE_AVX2:
+            return "avx2";
+    }
+
+    return "unknown";
+}
+
+// Appends escaped text with a given method
+void librtf::put_escaped( RtfBuffer& out, const char* text, size_t size, int method )
+{
+    if ( ( text == NULL ) || ( size == 0 ) )
+        return;
+
+    // Methods running CPU lacks fall back to fastest supported one
+    if ( ( method == RTF_ESCAPE_AUTO ) || ( method > get_escapemethod() ) )
+        method = get_escapemethod();
+
+    get_escaper( method )( out, (const unsigned char*)text, size, false );
+}
+
+// Appends escaped text
+void librtf::put_escaped( RtfBuffer& out, const char* text, size_t size )
+{
+    put_escaped( out, text, size, get_escapemethod() );
+}
+
+// Appends escaped UTF-8 text with a given method
+void librtf::put_escapedutf8( RtfBuffer& out, const char* text, size_t size, int method )
+{
+    if ( ( text == NULL ) || ( size == 0 ) )
+        return;
+
+    if ( ( method == RTF_ESCAPE_AUTO ) || ( method > get_escapemethod() ) )
+        method = get_escapemethod();
+
+    get_escaper( method )( out, (const unsigned char*)text, size, true );
+}
+
+// Appends escaped UTF-8 text
+void librtf::put_escapedutf8( RtfBuffer& out, const char* text, size_t size )
+{
+    put_escapedutf8( out, text, size, get_escapemethod() );
+}
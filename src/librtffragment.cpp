@@ -0,0 +1,162 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "librtffragment.h"
+#include "librtfdocument.h"
+
+using namespace librtf;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Rendered fragment waiting to be appended
+struct FragmentSlot
+{
+    char*   data;
+    size_t  size;
+    bool    ready;
+    bool    failed;
+};
+
+// State shared by workers and appending thread
+struct FragmentJob
+{
+    const RtfDocument*          target;
+    size_t                      count;
+    RTF_FRAGMENT_CALLBACK       callback;
+    void*                       param;
+    std::vector<FragmentSlot>   slots;
+    std::atomic<size_t>         next;
+    std::atomic<bool>           stop;
+    std::mutex                  lock;
+    std::condition_variable     done;
+};
+
+// Renders fragments until none are left
+static void render_fragments( FragmentJob* job )
+{
+    RtfMemorySink sink;
+    RtfDocument   fragment;
+
+    for ( ;; )
+    {
+        size_t index = job->next++;
+
+        if ( index >= job->count )
+            break;
+
+        char*  data = NULL;
+        size_t size = 0;
+        bool   failed = true;
+
+        if ( job->stop == false )
+        {
+            sink.clear();
+
+            if ( fragment.open_fragment( &sink, job->target ) == RTF_SUCCESS )
+            {
+                failed = ( job->callback( &fragment, index, job->param ) == false );
+
+                if ( fragment.close() != RTF_SUCCESS )
+                    failed = true;
+            }
+
+            if ( failed == false )
+                data = sink.detach( &size );
+            else
+                job->stop = true;
+        }
+
+        std::lock_guard<std::mutex> guard( job->lock );
+        FragmentSlot& slot = job->slots[index];
+
+        slot.data   = data;
+        slot.size   = size;
+        slot.failed = failed;
+        slot.ready  = true;
+
+        job->done.notify_all();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfFragmentBuilder::RtfFragmentBuilder( int count )
+ : threads( count )
+{
+    if ( threads <= 0 )
+        threads = (int)std::thread::hardware_concurrency();
+
+    if ( threads <= 0 )
+        threads = 1;
+}
+
+RTF_ERROR_TYPE RtfFragmentBuilder::build( RtfDocument* doc, size_t count,
+                                          RTF_FRAGMENT_CALLBACK cb, void* param )
+{
+    if ( ( doc == NULL ) || ( cb == NULL ) )
+        return RTF_ERROR;
+
+    if ( count == 0 )
+        return RTF_SUCCESS;
+
+    FragmentJob job;
+
+    job.target   = doc;
+    job.count    = count;
+    job.callback = cb;
+    job.param    = param;
+    job.next     = 0;
+    job.stop     = false;
+
+    FragmentSlot empty = { NULL, 0, false, false };
+    job.slots.assign( count, empty );
+
+    std::vector<std::thread> workers;
+    size_t                   workercount = ( (size_t)threads < count ) ? threads : count;
+
+    for ( size_t cnt=0; cnt<workercount; cnt++ )
+        workers.push_back( std::thread( render_fragments, &job ) );
+
+    // Append fragments in order as they are rendered
+    RTF_ERROR_TYPE error = RTF_SUCCESS;
+
+    for ( size_t index=0; index<count; index++ )
+    {
+        FragmentSlot slot;
+
+        {
+            std::unique_lock<std::mutex> guard( job.lock );
+
+            while ( job.slots[index].ready == false )
+                job.done.wait( guard );
+
+            slot = job.slots[index];
+        }
+
+        if ( slot.failed == true )
+        {
+            error = RTF_ERROR;
+        }
+        else if ( error == RTF_SUCCESS )
+        {
+            error = doc->write_fragment( slot.data, slot.size );
+
+            if ( error != RTF_SUCCESS )
+                job.stop = true;
+        }
+
+        if ( slot.data != NULL )
+            free( slot.data );
+    }
+
+    for ( size_t cnt=0; cnt<workers.size(); cnt++ )
+        workers[cnt].join();
+
+    return error;
+}
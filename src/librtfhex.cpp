@@ -0,0 +1,274 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "librtfhex.h"
+#include "librtfcpu.h"
+
+using namespace librtf;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Output chunk asked from buffer
+#define HEX_CHUNKSIZE   16384
+
+// Two hex chars of every byte value
+static const char hexpairs[] =
+    "000102030405060708090a0b0c0d0e0f"
+    "101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f"
+    "303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f"
+    "505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f"
+    "707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f"
+    "909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+    "b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+    "d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+    "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+typedef void (*RTF_HEX_FUNC)( char* dst, const unsigned char* src, size_t size );
+
+static void encode_scalar( char* dst, const unsigned char* src, size_t size )
+{
+    for ( size_t cnt=0; cnt<size; cnt++ )
+    {
+        memcpy( dst, hexpairs + 2 * src[cnt], 2 );
+        dst += 2;
+    }
+}
+
+#ifdef LIBRTF_X86
+
+// Nibbles are looked up 16 at a time with a byte shuffle, then high and
+// low digits are interleaved
+LIBRTF_TARGET_SSSE3
+static void encode_ssse3( char* dst, const unsigned char* src, size_t size )
+{
+    const __m128i lut  = _mm_setr_epi8( '0', '1', '2', '3', '4', '5', '6', '7',
+                                        '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' );
+    const __m128i mask = _mm_set1_epi8( 0x0F );
+
+    size_t pos = 0;
+
+    for ( ; pos+16<=size; pos+=16 )
+    {
+        __m128i v  = _mm_loadu_si128( (const __m128i*)( src + pos ) );
+        __m128i hi = _mm_shuffle_epi8( lut, _mm_and_si128( _mm_srli_epi16( v, 4 ), mask ) );
+        __m128i lo = _mm_shuffle_epi8( lut, _mm_and_si128( v, mask ) );
+
+        _mm_storeu_si128( (__m128i*)( dst + 2 * pos ), _mm_unpacklo_epi8( hi, lo ) );
+        _mm_storeu_si128( (__m128i*)( dst + 2 * pos + 16 ), _mm_unpackhi_epi8( hi, lo ) );
+    }
+
+    encode_scalar( dst + 2 * pos, src + pos, size - pos );
+}
+
+// Same as above 32 at a time, unpacking works per 128 bit lane so
+// lanes are put back in order before storing
+LIBRTF_TARGET_AVX2
+static void encode_avx2( char* dst, const unsigned char* src, size_t size )
+{
+    const __m256i lut  = _mm256_setr_epi8( '0', '1', '2', '3', '4', '5', '6', '7',
+                                           '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+                                           '0', '1', '2', '3', '4', '5', '6', '7',
+                                           '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' );
+    const __m256i mask = _mm256_set1_epi8( 0x0F );
+
+    size_t pos = 0;
+
+    for ( ; pos+32<=size; pos+=32 )
+    {
+        __m256i v  = _mm256_loadu_si256( (const __m256i*)( src + pos ) );
+        __m256i hi = _mm256_shuffle_epi8( lut, _mm256_and_si256( _mm256_srli_epi16( v, 4 ), mask ) );
+        __m256i lo = _mm256_shuffle_epi8( lut, _mm256_and_si256( v, mask ) );
+        __m256i a  = _mm256_unpacklo_epi8( hi, lo );
+        __m256i b  = _mm256_unpackhi_epi8( hi, lo );
+
+        _mm256_storeu_si256( (__m256i*)( dst + 2 * pos ), _mm256_permute2x128_si256( a, b, 0x20 ) );
+        _mm256_storeu_si256( (__m256i*)( dst + 2 * pos + 32 ), _mm256_permute2x128_si256( a, b, 0x31 ) );
+    }
+
+    encode_ssse3( dst + 2 * pos, src + pos, size - pos );
+}
+
+#endif /// of LIBRTF_X86
+
+static int detect_method()
+{
+#ifdef LIBRTF_X86
+    if ( has_avx2() == true )
+        return RTF_HEX_AVX2;
+
+    if ( has_ssse3() == true )
+        return RTF_HEX_SSSE3;
+#endif
+
+    return RTF_HEX_SCALAR;
+}
+
+static RTF_HEX_FUNC get_encoder( int method )
+{
+    if ( ( method == RTF_HEX_AUTO ) || ( method > get_hexmethod() ) )
+        method = get_hexmethod();
+
+    switch( method )
+    {
+#ifdef LIBRTF_X86
+        case RTF_HEX_SSSE3:
+            return encode_ssse3;
+
+        case RTF_HEX_AVX2:
+            return encode_avx2;
+#endif
+        default:
+            return encode_scalar;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Gets fastest hex method of running CPU
+int librtf::get_hexmethod()
+{
+    static const int method = detect_method();
+
+    return method;
+}
+
+// Gets hex method name
+const char* librtf::get_hexmethodname( int method )
+{
+    switch( method )
+    {
+        case RTF_HEX_AUTO:
+            return get_hexmethodname( get_hexmethod() );
+
+        case RTF_HEX_SCALAR:
+            return "scalar";
+
+        case RTF_HEX_SSSE3:
+            return "ssse3";
+
+        case RTF_HEX_AVX2:
+            return "avx2";
+    }
+
+    return "unknown";
+}
+
+// Converts binary data to hex with a given method
+void librtf::hex_encode( char* dst, const unsigned char* src, size_t size, int method )
+{
+    if ( ( dst == NULL ) || ( src == NULL ) )
+        return;
+
+    get_encoder( method )( dst, src, size );
+}
+
+// Converts binary data to hex
+void librtf::hex_encode( char* dst, const unsigned char* src, size_t size )
+{
+    hex_encode( dst, src, size, RTF_HEX_AUTO );
+}
+
+// Appends binary data as hex with a given method
+void librtf::put_hex( RtfBuffer& out, const unsigned char* data, size_t size,
+                      size_t lineWidth, int method )
+{
+    if ( ( data == NULL ) || ( size == 0 ) )
+        return;
+
+    RTF_HEX_FUNC encode = get_encoder( method );
+
+    // Whole bytes per line, 0 for one line
+    size_t lineBytes = lineWidth / 2;
+
+    if ( ( lineWidth > 0 ) && ( lineBytes == 0 ) )
+        lineBytes = 1;
+
+    size_t lineLeft = lineBytes;
+
+    while ( size > 0 )
+    {
+        char*  dst = NULL;
+        size_t want = ( size < HEX_CHUNKSIZE / 2 ) ? 2 * size + size / 32 + 1 : HEX_CHUNKSIZE;
+        size_t room = out.reserve( &dst, want );
+
+        if ( out.good() == false )
+            return;
+
+        // Buffer too small to hold a byte and a newline
+        if ( room < 3 )
+        {
+            char tmp[3];
+
+            if ( ( lineBytes > 0 ) && ( lineLeft == 0 ) )
+            {
+                out.put_char( '\n' );
+                lineLeft = lineBytes;
+            }
+
+            encode( tmp, data, 1 );
+            out.put( tmp, 2 );
+            data++;
+            size--;
+
+            if ( lineBytes > 0 )
+                lineLeft--;
+
+            continue;
+        }
+
+        size_t used = 0;
+
+        if ( lineBytes == 0 )
+        {
+            size_t part = ( size < room / 2 ) ? size : room / 2;
+
+            encode( dst, data, part );
+            used  = 2 * part;
+            data += part;
+            size -= part;
+        }
+        else
+        {
+            // Newline goes before a line, so none trails last line
+            while ( ( size > 0 ) && ( room - used >= 3 ) )
+            {
+                if ( lineLeft == 0 )
+                {
+                    dst[ used++ ] = '\n';
+                    lineLeft = lineBytes;
+                }
+
+                size_t part = ( room - used ) / 2;
+
+                if ( part > lineLeft )
+                    part = lineLeft;
+
+                if ( part > size )
+                    part = size;
+
+                encode( dst + used, data, part );
+                used     += 2 * part;
+                data     += part;
+                size     -= part;
+                lineLeft -= part;
+            }
+        }
+
+        out.commit( used );
+    }
+}
+
+// Appends binary data as hex
+void librtf::put_hex( RtfBuffer& out, const unsigned char* data, size_t size,
+                      size_t lineWidth )
+{
+    put_hex( out, data, size, lineWidth, RTF_HEX_AUTO );
+}
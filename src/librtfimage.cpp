@@ -0,0 +1,291 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#include "librtfimage.h"
+
+using namespace librtf;
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DEFAULT_DPI     96
+
+static unsigned int get_be16( const unsigned char* p )
+{
+    return ( (unsigned int)p[0] << 8 ) | p[1];
+}
+
+static unsigned int get_be32( const unsigned char* p )
+{
+    return ( (unsigned int)p[0] << 24 ) | ( (unsigned int)p[1] << 16 ) |
+           ( (unsigned int)p[2] << 8 ) | p[3];
+}
+
+// Reads PNG IHDR, and pHYs if stored before image data
+static bool get_pnginfo( const unsigned char* data, size_t size, RTF_IMAGE_INFO* info )
+{
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+    // Signature, then IHDR must be first chunk
+    if ( ( size < 33 ) || ( memcmp( data, signature, 8 ) != 0 ) ||
+         ( memcmp( data + 12, "IHDR", 4 ) != 0 ) )
+        return false;
+
+    info->imageType = RTF_IMAGETYPE_PNG;
+    info->width     = (int)get_be32( data + 16 );
+    info->height    = (int)get_be32( data + 20 );
+
+    size_t pos = 8;
+
+    while ( pos + 12 <= size )
+    {
+        size_t len = get_be32( data + pos );
+        const unsigned char* type = data + pos + 4;
+
+        if ( memcmp( type, "IDAT", 4 ) == 0 )
+            break;
+
+        if ( ( memcmp( type, "pHYs", 4 ) == 0 ) && ( len == 9 ) && ( pos + 17 <= size ) )
+        {
+            // Pixels per meter
+            if ( data[ pos + 16 ] == 1 )
+            {
+                unsigned long long px = get_be32( data + pos + 8 );
+                unsigned long long py = get_be32( data + pos + 12 );
+
+                info->dpiX = (int)( ( px * 254 + 5000 ) / 10000 );
+                info->dpiY = (int)( ( py * 254 + 5000 ) / 10000 );
+            }
+            break;
+        }
+
+        // Length, type, data and CRC
+        if ( len > size - pos - 12 )
+            break;
+
+        pos += len + 12;
+    }
+
+    return ( ( info->width > 0 ) && ( info->height > 0 ) );
+}
+
+// Reads JPEG SOFn, and JFIF density if stored before it
+static bool get_jpeginfo( const unsigned char* data, size_t size, RTF_IMAGE_INFO* info )
+{
+    if ( ( size < 4 ) || ( data[0] != 0xFF ) || ( data[1] != 0xD8 ) )
+        return false;
+
+    size_t pos = 2;
+
+    while ( pos + 4 <= size )
+    {
+        if ( data[pos] != 0xFF )
+            return false;
+
+        unsigned char marker = data[ pos + 1 ];
+
+        // Fill bytes
+        if ( marker == 0xFF )
+        {
+            pos++;
+            continue;
+        }
+
+        // Markers without length
+        if ( ( marker == 0x01 ) || ( ( marker >= 0xD0 ) && ( marker <= 0xD7 ) ) )
+        {
+            pos += 2;
+            continue;
+        }
+
+        // Image data starts before any frame header
+        if ( ( marker == 0xD9 ) || ( marker == 0xDA ) )
+            return false;
+
+        size_t len = get_be16( data + pos + 2 );
+
+        if ( ( len < 2 ) || ( pos + 2 + len > size ) )
+            return false;
+
+        const unsigned char* seg = data + pos + 4;
+
+        // JFIF density, units 1 are dots per inch and 2 per centimeter
+        if ( ( marker == 0xE0 ) && ( len >= 16 ) && ( memcmp( seg, "JFIF", 5 ) == 0 ) )
+        {
+            unsigned int dx = get_be16( seg + 8 );
+            unsigned int dy = get_be16( seg + 10 );
+
+            if ( ( dx > 0 ) && ( dy > 0 ) )
+            {
+                if ( seg[7] == 1 )
+                {
+                    info->dpiX = (int)dx;
+                    info->dpiY = (int)dy;
+                }
+                else if ( seg[7] == 2 )
+                {
+                    info->dpiX = (int)( ( dx * 254 + 50 ) / 100 );
+                    info->dpiY = (int)( ( dy * 254 + 50 ) / 100 );
+                }
+            }
+        }
+
+        // SOF0 to SOF15, except DHT, JPG and DAC
+        if ( ( marker >= 0xC0 ) && ( marker <= 0xCF ) &&
+             ( marker != 0xC4 ) && ( marker != 0xC8 ) && ( marker != 0xCC ) )
+        {
+            if ( len < 7 )
+                return false;
+
+            info->imageType = RTF_IMAGETYPE_JPEG;
+            info->height    = (int)get_be16( seg + 1 );
+            info->width     = (int)get_be16( seg + 3 );
+
+            return ( ( info->width > 0 ) && ( info->height > 0 ) );
+        }
+
+        pos += 2 + len;
+    }
+
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Reads image header
+bool librtf::get_imageinfo( const unsigned char* data, size_t size, RTF_IMAGE_INFO* info )
+{
+    if ( ( data == NULL ) || ( info == NULL ) )
+        return false;
+
+    memset( info, 0, sizeof(RTF_IMAGE_INFO) );
+    info->dpiX = DEFAULT_DPI;
+    info->dpiY = DEFAULT_DPI;
+
+    if ( ( get_pnginfo( data, size, info ) == true ) ||
+         ( get_jpeginfo( data, size, info ) == true ) )
+    {
+        // Broken resolutions fall back to default
+        if ( ( info->dpiX <= 0 ) || ( info->dpiY <= 0 ) )
+        {
+            info->dpiX = DEFAULT_DPI;
+            info->dpiY = DEFAULT_DPI;
+        }
+
+        return true;
+    }
+
+    info->imageType = RTF_IMAGETYPE_UNKNOWN;
+
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfMappedFile::RtfMappedFile()
+ : ptr( NULL ),
+   len( 0 ),
+   mapping( NULL )
+{
+}
+
+RtfMappedFile::~RtfMappedFile()
+{
+    close();
+}
+
+bool RtfMappedFile::open( const char* filename )
+{
+    close();
+
+    if ( filename == NULL )
+        return false;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+
+    if ( file == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER fsize;
+
+    if ( ( GetFileSizeEx( file, &fsize ) == FALSE ) || ( fsize.QuadPart == 0 ) )
+    {
+        CloseHandle( file );
+        return false;
+    }
+
+    HANDLE map = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+
+    // Mapping keeps its own reference to file
+    CloseHandle( file );
+
+    if ( map == NULL )
+        return false;
+
+    void* view = MapViewOfFile( map, FILE_MAP_READ, 0, 0, 0 );
+
+    if ( view == NULL )
+    {
+        CloseHandle( map );
+        return false;
+    }
+
+    ptr     = (const unsigned char*)view;
+    len     = (size_t)fsize.QuadPart;
+    mapping = map;
+#else
+    int fd = ::open( filename, O_RDONLY );
+
+    if ( fd < 0 )
+        return false;
+
+    struct stat st;
+
+    if ( ( fstat( fd, &st ) != 0 ) || ( st.st_size <= 0 ) )
+    {
+        ::close( fd );
+        return false;
+    }
+
+    void* view = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+    // Mapping stays valid after close
+    ::close( fd );
+
+    if ( view == MAP_FAILED )
+        return false;
+
+    ptr = (const unsigned char*)view;
+    len = (size_t)st.st_size;
+#endif
+
+    return true;
+}
+
+void RtfMappedFile::close()
+{
+    if ( ptr == NULL )
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile( (LPCVOID)ptr );
+    CloseHandle( (HANDLE)mapping );
+#else
+    munmap( (void*)ptr, len );
+#endif
+
+    ptr     = NULL;
+    len     = 0;
+    mapping = NULL;
+}
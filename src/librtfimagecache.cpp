@@ -0,0 +1,298 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#include <sys/stat.h>
+
+#include "librtfimagecache.h"
+#include "librtfhex.h"
+
+using namespace librtf;
+
+////////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t rotl64( uint64_t x, int r )
+{
+    return ( x << r ) | ( x >> ( 64 - r ) );
+}
+
+static inline uint64_t mix64( uint64_t h )
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+// Two independent 64 bit lanes over 8 byte words
+static void hash128( const unsigned char* data, size_t size, uint64_t* out )
+{
+    const uint64_t p1 = 0x9e3779b185ebca87ULL;
+    const uint64_t p2 = 0xc2b2ae3d27d4eb4fULL;
+
+    uint64_t h1 = 0x27d4eb2f165667c5ULL ^ size;
+    uint64_t h2 = 0x165667b19e3779f9ULL + size;
+    size_t   pos = 0;
+
+    for ( ; pos+8<=size; pos+=8 )
+    {
+        uint64_t w;
+        memcpy( &w, data + pos, 8 );
+
+        h1 = rotl64( h1 ^ ( w * p1 ), 31 ) * p2;
+        h2 = rotl64( h2 + ( w * p2 ), 27 ) * p1;
+    }
+
+    uint64_t tail = 0;
+
+    for ( size_t cnt=0; pos+cnt<size; cnt++ )
+        tail |= (uint64_t)data[ pos + cnt ] << ( 8 * cnt );
+
+    h1 = mix64( h1 ^ ( tail * p1 ) );
+    h2 = mix64( h2 ^ h1 ^ ( tail * p2 ) );
+
+    out[0] = h1;
+    out[1] = h2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfImageCache::RtfImageCache( size_t budget )
+ : cacheBytes( 0 ),
+   cacheBudget( budget ),
+   cacheHits( 0 ),
+   cacheMisses( 0 ),
+   cacheEvictions( 0 )
+{
+}
+
+RtfImageCache::~RtfImageCache()
+{
+}
+
+std::string RtfImageCache::get_contentkey( const unsigned char* data, size_t size )
+{
+    uint64_t      hash[2];
+    unsigned char bytes[16];
+    char          key[32];
+
+    hash128( data, size, hash );
+
+    for ( int cnt=0; cnt<8; cnt++ )
+    {
+        bytes[cnt]     = (unsigned char)( hash[0] >> ( 8 * cnt ) );
+        bytes[cnt + 8] = (unsigned char)( hash[1] >> ( 8 * cnt ) );
+    }
+
+    hex_encode( key, bytes, 16 );
+
+    return std::string( key, 32 ) + ":" + std::to_string( size );
+}
+
+bool RtfImageCache::get_fileid( const char* path, RTF_IMAGEFILE_ID* id )
+{
+    struct stat st;
+
+    if ( ( path == NULL ) || ( id == NULL ) || ( stat( path, &st ) != 0 ) )
+        return false;
+
+    id->device = (unsigned long long)st.st_dev;
+    id->inode  = (unsigned long long)st.st_ino;
+    id->mtime  = st.st_mtime;
+    id->size   = (size_t)st.st_size;
+
+#if defined(_WIN32)
+    id->mtimeNsec = 0;
+#elif defined(__APPLE__)
+    id->mtimeNsec = st.st_mtimespec.tv_nsec;
+#else
+    id->mtimeNsec = st.st_mtim.tv_nsec;
+#endif
+
+    return true;
+}
+
+bool RtfImageCache::find_file( const char* path, const RTF_IMAGEFILE_ID& id, std::string& key )
+{
+    if ( path == NULL )
+        return false;
+
+    std::lock_guard<std::mutex> lock( cacheLock );
+
+    std::unordered_map<std::string, RtfImageFile>::iterator it = cacheFiles.find( path );
+
+    if ( it == cacheFiles.end() )
+        return false;
+
+    // A file replaced within a second keeps neither inode nor nanoseconds
+    const RTF_IMAGEFILE_ID& file = it->second.id;
+
+    if ( ( file.device != id.device ) || ( file.inode != id.inode ) ||
+         ( file.mtime != id.mtime ) || ( file.mtimeNsec != id.mtimeNsec ) ||
+         ( file.size != id.size ) )
+        return false;
+
+    key = it->second.key;
+
+    return true;
+}
+
+void RtfImageCache::insert_file( const char* path, const RTF_IMAGEFILE_ID& id, const std::string& key )
+{
+    if ( path == NULL )
+        return;
+
+    std::lock_guard<std::mutex> lock( cacheLock );
+
+    // Paths of evicted pictures are not tracked, index is dropped instead
+    if ( cacheFiles.size() >= RTF_IMAGECACHE_MAXFILES )
+        cacheFiles.clear();
+
+    RtfImageFile& file = cacheFiles[ path ];
+    file.id  = id;
+    file.key = key;
+}
+
+RtfImageBlob RtfImageCache::find( const std::string& key, const unsigned char* image,
+                                   size_t imagesize, bool* collision )
+{
+    std::lock_guard<std::mutex> lock( cacheLock );
+
+    std::unordered_map<std::string, RtfImageList::iterator>::iterator it = cacheMap.find( key );
+
+    if ( collision != NULL )
+        *collision = false;
+
+    if ( it == cacheMap.end() )
+    {
+        cacheMisses++;
+        return RtfImageBlob();
+    }
+
+    if ( ( image != NULL ) && ( same_image( it->second->image, image, imagesize ) == false ) )
+    {
+        if ( collision != NULL )
+            *collision = true;
+
+        cacheMisses++;
+        return RtfImageBlob();
+    }
+
+    // Move to front
+    cacheList.splice( cacheList.begin(), cacheList, it->second );
+    cacheHits++;
+
+    return it->second->blob;
+}
+
+RtfImageBlob RtfImageCache::insert( const std::string& key, const char* data, size_t size,
+                                     const unsigned char* image, size_t imagesize,
+                                     bool* collision )
+{
+    // Copies are made before locking
+    RtfImageBlob blob = std::make_shared<const std::string>( data, size );
+    std::string  copy( (const char*)image, imagesize );
+    size_t       bytes = size + imagesize;
+
+    if ( collision != NULL )
+        *collision = false;
+
+    std::lock_guard<std::mutex> lock( cacheLock );
+
+    if ( bytes > cacheBudget )
+        return blob;
+
+    std::unordered_map<std::string, RtfImageList::iterator>::iterator it = cacheMap.find( key );
+
+    if ( it != cacheMap.end() )
+    {
+        // Hash collision, picture is not cached
+        if ( same_image( it->second->image, image, imagesize ) == false )
+        {
+            if ( collision != NULL )
+                *collision = true;
+
+            return blob;
+        }
+
+        // Another thread inserted same picture
+        cacheList.splice( cacheList.begin(), cacheList, it->second );
+        return it->second->blob;
+    }
+
+    evict( cacheBudget - bytes );
+
+    cacheList.push_front( RtfImageEntry() );
+
+    RtfImageEntry& entry = cacheList.front();
+    entry.key  = key;
+    entry.blob = blob;
+    entry.image.swap( copy );
+
+    cacheMap[ key ] = cacheList.begin();
+    cacheBytes += bytes;
+
+    return blob;
+}
+
+void RtfImageCache::set_budget( size_t budget )
+{
+    std::lock_guard<std::mutex> lock( cacheLock );
+
+    cacheBudget = budget;
+    evict( budget );
+}
+
+void RtfImageCache::clear()
+{
+    std::lock_guard<std::mutex> lock( cacheLock );
+
+    cacheList.clear();
+    cacheMap.clear();
+    cacheFiles.clear();
+    cacheBytes = 0;
+}
+
+void RtfImageCache::get_stats( RTF_IMAGECACHE_STATS* stats )
+{
+    if ( stats == NULL )
+        return;
+
+    std::lock_guard<std::mutex> lock( cacheLock );
+
+    stats->hits      = cacheHits;
+    stats->misses    = cacheMisses;
+    stats->evictions = cacheEvictions;
+    stats->entries   = cacheList.size();
+    stats->bytes     = cacheBytes;
+    stats->budget    = cacheBudget;
+}
+
+// Compares image bytes of cached picture
+bool RtfImageCache::same_image( const std::string& cached, const unsigned char* image,
+                                size_t imagesize )
+{
+    if ( cached.size() != imagesize )
+        return false;
+
+    return ( imagesize == 0 ) || ( memcmp( cached.data(), image, imagesize ) == 0 );
+}
+
+// Drops least recently used pictures until cached bytes fit budget,
+// caller holds lock
+void RtfImageCache::evict( size_t budget )
+{
+    while ( ( cacheBytes > budget ) && ( cacheList.empty() == false ) )
+    {
+        RtfImageEntry& entry = cacheList.back();
+
+        cacheBytes -= entry.blob->size() + entry.image.size();
+        cacheMap.erase( entry.key );
+        cacheList.pop_back();
+        cacheEvictions++;
+    }
+}
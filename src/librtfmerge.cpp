@@ -0,0 +1,259 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "librtfmerge.h"
+#include "librtfescape.h"
+
+using namespace librtf;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Checks placeholder name character
+static inline bool is_namechar( char c )
+{
+    return ( ( c >= 'a' ) && ( c <= 'z' ) ) || ( ( c >= 'A' ) && ( c <= 'Z' ) ) ||
+           ( ( c >= '0' ) && ( c <= '9' ) ) || ( c == '_' ) || ( c == '.' ) || ( c == '-' );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfMergeTemplate::RtfMergeTemplate()
+{
+    clear();
+}
+
+// Drops template, an empty template merges to nothing
+void RtfMergeTemplate::clear()
+{
+    RtfMergeSlice last = { 0, 0, -1 };
+
+    text.clear();
+    slices.clear();
+    slices.push_back( last );
+    names.clear();
+    fields.clear();
+}
+
+// Gets field number of name, adds name if new
+int RtfMergeTemplate::add_field( const char* name, size_t length )
+{
+    std::string key( name, length );
+
+    std::unordered_map<std::string, int>::const_iterator it = fields.find( key );
+
+    if ( it != fields.end() )
+        return it->second;
+
+    int field = (int)names.size();
+
+    names.push_back( key );
+    fields.insert( std::make_pair( key, field ) );
+
+    return field;
+}
+
+// Matches placeholder at pos, raw {{name}} or escaped \{\{name\}\}.
+// Returns placeholder length, 0 if there is none.
+size_t RtfMergeTemplate::match_placeholder( size_t pos, const char** name, size_t* namelen ) const
+{
+    const char* p = text.data() + pos;
+    const char* end = text.data() + text.size();
+    bool        escaped = ( *p == '\\' );
+    size_t      open = escaped ? 4 : 2;
+
+    if ( (size_t)( end - p ) < open * 2 + 1 )
+        return 0;
+
+    if ( ( escaped == true ) && ( memcmp( p, "\\{\\{", 4 ) != 0 ) )
+        return 0;
+
+    if ( ( escaped == false ) && ( memcmp( p, "{{", 2 ) != 0 ) )
+        return 0;
+
+    const char* n = p + open;
+    const char* q = n;
+
+    while ( ( q < end ) && ( is_namechar( *q ) == true ) )
+        q++;
+
+    size_t length = q - n;
+
+    if ( ( length == 0 ) || ( length > RTF_MERGE_MAXNAMELENGTH ) )
+        return 0;
+
+    if ( (size_t)( end - q ) < open )
+        return 0;
+
+    if ( memcmp( q, escaped ? "\\}\\}" : "}}", open ) != 0 )
+        return 0;
+
+    *name = n;
+    *namelen = length;
+
+    return ( q + open ) - p;
+}
+
+// Loads template from memory
+RTF_ERROR_TYPE RtfMergeTemplate::load( const char* data, size_t size )
+{
+    clear();
+
+    if ( ( data == NULL ) && ( size > 0 ) )
+        return RTF_TEMPLATE_ERROR;
+
+    text.assign( data, size );
+    slices.clear();
+
+    // Index placeholders, both forms start at a brace
+    size_t start = 0;
+    size_t pos = 0;
+
+    while ( pos < text.size() )
+    {
+        const char* brace = (const char*)memchr( text.data() + pos, '{', text.size() - pos );
+
+        if ( brace == NULL )
+            break;
+
+        size_t at = brace - text.data();
+        size_t backslashes = 0;
+
+        while ( ( at - backslashes > start ) && ( text[at-backslashes-1] == '\\' ) )
+            backslashes++;
+
+        // Escaped brace, escaped form starts at backslash before it
+        if ( ( backslashes % 2 ) == 1 )
+            at--;
+
+        const char* name = NULL;
+        size_t      namelen = 0;
+        size_t      length = match_placeholder( at, &name, &namelen );
+
+        if ( length == 0 )
+        {
+            pos = brace - text.data() + 1;
+            continue;
+        }
+
+        RtfMergeSlice slice = { start, at - start, add_field( name, namelen ) };
+
+        slices.push_back( slice );
+
+        start = at + length;
+        pos = start;
+    }
+
+    RtfMergeSlice last = { start, text.size() - start, -1 };
+
+    slices.push_back( last );
+
+    return RTF_SUCCESS;
+}
+
+// Loads template from file
+RTF_ERROR_TYPE RtfMergeTemplate::load_file( const char* filename )
+{
+    clear();
+
+    if ( filename == NULL )
+        return RTF_OPEN_ERROR;
+
+    FILE* fp = fopen( filename, "rb" );
+
+    if ( fp == NULL )
+        return RTF_OPEN_ERROR;
+
+    std::string data;
+    char        block[65536];
+    size_t      readsize = 0;
+
+    while ( ( readsize = fread( block, 1, sizeof(block), fp ) ) > 0 )
+        data.append( block, readsize );
+
+    bool failed = ( ferror( fp ) != 0 );
+
+    fclose( fp );
+
+    if ( failed == true )
+        return RTF_OPEN_ERROR;
+
+    return load( data.data(), data.size() );
+}
+
+// Gets placeholder name of field number
+const char* RtfMergeTemplate::get_fieldname( size_t field ) const
+{
+    if ( field >= names.size() )
+        return NULL;
+
+    return names[field].c_str();
+}
+
+// Gets field number of placeholder name
+int RtfMergeTemplate::get_field( const char* name ) const
+{
+    if ( name == NULL )
+        return -1;
+
+    std::unordered_map<std::string, int>::const_iterator it = fields.find( name );
+
+    if ( it == fields.end() )
+        return -1;
+
+    return it->second;
+}
+
+// Appends template with field values
+RTF_ERROR_TYPE RtfMergeTemplate::merge( RtfBuffer& out, const RTF_TEXTSPAN* values, bool utf8 ) const
+{
+    if ( ( values == NULL ) && ( names.size() > 0 ) )
+        return RTF_TEMPLATE_ERROR;
+
+    const char* data = text.data();
+
+    for ( size_t cnt=0; cnt<slices.size(); cnt++ )
+    {
+        const RtfMergeSlice& slice = slices[cnt];
+
+        out.put( data + slice.offset, slice.length );
+
+        if ( slice.field < 0 )
+            continue;
+
+        const RTF_TEXTSPAN& value = values[ slice.field ];
+
+        if ( value.text == NULL )
+            continue;
+
+        if ( utf8 == true )
+            put_escapedutf8( out, value.text, value.length );
+        else
+            put_escaped( out, value.text, value.length );
+    }
+
+    if ( out.good() == false )
+        return RTF_TEMPLATE_ERROR;
+
+    return RTF_SUCCESS;
+}
+
+// Writes merged template to sink
+RTF_ERROR_TYPE RtfMergeTemplate::merge( RtfSink* sink, const RTF_TEXTSPAN* values, bool utf8 ) const
+{
+    if ( sink == NULL )
+        return RTF_TEMPLATE_ERROR;
+
+    RtfBuffer out;
+
+    out.set_sink( sink );
+
+    RTF_ERROR_TYPE error = merge( out, values, utf8 );
+
+    if ( out.flush() == false )
+        error = RTF_TEMPLATE_ERROR;
+
+    out.set_sink( NULL );
+
+    return error;
+}
@@ -0,0 +1,294 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#if __cplusplus >= 201703L
+    #include <charconv>
+#endif
+
+#include "librtfnumber.h"
+
+using namespace librtf;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Digits of double in fixed notation, largest is a denormal with
+// 2 + 324 + 17 chars, then sign and some room.
+#define NUMBER_DIGITSSIZE   384
+
+static const char digitpairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const unsigned long long powers10[] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL
+};
+
+#define NUMBER_MAXSCALE     18
+
+static const RTF_NUMBER_FORMAT defaultformat = { RTF_NUMBER_SHORTEST, '.', 0 };
+
+// Writes decimal digits of value ending at end, returns first digit
+static char* put_digits( char* end, unsigned long long value )
+{
+    while ( value >= 100 )
+    {
+        unsigned int pair = (unsigned int)( value % 100 );
+
+        value /= 100;
+        end -= 2;
+        memcpy( end, digitpairs + pair * 2, 2 );
+    }
+
+    if ( value >= 10 )
+    {
+        end -= 2;
+        memcpy( end, digitpairs + value * 2, 2 );
+    }
+    else
+    {
+        *--end = (char)( '0' + value );
+    }
+
+    return end;
+}
+
+// Writes sign, integer digits with thousands separators, decimal point
+// and fraction digits padded with zeros up to zeros, returns length.
+static size_t put_number( char* dst, bool negative,
+                          const char* digits, size_t intlen,
+                          const char* fraction, size_t fraclen, size_t zeros,
+                          const RTF_NUMBER_FORMAT& nf )
+{
+    char* p = dst;
+
+    if ( negative == true )
+        *p++ = '-';
+
+    if ( ( nf.thousandsSeparator != 0 ) && ( intlen > 3 ) )
+    {
+        size_t group = intlen % 3;
+
+        if ( group == 0 )
+            group = 3;
+
+        memcpy( p, digits, group );
+        p += group;
+
+        for ( size_t pos=group; pos<intlen; pos+=3 )
+        {
+            *p++ = nf.thousandsSeparator;
+            memcpy( p, digits + pos, 3 );
+            p += 3;
+        }
+    }
+    else
+    {
+        memcpy( p, digits, intlen );
+        p += intlen;
+    }
+
+    if ( ( fraclen > 0 ) || ( zeros > 0 ) )
+    {
+        *p++ = nf.decimalPoint;
+        memcpy( p, fraction, fraclen );
+        p += fraclen;
+
+        if ( zeros > fraclen )
+        {
+            memset( p, '0', zeros - fraclen );
+            p += zeros - fraclen;
+        }
+    }
+
+    *p = 0;
+
+    return p - dst;
+}
+
+// Gets precision limited to RTF_NUMBER_MAXPRECISION
+static int get_precision( const RTF_NUMBER_FORMAT& nf )
+{
+    if ( nf.precision > RTF_NUMBER_MAXPRECISION )
+        return RTF_NUMBER_MAXPRECISION;
+
+    return nf.precision;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t librtf::format_integer( char* dst, long long value, const RTF_NUMBER_FORMAT* nf )
+{
+    if ( nf == NULL )
+        nf = &defaultformat;
+
+    char               tmp[24];
+    char*              end = tmp + sizeof(tmp);
+    unsigned long long uv = ( value < 0 ) ? 0ULL - (unsigned long long)value
+                                          : (unsigned long long)value;
+    char*              digits = put_digits( end, uv );
+    int                precision = get_precision( *nf );
+
+    return put_number( dst, ( value < 0 ), digits, end - digits, NULL, 0,
+                       ( precision > 0 ) ? precision : 0, *nf );
+}
+
+size_t librtf::format_fixed( char* dst, long long value, int scale, const RTF_NUMBER_FORMAT* nf )
+{
+    if ( nf == NULL )
+        nf = &defaultformat;
+
+    if ( scale < 0 )
+        scale = 0;
+    else if ( scale > NUMBER_MAXSCALE )
+        scale = NUMBER_MAXSCALE;
+
+    unsigned long long uv = ( value < 0 ) ? 0ULL - (unsigned long long)value
+                                          : (unsigned long long)value;
+    int                precision = get_precision( *nf );
+
+    // Round away digits beyond precision
+    if ( ( precision >= 0 ) && ( precision < scale ) )
+    {
+        unsigned long long divisor = powers10[ scale - precision ];
+        unsigned long long rest = uv % divisor;
+
+        uv /= divisor;
+
+        if ( rest >= divisor - rest )
+            uv++;
+
+        scale = precision;
+    }
+
+    unsigned long long intpart = uv / powers10[ scale ];
+    unsigned long long fracpart = uv % powers10[ scale ];
+
+    char   tmp[24];
+    char*  end = tmp + sizeof(tmp);
+    char*  digits = put_digits( end, intpart );
+    char   fraction[NUMBER_MAXSCALE];
+    size_t fraclen = scale;
+
+    for ( int cnt=scale-1; cnt>=0; cnt-- )
+    {
+        fraction[cnt] = (char)( '0' + fracpart % 10 );
+        fracpart /= 10;
+    }
+
+    if ( precision < 0 )
+    {
+        while ( ( fraclen > 0 ) && ( fraction[fraclen-1] == '0' ) )
+            fraclen--;
+    }
+
+    return put_number( dst, ( value < 0 ) && ( uv != 0 ), digits, end - digits,
+                       fraction, fraclen, ( precision > 0 ) ? precision : 0, *nf );
+}
+
+size_t librtf::format_double( char* dst, double value, const RTF_NUMBER_FORMAT* nf )
+{
+    if ( nf == NULL )
+        nf = &defaultformat;
+
+    if ( std::isfinite( value ) == false )
+    {
+        const char* text = std::isnan( value ) ? "nan" : ( value < 0 ) ? "-inf" : "inf";
+
+        strcpy( dst, text );
+
+        return strlen( text );
+    }
+
+    char   tmp[NUMBER_DIGITSSIZE];
+    size_t len = 0;
+    int    precision = get_precision( *nf );
+
+#if defined(__cpp_lib_to_chars)
+    std::to_chars_result res;
+
+    if ( precision < 0 )
+        res = std::to_chars( tmp, tmp + sizeof(tmp), value, std::chars_format::fixed );
+    else
+        res = std::to_chars( tmp, tmp + sizeof(tmp), value, std::chars_format::fixed, precision );
+
+    len = res.ptr - tmp;
+#else
+    // No locale free conversion, decimal point of locale is replaced below.
+    // Shortest is 17 significant digits without trailing zeros.
+    if ( precision < 0 )
+    {
+        int exponent = 0;
+
+        if ( value != 0.0 )
+            exponent = (int)floor( log10( fabs( value ) ) );
+
+        precision = 16 - exponent;
+
+        if ( precision < 0 )
+            precision = 0;
+        else if ( precision > 340 )
+            precision = 340;
+
+        len = snprintf( tmp, sizeof(tmp), "%.*f", precision, value );
+
+        size_t sign = ( tmp[0] == '-' ) ? 1 : 0;
+        char*  point = tmp + sign + strspn( tmp + sign, "0123456789" );
+
+        if ( point < tmp + len )
+        {
+            while ( tmp[len-1] == '0' )
+                len--;
+
+            if ( tmp + len - 1 == point )
+                len--;
+        }
+
+        precision = -1;
+    }
+    else
+    {
+        len = snprintf( tmp, sizeof(tmp), "%.*f", precision, value );
+    }
+
+    if ( len >= sizeof(tmp) )
+        len = sizeof(tmp) - 1;
+#endif
+
+    // Split sign, integer and fraction digits
+    const char* digits = tmp;
+    bool        negative = false;
+
+    if ( *digits == '-' )
+    {
+        negative = true;
+        digits++;
+    }
+
+    size_t intlen = 0;
+
+    while ( ( digits + intlen < tmp + len ) &&
+            ( digits[intlen] >= '0' ) && ( digits[intlen] <= '9' ) )
+        intlen++;
+
+    const char* fraction = digits + intlen;
+    size_t      fraclen = tmp + len - fraction;
+
+    if ( fraclen > 0 )
+    {
+        fraction++;
+        fraclen--;
+    }
+
+    return put_number( dst, negative, digits, intlen, fraction, fraclen,
+                       ( precision > 0 ) ? precision : 0, *nf );
+}
@@ -0,0 +1,33 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "librtfprologue.h"
+
+using namespace librtf;
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfPrologue::RtfPrologue( const char* fonts, const char* colors, RTF_DOCUMENT_FORMAT* fmt )
+ : error( RTF_SUCCESS )
+{
+    RtfMemorySink sink;
+
+    error = document.open( &sink, fonts, colors, fmt );
+
+    if ( error != RTF_SUCCESS )
+        return;
+
+    // Keep bytes written by open(), before document end
+    if ( document.flush() == false )
+    {
+        error = RTF_HEADER_ERROR;
+    }
+    else
+    {
+        bytes.assign( sink.data(), sink.size() );
+    }
+
+    // Tables and formats stay with closed document
+    document.close();
+}
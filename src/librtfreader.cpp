@@ -0,0 +1,384 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+
+#include "librtfreader.h"
+#include "librtfescape.h"
+#include "librtfcpu.h"
+
+using namespace librtf;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Non zero for bytes ending a text run
+static const unsigned char delimiterbytes[256] =
+{
+    0,0,0,0,0,0,0,0,0,0,1,0,0,1,0,0,    /// 0x00, LF and CR
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,    /// 0x10
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,    /// 0x20
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,    /// 0x30
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,    /// 0x40
+    0,0,0,0,0,0,0,0,0,0,0,0,1,0,0,0,    /// 0x50, '\'
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,    /// 0x60
+    0,0,0,0,0,0,0,0,0,0,0,1,0,1,0,0,    /// 0x70, '{' and '}'
+};
+
+typedef size_t (*RTF_SCAN_FUNC)( const unsigned char* src, size_t size );
+
+static inline bool is_letter( char c )
+{
+    return ( ( c >= 'a' ) && ( c <= 'z' ) ) || ( ( c >= 'A' ) && ( c <= 'Z' ) );
+}
+
+static inline bool is_digit( char c )
+{
+    return ( c >= '0' ) && ( c <= '9' );
+}
+
+// Gets hex digit value, -1 for other chars
+static inline int get_hexvalue( char c )
+{
+    if ( is_digit( c ) == true )
+        return c - '0';
+
+    if ( ( c >= 'a' ) && ( c <= 'f' ) )
+        return c - 'a' + 10;
+
+    if ( ( c >= 'A' ) && ( c <= 'F' ) )
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+// Finds first delimiter, returns size if there is none
+static size_t scan_scalar( const unsigned char* src, size_t size )
+{
+    size_t pos = 0;
+
+    while ( ( pos < size ) && ( delimiterbytes[ src[pos] ] == 0 ) )
+        pos++;
+
+    return pos;
+}
+
+#ifdef LIBRTF_X86
+
+static size_t scan_sse2( const unsigned char* src, size_t size )
+{
+    const __m128i bsl = _mm_set1_epi8( '\\' );
+    const __m128i obr = _mm_set1_epi8( '{' );
+    const __m128i cbr = _mm_set1_epi8( '}' );
+    const __m128i cr  = _mm_set1_epi8( '\r' );
+    const __m128i lf  = _mm_set1_epi8( '\n' );
+
+    size_t pos = 0;
+
+    while ( pos + 16 <= size )
+    {
+        __m128i v = _mm_loadu_si128( (const __m128i*)( src + pos ) );
+        __m128i m = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( v, bsl ),
+                                                _mm_cmpeq_epi8( v, obr ) ),
+                    _mm_or_si128( _mm_cmpeq_epi8( v, cbr ),
+                    _mm_or_si128( _mm_cmpeq_epi8( v, cr ),
+                                  _mm_cmpeq_epi8( v, lf ) ) ) );
+        unsigned mask = (unsigned)_mm_movemask_epi8( m );
+
+        if ( mask != 0 )
+            return pos + lowest_bit( mask );
+
+        pos += 16;
+    }
+
+    return pos + scan_scalar( src + pos, size - pos );
+}
+
+LIBRTF_TARGET_AVX2
+static size_t scan_avx2( const unsigned char* src, size_t size )
+{
+    const __m256i bsl = _mm256_set1_epi8( '\\' );
+    const __m256i obr = _mm256_set1_epi8( '{' );
+    const __m256i cbr = _mm256_set1_epi8( '}' );
+    const __m256i cr  = _mm256_set1_epi8( '\r' );
+    const __m256i lf  = _mm256_set1_epi8( '\n' );
+
+    size_t pos = 0;
+
+    while ( pos + 32 <= size )
+    {
+        __m256i v = _mm256_loadu_si256( (const __m256i*)( src + pos ) );
+        __m256i m = _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8( v, bsl ),
+                                                      _mm256_cmpeq_epi8( v, obr ) ),
+                    _mm256_or_si256( _mm256_cmpeq_epi8( v, cbr ),
+                    _mm256_or_si256( _mm256_cmpeq_epi8( v, cr ),
+                                     _mm256_cmpeq_epi8( v, lf ) ) ) );
+        unsigned mask = (unsigned)_mm256_movemask_epi8( m );
+
+        if ( mask != 0 )
+            return pos + lowest_bit( mask );
+
+        pos += 32;
+    }
+
+    return pos + scan_scalar( src + pos, size - pos );
+}
+
+#endif /// of LIBRTF_X86
+
+static RTF_SCAN_FUNC get_scanner( int method )
+{
+    switch( method )
+    {
+#ifdef LIBRTF_X86
+        case RTF_ESCAPE_SSE2:
+            return scan_sse2;
+
+        case RTF_ESCAPE_AVX2:
+            return scan_avx2;
+#endif
+        default:
+            return scan_scalar;
+    }
+}
+
+// Sets token fields
+static inline void set_token( RTF_TOKEN& token, int type, const char* text, size_t length,
+                              int param = 0, bool hasParam = false )
+{
+    token.type     = type;
+    token.text     = text;
+    token.length   = length;
+    token.param    = param;
+    token.hasParam = hasParam;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfTokenizer::RtfTokenizer( int m )
+ : data( NULL ),
+   size( 0 ),
+   pos( 0 ),
+   last( true ),
+   depth( 0 ),
+   method( m )
+{
+    // Methods running CPU lacks fall back to fastest supported one
+    if ( ( method == RTF_ESCAPE_AUTO ) || ( method > get_escapemethod() ) )
+        method = get_escapemethod();
+}
+
+void RtfTokenizer::set_data( const char* d, size_t s, bool l )
+{
+    data = d;
+    size = ( d != NULL ) ? s : 0;
+    pos  = 0;
+    last = l;
+}
+
+void RtfTokenizer::reset()
+{
+    set_data( NULL, 0, true );
+    depth = 0;
+}
+
+// Reads control word at pos, \binN takes its data as well.
+// Returns false when word may go on past end of data.
+bool RtfTokenizer::next_controlword( RTF_TOKEN& token )
+{
+    const char* name = data + pos + 1;
+    const char* end = data + size;
+    const char* p = name;
+
+    while ( ( p < end ) && ( is_letter( *p ) == true ) && ( p - name < RTF_TOKEN_MAXWORDLENGTH ) )
+        p++;
+
+    size_t    length = p - name;
+    bool      negative = false;
+    bool      hasParam = false;
+    long long value = 0;
+
+    if ( ( p < end ) && ( *p == '-' ) )
+    {
+        negative = true;
+        p++;
+    }
+
+    const char* digits = p;
+
+    while ( ( p < end ) && ( is_digit( *p ) == true ) && ( p - digits < RTF_TOKEN_MAXPARAMDIGITS ) )
+    {
+        value = value * 10 + ( *p - '0' );
+        p++;
+    }
+
+    // Word or its delimiter may still follow
+    if ( ( p == end ) && ( last == false ) )
+        return false;
+
+    if ( p > digits )
+        hasParam = true;
+    else if ( negative == true )
+        p--;            /// lone '-' is not part of word
+
+    if ( negative == true )
+        value = -value;
+
+    if ( value > INT_MAX )
+        value = INT_MAX;
+    else if ( value < INT_MIN )
+        value = INT_MIN;
+
+    // One space delimits word and belongs to it
+    if ( ( p < end ) && ( *p == ' ' ) )
+        p++;
+
+    // Binary data follows \binN
+    if ( ( length == 3 ) && ( memcmp( name, "bin", 3 ) == 0 ) && ( value > 0 ) )
+    {
+        if ( (size_t)( end - p ) < (size_t)value )
+        {
+            if ( last == false )
+                return false;
+
+            // Truncated data
+            set_token( token, RTF_TOKEN_ERROR, data + pos, size - pos );
+            pos = size;
+
+            return true;
+        }
+
+        set_token( token, RTF_TOKEN_BINARY, p, (size_t)value, (int)value, true );
+        pos = ( p - data ) + (size_t)value;
+
+        return true;
+    }
+
+    set_token( token, RTF_TOKEN_CONTROLWORD, name, length, (int)value, hasParam );
+    pos = p - data;
+
+    return true;
+}
+
+// Reads control symbol or \'hh at pos.
+// Returns false when symbol may go on past end of data.
+bool RtfTokenizer::next_controlsymbol( RTF_TOKEN& token )
+{
+    const char* symbol = data + pos + 1;
+
+    if ( *symbol != '\'' )
+    {
+        set_token( token, RTF_TOKEN_CONTROLSYMBOL, symbol, 1 );
+        pos += 2;
+
+        return true;
+    }
+
+    if ( size - pos < 4 )
+    {
+        if ( last == false )
+            return false;
+
+        set_token( token, RTF_TOKEN_ERROR, data + pos, size - pos );
+        pos = size;
+
+        return true;
+    }
+
+    int high = get_hexvalue( symbol[1] );
+    int low = get_hexvalue( symbol[2] );
+
+    if ( ( high < 0 ) || ( low < 0 ) )
+    {
+        set_token( token, RTF_TOKEN_ERROR, data + pos, 2 );
+        pos += 2;
+
+        return true;
+    }
+
+    set_token( token, RTF_TOKEN_HEX, symbol + 1, 2, high * 16 + low, true );
+    pos += 4;
+
+    return true;
+}
+
+bool RtfTokenizer::next( RTF_TOKEN& token )
+{
+    RTF_SCAN_FUNC scan = get_scanner( method );
+
+    while ( pos < size )
+    {
+        char c = data[pos];
+
+        switch( c )
+        {
+            case '{':
+                depth++;
+                set_token( token, RTF_TOKEN_GROUPSTART, data + pos, 1 );
+                pos++;
+                return true;
+
+            case '}':
+                depth--;
+                set_token( token, RTF_TOKEN_GROUPEND, data + pos, 1 );
+                pos++;
+                return true;
+
+            case '\r':
+            case '\n':
+                pos++;
+                continue;
+
+            case '\\':
+                if ( pos + 1 == size )
+                {
+                    if ( last == false )
+                        return false;
+
+                    set_token( token, RTF_TOKEN_ERROR, data + pos, 1 );
+                    pos++;
+                    return true;
+                }
+
+                if ( is_letter( data[pos+1] ) == true )
+                    return next_controlword( token );
+
+                return next_controlsymbol( token );
+        }
+
+        // Text up to next delimiter
+        size_t length = scan( (const unsigned char*)data + pos, size - pos );
+
+        set_token( token, RTF_TOKEN_TEXT, data + pos, length );
+        pos += length;
+
+        return true;
+    }
+
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RTF_ERROR_TYPE librtf::tokenize( const char* data, size_t size,
+                                 RTF_TOKEN_CALLBACK cb, void* param )
+{
+    if ( ( cb == NULL ) || ( ( data == NULL ) && ( size > 0 ) ) )
+        return RTF_ERROR;
+
+    RtfTokenizer   tokenizer;
+    RTF_TOKEN      token;
+    RTF_ERROR_TYPE error = RTF_SUCCESS;
+
+    tokenizer.set_data( data, size );
+
+    while ( tokenizer.next( token ) == true )
+    {
+        if ( token.type == RTF_TOKEN_ERROR )
+            error = RTF_ERROR;
+
+        if ( cb( token, param ) == false )
+            return RTF_ERROR;
+    }
+
+    return error;
+}
@@ -0,0 +1,367 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <unistd.h>
+    #include <sys/uio.h>
+#endif
+
+#include "librtfsink.h"
+
+using namespace librtf;
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool RtfSink::writev( const RTF_IOVEC* iov, int count )
+{
+    for ( int cnt=0; cnt<count; cnt++ )
+    {
+        if ( iov[cnt].size == 0 )
+            continue;
+
+        if ( write( iov[cnt].base, iov[cnt].size ) == false )
+            return false;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfFileSink::RtfFileSink( const char* filename )
+ : fp( NULL ),
+   owned( true )
+{
+    if ( filename != NULL )
+        fp = fopen( filename, "wb" );
+}
+
+RtfFileSink::RtfFileSink( FILE* f )
+ : fp( f ),
+   owned( false )
+{
+}
+
+RtfFileSink::~RtfFileSink()
+{
+    close();
+}
+
+bool RtfFileSink::write( const void* data, size_t size )
+{
+    if ( fp == NULL )
+        return false;
+
+    if ( fwrite( data, 1, size, fp ) < size )
+        return false;
+
+    return true;
+}
+
+bool RtfFileSink::flush()
+{
+    if ( fp == NULL )
+        return false;
+
+    return ( fflush( fp ) == 0 );
+}
+
+bool RtfFileSink::close()
+{
+    bool result = true;
+
+    if ( fp != NULL )
+    {
+        if ( owned == true )
+        {
+            if ( fclose( fp ) != 0 )
+                result = false;
+        }
+        else
+        {
+            if ( fflush( fp ) != 0 )
+                result = false;
+        }
+
+        fp = NULL;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfMemorySink::RtfMemorySink( size_t reserve )
+ : buffer( NULL ),
+   length( 0 ),
+   capacity( 0 )
+{
+    if ( reserve > 0 )
+    {
+        buffer = (char*)malloc( reserve );
+
+        if ( buffer != NULL )
+            capacity = reserve;
+    }
+}
+
+RtfMemorySink::~RtfMemorySink()
+{
+    if ( buffer != NULL )
+        free( buffer );
+}
+
+bool RtfMemorySink::write( const void* data, size_t size )
+{
+    if ( length + size > capacity )
+    {
+        size_t newcap = ( capacity > 0 ) ? capacity * 2 : 4096;
+
+        while ( newcap < length + size )
+            newcap *= 2;
+
+        char* newbuff = (char*)realloc( buffer, newcap );
+
+        if ( newbuff == NULL )
+            return false;
+
+        buffer   = newbuff;
+        capacity = newcap;
+    }
+
+    memcpy( buffer + length, data, size );
+    length += size;
+
+    return true;
+}
+
+char* RtfMemorySink::detach( size_t* size )
+{
+    char* result = buffer;
+
+    if ( size != NULL )
+        *size = length;
+
+    buffer   = NULL;
+    length   = 0;
+    capacity = 0;
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfSpoolSink::RtfSpoolSink( size_t l )
+ : file( NULL ),
+   length( 0 ),
+   limit( l )
+{
+}
+
+RtfSpoolSink::~RtfSpoolSink()
+{
+    // Temporary file is removed when closed
+    if ( file != NULL )
+        fclose( file );
+}
+
+bool RtfSpoolSink::write( const void* data, size_t size )
+{
+    if ( ( file == NULL ) && ( memory.size() + size <= limit ) )
+    {
+        if ( memory.write( data, size ) == false )
+            return false;
+
+        length += size;
+
+        return true;
+    }
+
+    // Over limit, rest goes to temporary file
+    if ( file == NULL )
+    {
+        file = tmpfile();
+
+        if ( file == NULL )
+            return false;
+    }
+
+    if ( fwrite( data, 1, size, file ) < size )
+        return false;
+
+    length += size;
+
+    return true;
+}
+
+bool RtfSpoolSink::copy_to( RtfSink* sink )
+{
+    if ( sink == NULL )
+        return false;
+
+    if ( ( memory.size() > 0 ) && ( sink->write( memory.data(), memory.size() ) == false ) )
+        return false;
+
+    if ( file == NULL )
+        return true;
+
+    if ( ( fflush( file ) != 0 ) || ( fseek( file, 0, SEEK_SET ) != 0 ) )
+        return false;
+
+    char   block[65536];
+    size_t readsize = 0;
+
+    while ( ( readsize = fread( block, 1, sizeof(block), file ) ) > 0 )
+    {
+        if ( sink->write( block, readsize ) == false )
+            return false;
+    }
+
+    return ( ferror( file ) == 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfFdSink::RtfFdSink( int f, bool own )
+ : fd( f ),
+   owned( own )
+{
+}
+
+RtfFdSink::~RtfFdSink()
+{
+    close();
+}
+
+bool RtfFdSink::write( const void* data, size_t size )
+{
+    if ( fd < 0 )
+        return false;
+
+    const char* ptr = (const char*)data;
+
+    while ( size > 0 )
+    {
+#ifdef _WIN32
+        int wr = _write( fd, ptr, (unsigned)size );
+#else
+        ssize_t wr = ::write( fd, ptr, size );
+#endif
+        if ( wr < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+
+            return false;
+        }
+
+        ptr  += wr;
+        size -= wr;
+    }
+
+    return true;
+}
+
+bool RtfFdSink::writev( const RTF_IOVEC* iov, int count )
+{
+#ifdef _WIN32
+    return RtfSink::writev( iov, count );
+#else
+    if ( fd < 0 )
+        return false;
+
+    // Write everything with one syscall, finish partial writes block by block
+    struct iovec vec[8];
+    int          vecs = 0;
+    size_t       total = 0;
+
+    if ( count > 8 )
+        return RtfSink::writev( iov, count );
+
+    for ( int cnt=0; cnt<count; cnt++ )
+    {
+        if ( iov[cnt].size == 0 )
+            continue;
+
+        vec[vecs].iov_base = (void*)iov[cnt].base;
+        vec[vecs].iov_len  = iov[cnt].size;
+        total += iov[cnt].size;
+        vecs++;
+    }
+
+    if ( vecs == 0 )
+        return true;
+
+    ssize_t wr = -1;
+
+    do
+    {
+        wr = ::writev( fd, vec, vecs );
+    }
+    while ( ( wr < 0 ) && ( errno == EINTR ) );
+
+    if ( wr < 0 )
+        return false;
+
+    if ( (size_t)wr == total )
+        return true;
+
+    // Partial write
+    for ( int cnt=0; cnt<vecs; cnt++ )
+    {
+        size_t vl = vec[cnt].iov_len;
+
+        if ( (size_t)wr >= vl )
+        {
+            wr -= vl;
+            continue;
+        }
+
+        if ( write( (const char*)vec[cnt].iov_base + wr, vl - wr ) == false )
+            return false;
+
+        wr = 0;
+    }
+
+    return true;
+#endif
+}
+
+bool RtfFdSink::close()
+{
+    bool result = true;
+
+    if ( ( fd >= 0 ) && ( owned == true ) )
+    {
+#ifdef _WIN32
+        if ( _close( fd ) != 0 )
+#else
+        if ( ::close( fd ) != 0 )
+#endif
+            result = false;
+    }
+
+    fd = -1;
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+RtfCallbackSink::RtfCallbackSink( RTF_WRITE_CALLBACK cb, void* p )
+ : callback( cb ),
+   param( p )
+{
+}
+
+bool RtfCallbackSink::write( const void* data, size_t size )
+{
+    if ( callback == NULL )
+        return false;
+
+    return callback( data, size, param );
+}
@@ -0,0 +1,213 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#ifdef _WIN32
+    #include <io.h>
+    #define NULL_DEVICE     "NUL"
+#else
+    #include <unistd.h>
+    #define NULL_DEVICE     "/dev/null"
+#endif
+
+#include "librtf.h"
+
+using namespace librtf;
+
+// Allocations counted while counting is on
+static volatile bool   counting = false;
+static volatile size_t allocations = 0;
+
+static inline void count_allocation()
+{
+    if ( counting == true )
+        allocations++;
+}
+
+// glibc: count malloc family too, library C code allocates with it
+#ifdef __GLIBC__
+extern "C"
+{
+    void* __libc_malloc( size_t size );
+    void* __libc_calloc( size_t count, size_t size );
+    void* __libc_realloc( void* ptr, size_t size );
+
+    void* malloc( size_t size )
+    {
+        count_allocation();
+        return __libc_malloc( size );
+    }
+
+    void* calloc( size_t count, size_t size )
+    {
+        count_allocation();
+        return __libc_calloc( count, size );
+    }
+
+    void* realloc( void* ptr, size_t size )
+    {
+        count_allocation();
+        return __libc_realloc( ptr, size );
+    }
+}
+#endif
+
+void* operator new( size_t size )
+{
+    count_allocation();
+
+    void* ptr = malloc( size > 0 ? size : 1 );
+
+    if ( ptr == NULL )
+        throw std::bad_alloc();
+
+    return ptr;
+}
+
+void* operator new[]( size_t size )
+{
+    return operator new( size );
+}
+
+void operator delete( void* ptr ) noexcept
+{
+    free( ptr );
+}
+
+void operator delete[]( void* ptr ) noexcept
+{
+    free( ptr );
+}
+
+void operator delete( void* ptr, size_t ) noexcept
+{
+    free( ptr );
+}
+
+void operator delete[]( void* ptr, size_t ) noexcept
+{
+    free( ptr );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const char* texts[] =
+{
+    "Short paragraph.",
+    "Paragraph text of an ordinary length, with some words and {braces}.",
+    "Tab\tand\nnewline, escaped when escaping is on."
+};
+
+// Writes paragraphs the way a report does, through every paragraph path
+static void write_paragraphs( RtfDocument& doc, const RtfParagraphHandle& handle,
+                              const RtfTableSchema& schema, int paragraphs )
+{
+    RTF_PARAGRAPH_FORMAT* pf = doc.get_paragraphformat();
+    RtfTableWriter        writer( &doc, &schema );
+
+    for ( int cnt=0; cnt<paragraphs; cnt++ )
+    {
+        const char* text = texts[ cnt % 3 ];
+
+        switch ( cnt % 8 )
+        {
+            case 4:
+                doc.start_tablerow();
+                doc.start_tablecell( 3000 );
+                doc.start_tablecell( 5000 );
+                pf->tableText = true;
+                doc.start_paragraph( text, false );
+                doc.end_tablecell();
+                doc.start_paragraph( text, false );
+                doc.end_tablecell();
+                pf->tableText = false;
+                doc.end_tablerow();
+                break;
+
+            case 5:
+                doc.write_paragraph( handle, text, true );
+                break;
+
+            case 6:
+                doc.write_double( handle, cnt * 0.25, NULL, true );
+                break;
+
+            case 7:
+                writer.write_cell( text );
+                writer.write_fixed( cnt, 2 );
+                writer.end_row();
+                break;
+
+            default:
+                pf->CHARACTER.boldCharacter = ( ( cnt % 3 ) == 0 );
+                doc.start_paragraph( text, true );
+                break;
+        }
+    }
+}
+
+// Runs paragraphs with given options, returns allocations of steady state
+static size_t run( bool delta, bool escape, bool utf8, int paragraphs )
+{
+    int fd = open( NULL_DEVICE, O_WRONLY );
+    if ( fd < 0 )
+        return (size_t)-1;
+
+    RtfFdSink   sink( fd, true );
+    RtfDocument doc;
+
+    doc.open( &sink );
+    doc.set_deltaformat( delta );
+    doc.set_textescaping( escape );
+    doc.set_utf8text( utf8 );
+
+    RTF_PARAGRAPH_FORMAT pf;
+    memcpy( &pf, doc.get_paragraphformat(), sizeof(RTF_PARAGRAPH_FORMAT) );
+
+    RtfParagraphHandle handle( &pf );
+    RtfTableSchema     schema( doc.get_tablerowformat() );
+
+    schema.add_column( 3000, doc.get_tablecellformat(), &pf );
+    schema.add_column( 2000, doc.get_tablecellformat(), &pf );
+
+    // Warm up, text buffer grows to longest text
+    write_paragraphs( doc, handle, schema, 64 );
+
+    allocations = 0;
+    counting = true;
+    write_paragraphs( doc, handle, schema, paragraphs );
+    counting = false;
+
+    doc.close();
+
+    return allocations;
+}
+
+int main( int argc, char** argv )
+{
+    int paragraphs = 1000000;
+    int failed = 0;
+
+    if ( argc > 1 )
+        paragraphs = atoi( argv[1] );
+
+    for ( int mode=0; mode<4; mode++ )
+    {
+        bool   delta  = ( mode == 1 );
+        bool   escape = ( mode == 2 );
+        bool   utf8   = ( mode == 3 );
+        size_t count  = run( delta, escape, utf8, paragraphs );
+
+        printf( "%d paragraphs, delta %d, escape %d, utf8 %d : %zu allocations\n",
+                paragraphs, delta, escape, utf8, count );
+
+        if ( count != 0 )
+            failed++;
+    }
+
+    printf( failed ? "FAILED\n" : "OK\n" );
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,1128 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#ifdef _WIN32
+    #include <io.h>
+    #define NULL_DEVICE     "NUL"
+#else
+    #include <unistd.h>
+    #include <sys/resource.h>
+    #define NULL_DEVICE     "/dev/null"
+#endif
+
+#include "librtf.h"
+
+using namespace librtf;
+
+// Counts sink calls, passes data to another sink
+class CountingSink : public RtfSink
+{
+    public:
+        CountingSink( RtfSink* s ) : sink( s ), calls( 0 ), bytes( 0 ) {}
+
+    public:
+        bool write( const void* data, size_t size )
+        {
+            calls++;
+            bytes += size;
+            return sink->write( data, size );
+        }
+
+        bool writev( const RTF_IOVEC* iov, int count )
+        {
+            calls++;
+            for ( int cnt=0; cnt<count; cnt++ )
+                bytes += iov[cnt].size;
+            return sink->writev( iov, count );
+        }
+
+        bool close() { return sink->close(); }
+
+    public:
+        RtfSink*    sink;
+        size_t      calls;
+        size_t      bytes;
+};
+
+static double elapsed_ms( std::chrono::steady_clock::time_point start )
+{
+    std::chrono::duration<double, std::milli> d = std::chrono::steady_clock::now() - start;
+    return d.count();
+}
+
+// Writes a paragraph and table heavy report
+static void build_report( RtfDocument& doc, int paragraphs )
+{
+    RTF_PARAGRAPH_FORMAT* pf = doc.get_paragraphformat();
+    RTF_TABLECELL_FORMAT* cf = doc.get_tablecellformat();
+
+    for ( int cnt=0; cnt<paragraphs; cnt++ )
+    {
+        if ( ( cnt % 10 ) == 9 )
+        {
+            cf->borderBottom.border = true;
+            cf->borderTop.border = true;
+
+            doc.start_tablerow();
+            doc.start_tablecell( 3000 );
+            doc.start_tablecell( 6000 );
+            pf->tableText = true;
+            doc.start_paragraph( "Cell text, first column", false );
+            doc.end_tablecell();
+            doc.start_paragraph( "Cell text, second column", false );
+            doc.end_tablecell();
+            pf->tableText = false;
+            doc.end_tablerow();
+        }
+        else
+        {
+            pf->CHARACTER.boldCharacter = ( ( cnt % 3 ) == 0 );
+            doc.start_paragraph( "Report paragraph text of an ordinary length, with some words.", true );
+        }
+    }
+}
+
+// Compares unbuffered (one sink call per fragment) and buffered output
+static void bench_output( int paragraphs )
+{
+    printf( "== output buffering, %d paragraphs\n", paragraphs );
+
+    size_t bufsizes[] = { 0, 4096, RTF_DEFAULT_BUFFERSIZE, 1024*1024 };
+
+    for ( size_t cnt=0; cnt<sizeof(bufsizes)/sizeof(size_t); cnt++ )
+    {
+        int fd = open( NULL_DEVICE, O_WRONLY );
+        if ( fd < 0 )
+            return;
+
+        RtfFdSink    fdsink( fd, true );
+        CountingSink sink( &fdsink );
+        RtfDocument  doc;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        doc.open( &sink );
+        doc.set_buffersize( bufsizes[cnt] );
+        build_report( doc, paragraphs );
+        doc.close();
+
+        double ms = elapsed_ms( start );
+
+        printf( "buffer %8zu : %9zu sink writes, %10zu bytes, %8.2f ms, %7.1f MB/s\n",
+                bufsizes[cnt], sink.calls, sink.bytes, ms,
+                ( sink.bytes / ( 1024.0 * 1024.0 ) ) / ( ms / 1000.0 ) );
+    }
+}
+
+// Compares full and delta paragraph formatting
+static void bench_delta( int paragraphs )
+{
+    printf( "== delta formatting, %d paragraphs\n", paragraphs );
+
+    for ( int delta=0; delta<2; delta++ )
+    {
+        RtfMemorySink sink;
+        RtfDocument   doc;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        doc.open( &sink );
+        doc.set_deltaformat( delta == 1 );
+        build_report( doc, paragraphs );
+        doc.close();
+
+        double ms = elapsed_ms( start );
+
+        printf( "%-6s : %10zu bytes, %8.2f ms, %9.0f paragraphs/s\n",
+                delta ? "delta" : "full", sink.size(), ms,
+                paragraphs / ( ms / 1000.0 ) );
+    }
+}
+
+// Compares inline and stylesheet formatting of identically styled paragraphs
+static void bench_styles( int paragraphs )
+{
+    printf( "== stylesheet, %d paragraphs\n", paragraphs );
+
+    for ( int styled=0; styled<2; styled++ )
+    {
+        RtfMemorySink sink;
+        RtfDocument   doc;
+
+        RTF_PARAGRAPH_FORMAT body;
+        doc.init();
+        memcpy( &body, doc.get_paragraphformat(), sizeof(RTF_PARAGRAPH_FORMAT) );
+        body.paragraphAligment = RTF_PARAGRAPHALIGN_JUSTIFY;
+        body.spaceAfter = 120;
+        body.CHARACTER.fontNumber = 1;
+        body.CHARACTER.fontSize = 20;
+
+        int style = -1;
+        if ( styled == 1 )
+            style = doc.add_paragraphstyle( "Body Text", &body );
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        doc.open( &sink );
+        doc.set_paragraphformat( &body );
+        doc.set_paragraphstyle( style );
+
+        for ( int cnt=0; cnt<paragraphs; cnt++ )
+            doc.start_paragraph( "Styled paragraph text of an ordinary length, with some words.", true );
+
+        doc.close();
+
+        double ms = elapsed_ms( start );
+
+        printf( "%-6s : %10zu bytes, %8.2f ms, %9.0f paragraphs/s\n",
+                styled ? "styled" : "inline", sink.size(), ms,
+                paragraphs / ( ms / 1000.0 ) );
+    }
+}
+
+// Compares per paragraph formatting and precompiled format handle
+static void bench_handle( int paragraphs )
+{
+    printf( "== precompiled format, %d paragraphs\n", paragraphs );
+
+    for ( int compiled=0; compiled<2; compiled++ )
+    {
+        RtfMemorySink sink;
+        RtfDocument   doc;
+
+        RTF_PARAGRAPH_FORMAT body;
+        doc.init();
+        memcpy( &body, doc.get_paragraphformat(), sizeof(RTF_PARAGRAPH_FORMAT) );
+        body.paragraphAligment = RTF_PARAGRAPHALIGN_JUSTIFY;
+        body.spaceAfter = 120;
+        body.CHARACTER.fontNumber = 1;
+        body.CHARACTER.fontSize = 20;
+
+        RtfParagraphHandle handle( &body );
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        doc.open( &sink );
+        doc.set_paragraphformat( &body );
+
+        for ( int cnt=0; cnt<paragraphs; cnt++ )
+        {
+            if ( compiled == 1 )
+                doc.write_paragraph( handle, "Body paragraph text of an ordinary length, with some words.", true );
+            else
+                doc.start_paragraph( "Body paragraph text of an ordinary length, with some words.", true );
+        }
+
+        doc.close();
+
+        double ms = elapsed_ms( start );
+
+        printf( "%-8s : %10zu bytes, %8.2f ms, %9.0f paragraphs/s\n",
+                compiled ? "compiled" : "format", sink.size(), ms,
+                paragraphs / ( ms / 1000.0 ) );
+    }
+}
+
+// Compares table written cell by cell, with row definition frozen from
+// first row and with one write_table() call
+static void bench_table( int rows )
+{
+    const int columns = 4;
+    const int widths[columns] = { 2000, 3000, 1500, 1500 };
+
+    printf( "== bulk table, %d rows of %d columns\n", rows, columns );
+
+    // Row-major cell texts
+    std::vector<std::string>  texts( (size_t)rows * columns );
+    std::vector<RTF_TEXTSPAN> cells( texts.size() );
+
+    for ( size_t cnt=0; cnt<texts.size(); cnt++ )
+    {
+        char tmp[64];
+        snprintf( tmp, sizeof(tmp), "Item %d, column %d", (int)( cnt / columns ), (int)( cnt % columns ) );
+        texts[cnt] = tmp;
+        cells[cnt].text = texts[cnt].data();
+        cells[cnt].length = texts[cnt].size();
+    }
+
+    const char* modes[3] = { "cells", "template", "bulk" };
+    size_t      written[3] = { 0, 0, 0 };
+
+    for ( int mode=0; mode<3; mode++ )
+    {
+        RtfMemorySink sink( 128 * (size_t)rows * columns );
+        RtfDocument   doc;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        doc.open( &sink );
+        doc.get_tablecellformat()->borderBottom.border = true;
+
+        RTF_PARAGRAPH_FORMAT cellpf;
+        memcpy( &cellpf, doc.get_paragraphformat(), sizeof(RTF_PARAGRAPH_FORMAT) );
+        cellpf.tableText = true;
+
+        RtfTableSchema schema( doc.get_tablerowformat() );
+
+        for ( int col=0; col<columns; col++ )
+            schema.add_column( widths[col], doc.get_tablecellformat(), &cellpf );
+
+        if ( mode == 2 )
+        {
+            doc.write_table( schema, cells.data(), rows );
+        }
+        else
+        {
+            RtfRowTemplate frozen( NULL );
+
+            doc.set_paragraphformat( &cellpf );
+
+            for ( int row=0; row<rows; row++ )
+            {
+                if ( ( mode == 1 ) && ( row > 0 ) )
+                {
+                    doc.start_tablerow( frozen );
+                }
+                else
+                {
+                    int right = 0;
+
+                    doc.start_tablerow();
+
+                    for ( int col=0; col<columns; col++ )
+                    {
+                        right += widths[col];
+                        doc.start_tablecell( right );
+                    }
+
+                    if ( mode == 1 )
+                        frozen = doc.freeze_tablerow();
+                }
+
+                for ( int col=0; col<columns; col++ )
+                {
+                    doc.start_paragraph( texts[ (size_t)row * columns + col ].c_str(), false );
+                    doc.end_tablecell();
+                }
+
+                doc.end_tablerow();
+            }
+        }
+
+        doc.close();
+
+        double ms = elapsed_ms( start );
+
+        written[mode] = sink.size();
+
+        printf( "%-8s : %10zu bytes, %8.2f ms, %9.0f rows/s\n",
+                modes[mode], sink.size(), ms, rows / ( ms / 1000.0 ) );
+    }
+
+    if ( ( written[0] != written[1] ) || ( written[0] != written[2] ) )
+        printf( "table sizes differ from cell by cell table\n" );
+}
+
+// Gets peak resident set size in KB, 0 if unknown
+static long peak_rss_kb()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage ru;
+
+    if ( getrusage( RUSAGE_SELF, &ru ) != 0 )
+        return 0;
+
+    return ru.ru_maxrss;
+#endif
+}
+
+// Streams a large table to null device, memory must not grow with rows
+static void bench_streamtable( int rows )
+{
+    printf( "== streaming table, %d rows\n", rows );
+
+    int fd = open( NULL_DEVICE, O_WRONLY );
+    if ( fd < 0 )
+        return;
+
+    RtfFdSink   sink( fd, true );
+    RtfDocument doc;
+
+    long rss = peak_rss_kb();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    doc.open( &sink );
+
+    RTF_PARAGRAPH_FORMAT cellpf;
+    memcpy( &cellpf, doc.get_paragraphformat(), sizeof(RTF_PARAGRAPH_FORMAT) );
+
+    RtfTableSchema schema( doc.get_tablerowformat() );
+    schema.add_column( 1500, doc.get_tablecellformat(), &cellpf );
+    schema.add_column( 4000, doc.get_tablecellformat(), &cellpf );
+    schema.add_column( 2000, doc.get_tablecellformat(), &cellpf );
+
+    RtfTableWriter writer( &doc, &schema );
+    char           number[16];
+
+    for ( int row=0; row<rows; row++ )
+    {
+        char* p = number + sizeof(number);
+        int   id = row;
+
+        do
+        {
+            *--p = (char)( '0' + id % 10 );
+            id /= 10;
+        }
+        while ( id != 0 );
+
+        writer.write_cell( p, number + sizeof(number) - p );
+        writer.write_cell( "Ledger entry description" );
+        writer.write_cell( "1,234.56" );
+        writer.end_row();
+    }
+
+    doc.close();
+
+    double ms = elapsed_ms( start );
+
+    printf( "rows     : %10zu rows, %8.2f ms, %9.0f rows/s\n",
+            writer.get_rows(), ms, rows / ( ms / 1000.0 ) );
+    printf( "memory   : %10zu bytes buffered at most, peak RSS %ld KB before, %ld KB after\n",
+            writer.get_highwater(), rss, peak_rss_kb() );
+}
+
+// Compares numeric cells formatted by snprintf() and by number API
+static void bench_numbers( int rows )
+{
+    const int columns = 4;
+
+    printf( "== numeric cells, %d rows of %d columns\n", rows, columns );
+
+    std::vector<double> values( (size_t)rows * columns );
+
+    for ( size_t cnt=0; cnt<values.size(); cnt++ )
+        values[cnt] = (double)( ( cnt * 7919 ) % 10000000 ) / 100.0 - 20000.0;
+
+    const char*       modes[3] = { "snprintf", "double", "fixed" };
+    RTF_NUMBER_FORMAT nf = { 2, '.', ',' };
+
+    for ( int mode=0; mode<3; mode++ )
+    {
+        RtfMemorySink sink( 256 * (size_t)rows * columns );
+        RtfDocument   doc;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        doc.open( &sink );
+
+        // Numbers line up at a decimal tab stop
+        RTF_PARAGRAPH_FORMAT cellpf;
+        memcpy( &cellpf, doc.get_paragraphformat(), sizeof(RTF_PARAGRAPH_FORMAT) );
+        cellpf.paragraphTabs = true;
+        cellpf.TABS.tabKind = RTF_PARAGRAPHTABKIND_DECIMAL;
+        cellpf.TABS.tabPosition = 1200;
+
+        RtfTableSchema schema( doc.get_tablerowformat() );
+
+        for ( int col=0; col<columns; col++ )
+            schema.add_column( 2000, doc.get_tablecellformat(), &cellpf );
+
+        RtfTableWriter writer( &doc, &schema );
+        const double*  value = values.data();
+
+        for ( int row=0; row<rows; row++ )
+        {
+            for ( int col=0; col<columns; col++, value++ )
+            {
+                if ( mode == 0 )
+                {
+                    char tmp[64];
+                    int  len = snprintf( tmp, sizeof(tmp), "%.2f", *value );
+
+                    writer.write_number( tmp, len );
+                }
+                else if ( mode == 1 )
+                {
+                    writer.write_double( *value, &nf );
+                }
+                else
+                {
+                    writer.write_fixed( (long long)( *value * 100.0 ), 2, &nf );
+                }
+            }
+
+            writer.end_row();
+        }
+
+        doc.close();
+
+        double ms = elapsed_ms( start );
+
+        printf( "%-8s : %10zu bytes, %8.2f ms, %9.0f cells/s\n",
+                modes[mode], sink.size(), ms, rows * columns / ( ms / 1000.0 ) );
+    }
+}
+
+// Paragraphs in rotating fonts and colors, numbers from font() and
+// color() lookups or from fixed tables given to open(). Deferred
+// document also spools body and copies it after header at close().
+static void bench_registry( int paragraphs )
+{
+    printf( "== font and color registry, %d paragraphs\n", paragraphs );
+
+    static const char* fonts[4] = { "Arial", "Courier New", "Georgia", "Verdana" };
+    static const int   colors[3][3] = { { 255, 0, 0 }, { 0, 128, 0 }, { 0, 0, 255 } };
+
+    const char* modes[2] = { "fixed", "deferred" };
+
+    for ( int mode=0; mode<2; mode++ )
+    {
+        RtfMemorySink sink( 128 * (size_t)paragraphs );
+        RtfDocument   doc;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        if ( mode == 0 )
+            doc.open( &sink, "Times New Roman;Arial;Courier New;Georgia;Verdana",
+                      "0;0;0;255;0;0;0;128;0;0;0;255" );
+        else
+            doc.open_deferred( &sink );
+
+        RTF_PARAGRAPH_FORMAT* pf = doc.get_paragraphformat();
+
+        for ( int cnt=0; cnt<paragraphs; cnt++ )
+        {
+            const int* rgb = colors[ cnt % 3 ];
+
+            if ( mode == 0 )
+            {
+                pf->CHARACTER.fontNumber = 1 + cnt % 4;
+                pf->CHARACTER.foregroundColor = 1 + cnt % 3;
+            }
+            else
+            {
+                pf->CHARACTER.fontNumber = doc.font( fonts[ cnt % 4 ] );
+                pf->CHARACTER.foregroundColor = doc.color( rgb[0], rgb[1], rgb[2] );
+            }
+
+            doc.start_paragraph( "Paragraph in one of the document fonts.", true );
+        }
+
+        doc.close();
+
+        double ms = elapsed_ms( start );
+
+        printf( "%-8s : %10zu bytes, %8.2f ms, %9.0f paragraphs/s\n",
+                modes[mode], sink.size(), ms, paragraphs / ( ms / 1000.0 ) );
+    }
+}
+
+// Many small documents opened by open() or from a precompiled prologue
+static void bench_prologue( int documents )
+{
+    printf( "== document prologue, %d documents of 3 paragraphs\n", documents );
+
+    const char* fonts = "Arial;Courier New;Georgia";
+    const char* colors = "0;0;0;255;0;0;0;0;255";
+
+    RtfPrologue prologue( fonts, colors );
+
+    const char* modes[2] = { "open", "prologue" };
+    std::string outputs[2];
+
+    for ( int mode=0; mode<2; mode++ )
+    {
+        RtfMemorySink sink( 4096 );
+        RtfDocument   doc;
+        size_t        bytes = 0;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for ( int cnt=0; cnt<documents; cnt++ )
+        {
+            sink.clear();
+
+            if ( mode == 0 )
+                doc.open( &sink, fonts, colors );
+            else
+                doc.open( &sink, prologue );
+
+            doc.start_paragraph( "Dear customer,", true );
+            doc.start_paragraph( "Your order has been shipped.", true );
+            doc.start_paragraph( "Regards", true );
+            doc.close();
+
+            bytes += sink.size();
+        }
+
+        double ms = elapsed_ms( start );
+
+        outputs[mode].assign( sink.data(), sink.size() );
+
+        printf( "%-8s : %10zu bytes, %8.2f ms, %9.0f documents/s\n",
+                modes[mode], bytes, ms, documents / ( ms / 1000.0 ) );
+    }
+
+    printf( "same output : %s\n", ( outputs[0] == outputs[1] ) ? "yes" : "no" );
+}
+
+// Writes letter pages with fields name, street, city and amount
+static void write_letter( RtfDocument& doc, int pages, const char* const* fields )
+{
+    char line[256];
+
+    for ( int page=0; page<pages; page++ )
+    {
+        snprintf( line, sizeof(line), "Dear %s,", fields[0] );
+        doc.start_paragraph( line, true );
+
+        for ( int cnt=0; cnt<24; cnt++ )
+        {
+            if ( ( cnt % 6 ) == 0 )
+            {
+                snprintf( line, sizeof(line), "Shipping to %s, %s. Amount due %s.",
+                          fields[1], fields[2], fields[3] );
+                doc.start_paragraph( line, true );
+            }
+            else
+            {
+                doc.start_paragraph( "Static paragraph text of the letter, the same for every customer.", true );
+            }
+        }
+    }
+}
+
+// Mail merge of 1 and 20 page letters, regenerated or merged from template
+static void bench_merge( int documents )
+{
+    static const char* names[4] = { "name", "street", "city", "amount" };
+    static const char* placeholders[4] = { "{{name}}", "{{street}}", "{{city}}", "{{amount}}" };
+    static const char* values[4] = { "Jane {Doe}", "12 Main Street", "Springfield", "1,024.50" };
+
+    RTF_TEXTSPAN spans[4];
+
+    for ( int pages=1; pages<=20; pages+=19 )
+    {
+        int count = documents / pages;
+
+        printf( "== mail merge, %d documents of %d pages\n", count, pages );
+
+        // Template is a letter written with placeholders
+        RtfMemorySink    source;
+        RtfDocument      doc;
+        RtfMergeTemplate letter;
+
+        doc.open( &source );
+        doc.set_textescaping( true );
+        write_letter( doc, pages, placeholders );
+        doc.close();
+
+        letter.load( source.data(), source.size() );
+
+        for ( int cnt=0; cnt<4; cnt++ )
+        {
+            int field = letter.get_field( names[cnt] );
+
+            spans[field].text = values[cnt];
+            spans[field].length = strlen( values[cnt] );
+        }
+
+        const char* modes[2] = { "paragraph", "merge" };
+        std::string outputs[2];
+
+        for ( int mode=0; mode<2; mode++ )
+        {
+            RtfMemorySink sink( source.size() * 2 );
+            RtfBuffer     out;
+            size_t        bytes = 0;
+
+            out.set_sink( &sink );
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for ( int cnt=0; cnt<count; cnt++ )
+            {
+                sink.clear();
+
+                if ( mode == 0 )
+                {
+                    doc.open( &sink );
+                    doc.set_textescaping( true );
+                    write_letter( doc, pages, values );
+                    doc.close();
+                }
+                else
+                {
+                    letter.merge( out, spans );
+                    out.flush();
+                }
+
+                bytes += sink.size();
+            }
+
+            double ms = elapsed_ms( start );
+
+            outputs[mode].assign( sink.data(), sink.size() );
+
+            printf( "%-9s : %10zu bytes, %8.2f ms, %9.0f documents/s\n",
+                    modes[mode], bytes, ms, count / ( ms / 1000.0 ) );
+        }
+
+        printf( "same output : %s\n", ( outputs[0] == outputs[1] ) ? "yes" : "no" );
+    }
+}
+
+// Batch job, a 50 paragraph document
+static bool render_batchjob( RtfDocument* doc, size_t index, void* param )
+{
+    char line[128];
+
+    for ( int cnt=0; cnt<50; cnt++ )
+    {
+        snprintf( line, sizeof(line), "Document %zu, paragraph %d of the batch.", index, cnt );
+
+        if ( doc->start_paragraph( line, true ) != RTF_SUCCESS )
+            return false;
+    }
+
+    return true;
+}
+
+// Memory sink of each worker thread, reused for all its jobs
+static RtfSink* create_batchsink( size_t index, void* param )
+{
+    static thread_local RtfMemorySink sink;
+
+    sink.clear();
+
+    return &sink;
+}
+
+// Adds job output size to batch total
+static void release_batchsink( RtfSink* sink, size_t index, bool failed, void* param )
+{
+    ( (std::atomic<size_t>*)param )->fetch_add( ( (RtfMemorySink*)sink )->size() );
+}
+
+// Batch renderer scaling over worker counts
+static void bench_batch( int documents )
+{
+    unsigned int cpus = std::thread::hardware_concurrency();
+
+    printf( "== batch render, %d documents, %u CPUs\n", documents, cpus );
+
+    RtfPrologue prologue;
+    double      basems = 0;
+
+    for ( unsigned int threads=1; ( threads <= 2 ) || ( threads <= cpus ); threads*=2 )
+    {
+        RtfBatchRenderer    renderer( threads );
+        std::atomic<size_t> bytes( 0 );
+
+        renderer.set_prologue( &prologue );
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        renderer.render_batch( documents, render_batchjob, create_batchsink,
+                               release_batchsink, &bytes );
+
+        double ms = elapsed_ms( start );
+
+        if ( threads == 1 )
+            basems = ms;
+
+        printf( "%2u threads : %10zu bytes, %8.2f ms, %9.0f documents/s, %5.2fx, %zu stolen, %zu failed\n",
+                threads, bytes.load(), ms, documents / ( ms / 1000.0 ), basems / ms,
+                renderer.get_stolen(), renderer.get_failed() );
+    }
+}
+
+// Writes a bench section of paragraphs
+static bool render_section( RtfDocument* doc, size_t index, void* param )
+{
+    int  paragraphs = *(int*)param;
+    char title[64];
+
+    snprintf( title, sizeof(title), "Section %d", (int)index );
+
+    if ( index > 0 )
+        doc->start_section();
+
+    // Sections must not depend on formatting left by previous one
+    doc->get_paragraphformat()->CHARACTER.boldCharacter = false;
+    doc->start_paragraph( title, true );
+    build_report( *doc, paragraphs );
+
+    return true;
+}
+
+// Compares sections rendered one by one and by worker threads
+static void bench_fragments( int sections )
+{
+    int paragraphs = 200;
+
+    printf( "== parallel fragments, %d sections of %d paragraphs, %u CPUs\n",
+            sections, paragraphs, std::thread::hardware_concurrency() );
+
+    std::string serial;
+    double      serialms = 0;
+    int         threads[] = { 0, 1, 2, 4, 8 };
+
+    for ( size_t cnt=0; cnt<sizeof(threads)/sizeof(int); cnt++ )
+    {
+        RtfMemorySink sink;
+        RtfDocument   doc;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        doc.open( &sink );
+
+        if ( threads[cnt] == 0 )
+        {
+            for ( int sec=0; sec<sections; sec++ )
+                render_section( &doc, sec, &paragraphs );
+        }
+        else
+        {
+            RtfFragmentBuilder builder( threads[cnt] );
+            builder.build( &doc, sections, render_section, &paragraphs );
+        }
+
+        doc.close();
+
+        double ms = elapsed_ms( start );
+
+        if ( threads[cnt] == 0 )
+        {
+            serial.assign( sink.data(), sink.size() );
+            serialms = ms;
+            printf( "serial    : %10zu bytes, %8.2f ms\n", sink.size(), ms );
+            continue;
+        }
+
+        printf( "%d threads : %10zu bytes, %8.2f ms, %5.2fx%s\n",
+                threads[cnt], sink.size(), ms, serialms / ms,
+                ( serial.compare( 0, std::string::npos, sink.data(), sink.size() ) == 0 ) ?
+                "" : ", output differs" );
+    }
+}
+
+// Fills corpus by repeating a sample
+static void fill_corpus( std::string& corpus, const char* sample, size_t size )
+{
+    corpus.clear();
+
+    while ( corpus.size() < size )
+        corpus += sample;
+
+    corpus.resize( size );
+}
+
+// Measures text escaping throughput of every method
+static void bench_escape()
+{
+    printf( "== text escaping, fastest method %s\n",
+            get_escapemethodname( RTF_ESCAPE_AUTO ) );
+
+    const char* samples[] =
+    {
+        "Quarterly revenue grew by 12 percent over the previous period, "
+        "driven mostly by subscription renewals in the northern region.\n",
+        "{\"key\": \"C:\\path\\file\"}\tcaf\xe9 na\xefve r\xe9sum\xe9\n{a}{b}\\",
+    };
+    const char* names[] = { "ascii", "escape" };
+
+    std::string corpus;
+    size_t      size = 1024 * 1024;
+    int         passes = 256;
+
+    for ( int sc=0; sc<2; sc++ )
+    {
+        fill_corpus( corpus, samples[sc], size );
+
+        for ( int method=RTF_ESCAPE_SCALAR; method<=get_escapemethod(); method++ )
+        {
+            RtfBuffer out( size * 4 );
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for ( int cnt=0; cnt<passes; cnt++ )
+            {
+                out.clear();
+                put_escaped( out, corpus.data(), corpus.size(), method );
+            }
+
+            double ms = elapsed_ms( start );
+
+            printf( "%-6s %-6s : %10zu -> %10zu bytes, %6.2f GB/s\n",
+                    names[sc], get_escapemethodname( method ), corpus.size(),
+                    out.size(),
+                    ( (double)size * passes / ( 1024.0 * 1024.0 * 1024.0 ) ) / ( ms / 1000.0 ) );
+        }
+    }
+}
+
+// Measures UTF-8 text escaping throughput on ASCII and Unicode text
+static void bench_utf8()
+{
+    printf( "== UTF-8 escaping, method %s\n",
+            get_escapemethodname( RTF_ESCAPE_AUTO ) );
+
+    const char* samples[] =
+    {
+        "Quarterly revenue grew by 12 percent over the previous period.\n",
+        "\xd0\x92\xd1\x8b\xd1\x80\xd1\x83\xd1\x87\xd0\xba\xd0\xb0 "
+        "\xd0\xb2\xd1\x8b\xd1\x80\xd0\xbe\xd1\x81\xd0\xbb\xd0\xb0 12%.\n",
+        "\xe5\xa3\xb2\xe4\xb8\x8a\xe9\xab\x98\xe3\x81\xaf" "12%\xe5\xa2\x97"
+        "\xe5\x8a\xa0\xe3\x81\x97\xe3\x81\xbe\xe3\x81\x97\xe3\x81\x9f\xe3\x80\x82\n",
+        "\xf0\x9f\x93\x88 12% \xf0\x9f\x9a\x80\xf0\x9f\x8e\x89\n",
+    };
+    const char* names[] = { "ascii", "cyrillic", "cjk", "emoji" };
+
+    std::string corpus;
+    size_t      size = 1024 * 1024;
+    int         passes = 64;
+
+    for ( int sc=0; sc<4; sc++ )
+    {
+        fill_corpus( corpus, samples[sc], size );
+
+        RtfBuffer out( size * 8 );
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for ( int cnt=0; cnt<passes; cnt++ )
+        {
+            out.clear();
+            put_escapedutf8( out, corpus.data(), corpus.size() );
+        }
+
+        double ms = elapsed_ms( start );
+        double gb = ( (double)size * passes ) / ( 1024.0 * 1024.0 * 1024.0 );
+
+        printf( "%-8s : %10zu -> %10zu bytes, %6.2f GB/s in, %6.2f GB/s out\n",
+                names[sc], corpus.size(), out.size(), gb / ( ms / 1000.0 ),
+                gb * ( (double)out.size() / size ) / ( ms / 1000.0 ) );
+    }
+}
+
+// Tokenizes writer output with each delimiter scan method
+static void bench_tokenizer( int paragraphs )
+{
+    printf( "== tokenizer, fastest method %s\n", get_escapemethodname( RTF_ESCAPE_AUTO ) );
+
+    const char*   names[] = { "report", "text" };
+    RtfMemorySink sinks[2];
+    RtfDocument   doc;
+    int           passes = 20;
+
+    // Report of short paragraphs and tables, long escaped paragraphs
+    doc.open( &sinks[0] );
+    build_report( doc, paragraphs );
+    doc.close();
+
+    doc.open( &sinks[1] );
+    doc.set_textescaping( true );
+
+    for ( int cnt=0; cnt<paragraphs / 8; cnt++ )
+    {
+        doc.start_paragraph( "Quarterly revenue grew by 12 percent over the previous period, "
+                             "driven mostly by subscription renewals in the northern region "
+                             "and by {bundled} caf\xe9 services.\n"
+                             "Costs were flat, margins improved for the third period in a row.", true );
+    }
+
+    doc.close();
+
+    for ( int sc=0; sc<2; sc++ )
+    {
+        for ( int method=RTF_ESCAPE_SCALAR; method<=get_escapemethod(); method++ )
+        {
+            RtfTokenizer tokenizer( method );
+            RTF_TOKEN    token;
+            size_t       tokens = 0;
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for ( int cnt=0; cnt<passes; cnt++ )
+            {
+                tokenizer.reset();
+                tokenizer.set_data( sinks[sc].data(), sinks[sc].size() );
+
+                while ( tokenizer.next( token ) == true )
+                    tokens++;
+            }
+
+            double ms = elapsed_ms( start );
+
+            printf( "%-6s %-6s : %10zu bytes, %9zu tokens, %8.1f MB/s\n",
+                    names[sc], get_escapemethodname( method ), sinks[sc].size(),
+                    tokens / passes,
+                    ( (double)sinks[sc].size() * passes / ( 1024.0 * 1024.0 ) ) / ( ms / 1000.0 ) );
+        }
+    }
+}
+
+// Measures hex encoding throughput of every method, one line and wrapped
+static void bench_hex()
+{
+    printf( "== hex encoding, fastest method %s\n",
+            get_hexmethodname( RTF_HEX_AUTO ) );
+
+    size_t         size = 4 * 1024 * 1024;
+    int            passes = 32;
+    unsigned char* data = (unsigned char*)malloc( size );
+
+    if ( data == NULL )
+        return;
+
+    unsigned int seed = 12345;
+
+    for ( size_t cnt=0; cnt<size; cnt++ )
+    {
+        seed = seed * 1103515245 + 12345;
+        data[cnt] = (unsigned char)( seed >> 16 );
+    }
+
+    size_t widths[] = { 0, RTF_HEX_LINEWIDTH };
+
+    for ( size_t wd=0; wd<sizeof(widths)/sizeof(size_t); wd++ )
+    {
+        for ( int method=RTF_HEX_SCALAR; method<=get_hexmethod(); method++ )
+        {
+            RtfMemorySink sink( 2 * size + size / 32 );
+            RtfBuffer     out;
+
+            out.set_sink( &sink );
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for ( int cnt=0; cnt<passes; cnt++ )
+            {
+                sink.clear();
+                put_hex( out, data, size, widths[wd], method );
+                out.flush();
+            }
+
+            double ms = elapsed_ms( start );
+
+            printf( "width %3zu %-6s : %10zu -> %10zu bytes, %8.1f MB/s\n",
+                    widths[wd], get_hexmethodname( method ), size, sink.size(),
+                    ( (double)size * passes / ( 1024.0 * 1024.0 ) ) / ( ms / 1000.0 ) );
+        }
+    }
+
+    free( data );
+}
+
+// Writes a PNG file with a valid header and given payload size
+static bool write_testpng( const char* filename, size_t payload )
+{
+    static const unsigned char header[] =
+    {
+        0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A,
+        0, 0, 0, 13, 'I', 'H', 'D', 'R',
+        0, 0, 1, 0, 0, 0, 0, 128, 8, 2, 0, 0, 0,
+        0, 0, 0, 0,
+    };
+
+    FILE* fp = fopen( filename, "wb" );
+
+    if ( fp == NULL )
+        return false;
+
+    fwrite( header, 1, sizeof(header), fp );
+
+    for ( size_t cnt=0; cnt<payload; cnt++ )
+        fputc( (int)( ( cnt * 131 ) & 0xFF ), fp );
+
+    fclose( fp );
+
+    return true;
+}
+
+// Compares documents stamped with the same logo, with and without cache
+static void bench_imagecache( int documents )
+{
+    printf( "== image cache, %d documents with a 64 KB logo\n", documents );
+
+    const char* logo = "bench_logo.png";
+
+    if ( write_testpng( logo, 64 * 1024 ) == false )
+        return;
+
+    RtfImageCache cache;
+
+    for ( int cached=0; cached<2; cached++ )
+    {
+        RtfMemorySink sink;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for ( int cnt=0; cnt<documents; cnt++ )
+        {
+            RtfDocument doc;
+
+            sink.clear();
+            doc.set_imagecache( cached ? &cache : NULL );
+            doc.open( &sink );
+            doc.start_paragraph( "Invoice", true );
+            doc.load_image( logo, 100, 100 );
+            doc.start_paragraph( "Thank you for your order.", true );
+            doc.close();
+        }
+
+        double ms = elapsed_ms( start );
+
+        printf( "%-8s : %8.2f ms, %9.0f documents/s\n",
+                cached ? "cached" : "uncached", ms, documents / ( ms / 1000.0 ) );
+    }
+
+    RTF_IMAGECACHE_STATS stats;
+    cache.get_stats( &stats );
+
+    printf( "cache    : %zu hits, %zu misses, %zu entries, %zu bytes\n",
+            stats.hits, stats.misses, stats.entries, stats.bytes );
+
+    remove( logo );
+}
+
+int main( int argc, char** argv )
+{
+    int paragraphs = 200000;
+
+    if ( argc > 1 )
+        paragraphs = atoi( argv[1] );
+
+    // Runs first, so peak RSS is not of other benches
+    bench_streamtable( paragraphs * 50 );
+    bench_output( paragraphs );
+    bench_delta( paragraphs );
+    bench_styles( paragraphs );
+    bench_handle( paragraphs );
+    bench_table( paragraphs / 4 );
+    bench_numbers( paragraphs / 4 );
+    bench_registry( paragraphs );
+    bench_prologue( paragraphs / 2 );
+    bench_merge( paragraphs / 10 );
+    bench_fragments( paragraphs / 200 );
+    bench_batch( paragraphs / 10 );
+    bench_escape();
+    bench_utf8();
+    bench_tokenizer( paragraphs );
+    bench_hex();
+    bench_imagecache( paragraphs / 100 );
+
+    return 0;
+}
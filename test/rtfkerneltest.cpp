@@ -0,0 +1,354 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "librtf.h"
+
+using namespace librtf;
+
+static int failures = 0;
+
+// Counts failure, prints first ones
+static void fail( const char* what, const char* method, size_t detail )
+{
+    if ( failures < 10 )
+        printf( "  %s differs, method %s, case %zu\n", what, method, detail );
+
+    failures++;
+}
+
+// Small xorshift generator, same inputs on every run
+static unsigned int next_random()
+{
+    static unsigned int state = 0x2545F491;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return state;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Token with its text copied, data of streamed tokens does not last
+struct TestToken
+{
+    int         type;
+    std::string text;
+    int         param;
+    bool        hasParam;
+
+    bool operator==( const TestToken& other ) const
+    {
+        return ( type == other.type ) && ( text == other.text ) &&
+               ( param == other.param ) && ( hasParam == other.hasParam );
+    }
+};
+
+typedef std::vector<TestToken> TestTokens;
+
+// Adds token, text runs cut by data ends are joined again
+static void add_token( TestTokens& tokens, const RTF_TOKEN& token )
+{
+    if ( ( token.type == RTF_TOKEN_TEXT ) && ( tokens.empty() == false ) &&
+         ( tokens.back().type == RTF_TOKEN_TEXT ) )
+    {
+        tokens.back().text.append( token.text, token.length );
+        return;
+    }
+
+    TestToken copy;
+
+    copy.type     = token.type;
+    copy.text.assign( token.text, token.length );
+    copy.param    = token.param;
+    copy.hasParam = token.hasParam;
+
+    tokens.push_back( copy );
+}
+
+// Tokenizes data given in parts ending at cuts, unread rest of each part
+// is handed again with next one. Returns final group depth.
+static int tokenize_parts( const std::string& data, const std::vector<size_t>& cuts,
+                           int method, TestTokens& tokens )
+{
+    RtfTokenizer tokenizer( method );
+    RTF_TOKEN    token;
+    std::string  pending;
+    size_t       from = 0;
+
+    tokens.clear();
+
+    for ( size_t cnt=0; cnt<=cuts.size(); cnt++ )
+    {
+        size_t to = ( cnt < cuts.size() ) ? cuts[cnt] : data.size();
+        bool   last = ( cnt == cuts.size() );
+
+        pending.append( data, from, to - from );
+        from = to;
+
+        tokenizer.set_data( pending.data(), pending.size(), last );
+
+        while ( tokenizer.next( token ) == true )
+            add_token( tokens, token );
+
+        pending.erase( 0, tokenizer.get_offset() );
+    }
+
+    return tokenizer.get_depth();
+}
+
+// Compares tokens of every method, whole and cut, with scalar whole data
+static void check_tokens( const std::string& data, const std::vector<size_t>& cuts,
+                          size_t testcase )
+{
+    std::vector<size_t> none;
+    TestTokens          expected;
+    TestTokens          tokens;
+    int                 depth = tokenize_parts( data, none, RTF_ESCAPE_SCALAR, expected );
+
+    for ( int method=RTF_ESCAPE_SCALAR; method<=get_escapemethod(); method++ )
+    {
+        if ( ( tokenize_parts( data, none, method, tokens ) != depth ) ||
+             ( tokens != expected ) )
+            fail( "whole token stream", get_escapemethodname( method ), testcase );
+
+        if ( ( tokenize_parts( data, cuts, method, tokens ) != depth ) ||
+             ( tokens != expected ) )
+            fail( "cut token stream", get_escapemethodname( method ), testcase );
+    }
+}
+
+// Builds RTF of a document with text, tables, numbers and a binary picture
+static std::string build_document()
+{
+    RtfMemorySink sink;
+    RtfDocument   doc;
+
+    doc.open( &sink );
+    doc.set_textescaping( true );
+    doc.set_binaryimages( true );
+
+    doc.start_paragraph( "Report {draft} with a back\\slash,\ttab and\nnewline", true );
+    doc.start_paragraph( "A longer paragraph of plain text, long enough that its run "
+                         "spans several 16 and 32 byte blocks of the scanners.", true );
+
+    for ( int row=0; row<3; row++ )
+    {
+        doc.start_tablerow();
+        doc.start_tablecell( 3000 );
+        doc.start_tablecell( 6000 );
+        doc.start_paragraph( "Cell text", false );
+        doc.end_tablecell();
+        doc.write_double( RtfParagraphHandle( doc.get_paragraphformat() ),
+                          row * 1234.5, NULL, false );
+        doc.end_tablecell();
+        doc.end_tablerow();
+    }
+
+    // PNG signature and 2x2 IHDR are enough for \pngblip, rest of
+    // image is RTF specials for \bin data
+    unsigned char png[300];
+
+    memset( png, '\\', sizeof(png) );
+    memcpy( png, "\x89PNG\r\n\x1a\n\0\0\0\x0dIHDR\0\0\0\x02\0\0\0\x02", 24 );
+    for ( size_t cnt=24; cnt<sizeof(png); cnt+=7 )
+        png[cnt] = (unsigned char)( cnt * 31 );
+
+    if ( doc.load_image( png, sizeof(png), 100, 100 ) != RTF_SUCCESS )
+        fail( "test document", "image", 0 );
+    doc.start_paragraph( "Caf\xc3\xa9 \\'e9 end", true );
+    doc.close();
+
+    return std::string( sink.data(), sink.size() );
+}
+
+// Token streams of scalar, SSE2 and AVX2 scans, whole and cut in parts
+static void test_tokenizer()
+{
+    printf( "tokenizer, methods up to %s\n", get_escapemethodname( RTF_ESCAPE_AUTO ) );
+
+    // Parts cut inside \binN digits and data, in \'hh and in words
+    struct
+    {
+        const char* data;
+        size_t      size;
+        size_t      cut;
+    }
+    cases[] =
+    {
+        { "{\\pict\\bin12 0123456789ab}", 25, 9 },        // in \bin digits
+        { "{\\pict\\bin12 0123456789ab}", 25, 11 },       // before delimiter
+        { "{\\pict\\bin12 0123456789ab}", 25, 16 },       // in binary data
+        { "{\\pict\\bin12 0123\\{}\\9ab}", 25, 18 },      // data with \ { }
+        { "{\\pict\\bin12 01234", 18, 16 },              // data cut short
+        { "{caf\\'e9 x}", 11, 6 },                       // after \'
+        { "{caf\\'e9 x}", 11, 7 },                       // after \'h
+        { "{caf\\'e", 7, 6 },                            // truncated \'h
+        { "{caf\\'", 6, 5 },                             // truncated \'
+        { "{caf\\", 5, 4 },                              // lone backslash
+        { "{\\bold1 text}", 13, 4 },                     // in word
+        { "{\\bold1 text}", 13, 6 },                     // before parameter
+        { "{\\fs-24 text}", 13, 5 },                     // at minus
+        { "{\\fs-24 text}", 13, 6 },                     // in parameter
+        { "{\\par}", 6, 5 },                             // before }
+        { "{\\b-x}", 6, 4 },                             // lone minus
+    };
+
+    size_t count = sizeof(cases) / sizeof(cases[0]);
+
+    for ( size_t cnt=0; cnt<count; cnt++ )
+    {
+        std::string         data( cases[cnt].data, cases[cnt].size );
+        std::vector<size_t> cuts( 1, cases[cnt].cut );
+
+        check_tokens( data, cuts, cnt );
+    }
+
+    // Document cut at every offset, then in random parts
+    std::string document = build_document();
+
+    for ( size_t cut=0; cut<=document.size(); cut++ )
+        check_tokens( document, std::vector<size_t>( 1, cut ), count + cut );
+
+    for ( int run=0; run<200; run++ )
+    {
+        std::vector<size_t> cuts;
+        size_t              cut = 0;
+
+        while ( true )
+        {
+            cut += next_random() % 40;
+            if ( cut >= document.size() )
+                break;
+            cuts.push_back( cut );
+        }
+
+        check_tokens( document, cuts, run );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Random text of plain, escaped, control and UTF-8 bytes, valid or not
+static std::string random_text( size_t size )
+{
+    static const char* pieces[] =
+    {
+        "plain text ", "\\", "{", "}", "\r\n", "\r", "\n", "\t", "\x01",
+        "\xc3\xa9", "\xd0\x96", "\xe4\xb8\xad", "\xf0\x9f\x98\x80",
+        "\xc0\x80", "\xe0\x80\x80", "\xed\xa0\x80", "\xef\xbf\xbf",
+        "\x80", "\xc3", "\xe4\xb8", "\xf0\x9f", "\xff"
+    };
+
+    size_t      count = sizeof(pieces) / sizeof(pieces[0]);
+    std::string text;
+
+    while ( text.size() < size )
+    {
+        // Cyrillic runs keep vector UTF-8 blocks busy
+        if ( ( next_random() % 4 ) == 0 )
+            text += "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 ";
+        else
+            text += pieces[ next_random() % count ];
+    }
+
+    text.resize( size );
+
+    return text;
+}
+
+// SSE2 and AVX2 escapes against scalar ones
+static void test_escape()
+{
+    printf( "escaping, methods up to %s\n", get_escapemethodname( RTF_ESCAPE_AUTO ) );
+
+    for ( size_t cnt=0; cnt<3000; cnt++ )
+    {
+        std::string text = random_text( ( cnt < 400 ) ? cnt : next_random() % 4096 );
+
+        for ( int utf8=0; utf8<2; utf8++ )
+        {
+            RtfBuffer expected;
+            RtfBuffer out;
+
+            if ( utf8 == 0 )
+                put_escaped( expected, text.data(), text.size(), RTF_ESCAPE_SCALAR );
+            else
+                put_escapedutf8( expected, text.data(), text.size(), RTF_ESCAPE_SCALAR );
+
+            for ( int method=RTF_ESCAPE_SSE2; method<=get_escapemethod(); method++ )
+            {
+                out.clear();
+
+                if ( utf8 == 0 )
+                    put_escaped( out, text.data(), text.size(), method );
+                else
+                    put_escapedutf8( out, text.data(), text.size(), method );
+
+                if ( ( out.size() != expected.size() ) ||
+                     ( memcmp( out.data(), expected.data(), out.size() ) != 0 ) )
+                    fail( utf8 ? "UTF-8 escape" : "escape", get_escapemethodname( method ), cnt );
+            }
+        }
+    }
+}
+
+// SSSE3 and AVX2 hex encoding against scalar one, with line breaks
+static void test_hex()
+{
+    printf( "hex encoding, methods up to %s\n", get_hexmethodname( RTF_HEX_AUTO ) );
+
+    static const size_t widths[] = { 0, 1, 2, 7, 32, 33, RTF_HEX_LINEWIDTH };
+
+    std::vector<unsigned char> data( 5000 );
+
+    for ( size_t cnt=0; cnt<data.size(); cnt++ )
+        data[cnt] = (unsigned char)next_random();
+
+    for ( size_t cnt=0; cnt<600; cnt++ )
+    {
+        size_t size = ( cnt < 300 ) ? cnt : next_random() % data.size();
+        size_t from = next_random() % ( data.size() - size + 1 );
+
+        std::string expected( 2 * size, 0 );
+        std::string out( 2 * size, 0 );
+
+        hex_encode( &expected[0], &data[from], size, RTF_HEX_SCALAR );
+
+        for ( int method=RTF_HEX_SSSE3; method<=get_hexmethod(); method++ )
+        {
+            hex_encode( &out[0], &data[from], size, method );
+
+            if ( out != expected )
+                fail( "hex", get_hexmethodname( method ), cnt );
+
+            for ( size_t width=0; width<sizeof(widths)/sizeof(widths[0]); width++ )
+            {
+                RtfBuffer scalar;
+                RtfBuffer simd;
+
+                put_hex( scalar, &data[from], size, widths[width], RTF_HEX_SCALAR );
+                put_hex( simd, &data[from], size, widths[width], method );
+
+                if ( ( simd.size() != scalar.size() ) ||
+                     ( memcmp( simd.data(), scalar.data(), simd.size() ) != 0 ) )
+                    fail( "hex lines", get_hexmethodname( method ), cnt );
+            }
+        }
+    }
+}
+
+int main()
+{
+    test_tokenizer();
+    test_escape();
+    test_hex();
+
+    printf( failures ? "FAILED\n" : "OK\n" );
+
+    return failures ? 1 : 0;
+}
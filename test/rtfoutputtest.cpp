@@ -0,0 +1,288 @@
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "librtf.h"
+
+using namespace librtf;
+
+static int failures = 0;
+
+// Counts failure and prints it with RTF in question
+static void fail( const char* what, const std::string& rtf )
+{
+    printf( "  %s:\n%s\n", what, rtf.c_str() );
+    failures++;
+}
+
+// Gets RTF from after first "from" up to next "to" at or after start
+static std::string get_between( const std::string& rtf, const char* from, const char* to,
+                                size_t& start )
+{
+    size_t begin = rtf.find( from, start );
+
+    if ( begin == std::string::npos )
+    {
+        start = rtf.size();
+        return std::string();
+    }
+
+    begin += strlen( from );
+
+    size_t end = rtf.find( to, begin );
+
+    if ( end == std::string::npos )
+        end = rtf.size();
+
+    start = end;
+
+    return rtf.substr( begin, end - begin );
+}
+
+// Checks RTF has control words of a right aligned table paragraph
+static void check_cellparagraph( const std::string& rtf, const char* what )
+{
+    if ( ( rtf.find( "\\intbl" ) == std::string::npos ) ||
+         ( rtf.find( "\\qr" ) == std::string::npos ) )
+        fail( what, rtf );
+}
+
+// Sets right aligned table paragraph as current and column format
+static void set_cellparagraph( RtfDocument& doc )
+{
+    RTF_PARAGRAPH_FORMAT* pf = doc.get_paragraphformat();
+
+    pf->paragraphAligment = RTF_PARAGRAPHALIGN_RIGHT;
+    pf->tableText = true;
+}
+
+// Checks each text has right aligned table paragraph words after last
+// \pard before it, texts are in output order
+static void check_cellparagraphs( const std::string& rtf, const char** texts, size_t count )
+{
+    size_t start = 0;
+
+    for ( size_t cnt=0; cnt<count; cnt++ )
+    {
+        size_t end = rtf.find( texts[cnt], start );
+
+        if ( end == std::string::npos )
+        {
+            fail( texts[cnt], rtf );
+            return;
+        }
+
+        size_t pard = rtf.rfind( "\\pard", end );
+
+        if ( ( pard == std::string::npos ) || ( pard < start ) )
+            pard = start;
+
+        check_cellparagraph( rtf.substr( pard, end - pard ), texts[cnt] );
+
+        start = end + strlen( texts[cnt] );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Paragraph after write_table() rows in delta mode gets its own format
+static void test_writetable()
+{
+    printf( "write_table, delta formatting\n" );
+
+    RtfMemorySink sink;
+    RtfDocument   doc;
+
+    doc.set_deltaformat( true );
+    doc.open( &sink );
+    set_cellparagraph( doc );
+
+    RtfTableSchema schema( doc.get_tablerowformat() );
+
+    schema.add_column( 2000, doc.get_tablecellformat(), doc.get_paragraphformat() );
+    schema.add_column( 2000, doc.get_tablecellformat(), doc.get_paragraphformat() );
+
+    RTF_TEXTSPAN cells[4] = { { "a", 1 }, { "b", 1 }, { "c", 1 }, { "d", 1 } };
+
+    doc.write_table( schema, cells, 2 );
+    doc.start_paragraph( "B", false );
+    doc.close();
+
+    std::string rtf( sink.data(), sink.size() );
+    size_t      start = 0;
+
+    for ( int row=0; row<2; row++ )
+        get_between( rtf, "\\row\\pard", "\n", start );
+
+    check_cellparagraph( get_between( rtf, "", "B", start ), "paragraph after table" );
+}
+
+// Rows streamed by RtfTableWriter in delta mode, each followed by a
+// paragraph of last cell format, keep their paragraph properties
+static void test_tablewriter()
+{
+    printf( "RtfTableWriter, delta formatting\n" );
+
+    RtfMemorySink sink;
+    RtfDocument   doc;
+
+    doc.set_deltaformat( true );
+    doc.open( &sink );
+    set_cellparagraph( doc );
+
+    RtfTableSchema schema( doc.get_tablerowformat() );
+
+    schema.add_column( 2000, doc.get_tablecellformat(), doc.get_paragraphformat() );
+    schema.add_column( 2000, doc.get_tablecellformat(), doc.get_paragraphformat() );
+
+    RtfTableWriter writer( &doc, &schema );
+
+    const char* texts[] = { "r0a", "r0b", "P0", "r1a", "r1b", "P1",
+                            "r2a", "r2b", "P2", "r3a", "r3b", "P3" };
+
+    for ( size_t row=0; row<4; row++ )
+    {
+        const char** text = texts + row * 3;
+
+        // Whole rows and rows cell by cell
+        if ( ( row % 2 ) == 0 )
+        {
+            RTF_TEXTSPAN cells[2] = { { text[0], 3 }, { text[1], 3 } };
+
+            writer.write_row( cells );
+        }
+        else
+        {
+            writer.write_cell( text[0] );
+            writer.write_cell( text[1] );
+            writer.end_row();
+        }
+
+        doc.start_paragraph( text[2], false );
+    }
+
+    doc.close();
+
+    check_cellparagraphs( std::string( sink.data(), sink.size() ), texts,
+                          sizeof(texts) / sizeof(texts[0]) );
+}
+
+// Sinks given to open() stay usable after close(), document only
+// flushes them
+static void test_callersink()
+{
+    printf( "caller sinks after close\n" );
+
+    FILE* fp = tmpfile();
+
+    if ( fp == NULL )
+    {
+        fail( "tmpfile", "" );
+        return;
+    }
+
+    RtfFileSink filesink( fp );
+    RtfFdSink   fdsink( fileno( fp ) );
+    RtfSink*    sinks[2] = { &filesink, &fdsink };
+
+    for ( int cnt=0; cnt<2; cnt++ )
+    {
+        RtfDocument doc;
+
+        if ( ( doc.open( sinks[cnt] ) != RTF_SUCCESS ) ||
+             ( doc.start_paragraph( "text", false ) != RTF_SUCCESS ) ||
+             ( doc.close() != RTF_SUCCESS ) )
+            fail( "document on caller sink", "" );
+
+        if ( ( sinks[cnt]->write( "end", 3 ) == false ) ||
+             ( sinks[cnt]->flush() == false ) )
+            fail( cnt ? "fd sink after close" : "file sink after close", "" );
+    }
+
+    fclose( fp );
+}
+
+// Row started from a template freezes to same definition
+static void test_freezetablerow()
+{
+    printf( "freeze_tablerow of template row\n" );
+
+    RtfMemorySink sink;
+    RtfDocument   doc;
+
+    doc.open( &sink );
+
+    doc.start_tablerow();
+    doc.start_tablecell( 3000 );
+    doc.start_tablecell( 6000 );
+
+    RtfRowTemplate first = doc.freeze_tablerow();
+
+    doc.end_tablerow();
+    doc.start_tablerow( first );
+
+    RtfRowTemplate second = doc.freeze_tablerow();
+
+    if ( ( first.get_cells() != 2 ) || ( second.get_cells() != 2 ) ||
+         ( std::string( first.data(), first.size() ) !=
+           std::string( second.data(), second.size() ) ) )
+        fail( "frozen template row", std::string( second.data(), second.size() ) );
+
+    // Cells started after template are frozen too
+    doc.start_tablecell( 9000 );
+
+    RtfRowTemplate third = doc.freeze_tablerow();
+
+    if ( ( third.get_cells() != 3 ) || ( third.size() <= second.size() ) ||
+         ( memcmp( third.data(), second.data(), second.size() ) != 0 ) )
+        fail( "frozen template row with cell", std::string( third.data(), third.size() ) );
+
+    doc.end_tablerow();
+    doc.close();
+}
+
+// Binary pictures over INT_MAX bytes are rejected, not written with a
+// truncated \binN length. Only PNG header is read before size check.
+static void test_binarysize()
+{
+    printf( "\\binN picture size limit\n" );
+
+    // PNG signature, 2x2 IHDR, then IDAT ends header scan
+    static const unsigned char png[] =
+        "\x89PNG\r\n\x1a\n\0\0\0\x0dIHDR\0\0\0\x02\0\0\0\x02"
+        "\x08\x02\0\0\0\0\0\0\0\0\0\0\0IDAT";
+
+    RtfMemorySink sink;
+    RtfDocument   doc;
+
+    doc.open( &sink );
+    doc.set_binaryimages( true );
+
+    if ( doc.load_image( png, sizeof(png), 100, 100 ) != RTF_SUCCESS )
+        fail( "small binary picture", "" );
+
+    if ( sizeof(size_t) > sizeof(int) )
+    {
+        size_t size = (size_t)INT_MAX + 1;
+
+        if ( doc.load_image( png, size, 100, 100 ) != RTF_IMAGE_ERROR )
+            fail( "binary picture over INT_MAX", "" );
+    }
+
+    doc.close();
+}
+
+int main()
+{
+    test_writetable();
+    test_tablewriter();
+    test_callersink();
+    test_freezetablerow();
+    test_binarysize();
+
+    printf( failures ? "FAILED\n" : "OK\n" );
+
+    return failures ? 1 : 0;
+}